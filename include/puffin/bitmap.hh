@@ -11,6 +11,7 @@
 
 #include "color.hh"
 #include "impl/compiler.hh"
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <istream>
@@ -60,11 +61,92 @@ std::ostream& operator<< (std::ostream &os, std::set<BitmapVersion> const& v) {
         return os;
 }
 
+// -- DecodeStats --------------------------------------------------------------
+// Per-stage measurements of a single decode. Only filled in when requested
+// through DecodeOptions::stats; otherwise no clock is ever read.
+struct DecodeStats {
+        // Wall-clock time per stage, in nanoseconds.
+        uint64_t version_ns;      // determineBitmapVersion()
+        uint64_t headers_ns;      // file header and info header
+        uint64_t color_table_ns;  // color masks and palette
+        uint64_t image_data_ns;   // pixel rows, uncompressed or RLE
+        uint64_t alpha_ns;        // alpha detection
+        uint64_t total_ns;        // the whole decode, including the above
+
+        uint64_t bytes_read;      // bytes consumed from the stream
+        uint64_t rows_decoded;    // rows of pixel data produced
+        uint64_t allocations;     // heap allocations for pixel and palette data
+        uint64_t bad_indices;     // pixels indexing past the stored palette
+        char const *kernel;       // the row decoder used, e.g. "rle8"
+
+        DecodeStats() :
+                version_ns(0),
+                headers_ns(0),
+                color_table_ns(0),
+                image_data_ns(0),
+                alpha_ns(0),
+                total_ns(0),
+                bytes_read(0),
+                rows_decoded(0),
+                allocations(0),
+                bad_indices(0),
+                kernel("")
+        {}
+};
+std::ostream& operator<< (std::ostream &os, DecodeStats const &v);
+
+
+// -- DecodeLimits -------------------------------------------------------------
+// Upper bounds for a single decode, checked against the headers before any
+// pixel memory is allocated. Zero means unlimited.
+struct DecodeLimits {
+        uint64_t max_pixels;  // width * height
+        uint64_t max_bytes;   // memory held by the decoded bitmap
+
+        DecodeLimits() :
+                max_pixels(0),
+                max_bytes(0)
+        {}
+};
+
+// The process-wide budget bounds the memory held by all live Bitmap and
+// InvalidBitmap objects together. Zero (the default) means unlimited.
+void set_process_decode_budget(uint64_t max_bytes);
+uint64_t process_decode_budget();
+uint64_t process_decode_bytes_in_use();
+
+
+// -- DecodeOptions ------------------------------------------------------------
+struct DecodeOptions {
+        // If non-null, receives measurements of the decode.
+        DecodeStats *stats;
+
+        DecodeLimits limits;
+
+        // Paletted bitmaps may store fewer than 2^bpp palette entries. The
+        // palette is padded to 2^bpp entries with this colour, so that
+        // every possible index is valid.
+        Color32 palette_fill;
+
+        // If true, pixels indexing past the stored palette make the decode
+        // fail with exceptions::palette_index_out_of_range instead.
+        bool strict_palette;
+
+        DecodeOptions() :
+                stats(0),
+                limits(),
+                palette_fill(0, 0, 0),
+                strict_palette(false)
+        {}
+};
+
+
 namespace impl { struct Bitmap; }
 
 class Bitmap {
 public:
         explicit Bitmap(std::istream &);
+        Bitmap(std::istream &, DecodeOptions const &);
         ~Bitmap();
 
         Bitmap(Bitmap const &);
@@ -72,6 +154,7 @@ public:
 
         void reset();
         void reset(std::istream &);
+        void reset(std::istream &, DecodeOptions const &);
 
         int width() const;
         int height() const;
@@ -89,6 +172,14 @@ public:
         Color32 operator() (int x, int y) const;
         Color32 at (int x, int y) const;
 
+        // Write width() pixels of row y, or all rows with row y starting at
+        // dst + y*stride. 24 and 32 bpp data is stored as b, g, r bytes
+        // like Color32Bgra and is copied without unpacking the channels,
+        // e.g. into an Image32Bgra:
+        //     bmp.read_pixels(img.data(), img.stride());
+        void read_row(int y, Color32Bgra *dst) const;
+        void read_pixels(Color32Bgra *dst, std::size_t stride) const;
+
         friend std::ostream& operator<< (std::ostream &os, Bitmap const &v);
 
 private:
@@ -104,6 +195,7 @@ class InvalidBitmap {
 public:
         InvalidBitmap();
         explicit InvalidBitmap(std::istream &);
+        InvalidBitmap(std::istream &, DecodeOptions const &);
         ~InvalidBitmap();
 
         InvalidBitmap(InvalidBitmap const &);
@@ -111,7 +203,9 @@ public:
 
         void reset();
         void reset(std::istream &);
+        void reset(std::istream &, DecodeOptions const &);
         bool partial_reset(std::istream &);
+        bool partial_reset(std::istream &, DecodeOptions const &);
 
         int width() const;
         int height() const;
@@ -127,9 +221,20 @@ public:
         unsigned int y_pixels_per_meter() const;
         bool has_square_pixels() const;
 
+        // The pixels of a bitmap that is not valid() cannot be read:
+        // operator() returns Color32(), at(), read_row() and read_pixels()
+        // throw std::logic_error.
         Color32 operator() (int x, int y) const;
         Color32 at (int x, int y) const;
 
+        // Write width() pixels of row y, or all rows with row y starting at
+        // dst + y*stride. 24 and 32 bpp data is stored as b, g, r bytes
+        // like Color32Bgra and is copied without unpacking the channels,
+        // e.g. into an Image32Bgra:
+        //     bmp.read_pixels(img.data(), img.stride());
+        void read_row(int y, Color32Bgra *dst) const;
+        void read_pixels(Color32Bgra *dst, std::size_t stride) const;
+
         friend std::ostream& operator<< (std::ostream &, InvalidBitmap const &);
 
 private:
@@ -142,7 +247,10 @@ private:
 
 
 Bitmap read_bmp(std::string const &filename);
+Bitmap read_bmp(std::string const &filename, DecodeOptions const &);
 InvalidBitmap read_invalid_bmp(std::string const &filename);
+InvalidBitmap read_invalid_bmp(std::string const &filename,
+                               DecodeOptions const &);
 }
 
 #endif //BMP2_HH_INCLUDED_20190102
@@ -0,0 +1,336 @@
+#ifndef BLIT_HH_INCLUDED_20261018
+#define BLIT_HH_INCLUDED_20261018
+
+#include "coords.hh"
+#include "color_ops.hh"
+#include "image.hh"
+#include "image_view.hh"
+#include "impl/block_copy.hh"
+#include "impl/compiler.hh"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin {
+
+// -- blit ---------------------------------------------------------------------
+// Copies the pixels of src_rect in src to dst, with the top left pixel of
+// src_rect going to dst_point. The copy is clipped against both images:
+// parts of src_rect outside src, and parts that would land outside dst, are
+// left out. Returns the rectangle of dst that was written, which is empty
+// if nothing was.
+//
+// Rows are copied whole, with memmove. src and dst may be views of the same
+// image and overlap; the result is as if src_rect had been copied to a
+// temporary first.
+//
+// - blit_keyed() leaves the pixels of dst alone where src equals key
+//   ("colour key", e.g. magenta sprite backgrounds).
+// - blit_masked() leaves the pixels of dst alone where src has an alpha of
+//   zero. Other pixels are copied as they are; see composite.hh for
+//   blending.
+//
+// Color32 and Color64, in either channel order, are keyed and masked with
+// SSE2, 4 or 2 pixels at a time.
+template <typename T>
+inline Rect blit(image_view<T> const &src, Rect const &src_rect,
+                 mutable_image_view<T> const &dst, Coords const &dst_point);
+template <typename T>
+inline Rect blit(image_view<T> const &src,
+                 mutable_image_view<T> const &dst, Coords const &dst_point);
+
+template <typename T>
+inline Rect blit(base_image<T> const &src, Rect const &src_rect,
+                 base_image<T> &dst, Coords const &dst_point);
+template <typename T>
+inline Rect blit(base_image<T> const &src,
+                 base_image<T> &dst, Coords const &dst_point);
+
+template <typename T>
+inline Rect blit_keyed(image_view<T> const &src, Rect const &src_rect,
+                       mutable_image_view<T> const &dst,
+                       Coords const &dst_point, T const &key);
+template <typename T>
+inline Rect blit_keyed(base_image<T> const &src, Rect const &src_rect,
+                       base_image<T> &dst, Coords const &dst_point,
+                       T const &key);
+
+template <typename T>
+inline Rect blit_masked(image_view<T> const &src, Rect const &src_rect,
+                        mutable_image_view<T> const &dst,
+                        Coords const &dst_point);
+template <typename T>
+inline Rect blit_masked(base_image<T> const &src, Rect const &src_rect,
+                        base_image<T> &dst, Coords const &dst_point);
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+// -- clip_blit ----------------------------------------------------------------
+// The part of a blit of src_rect to dst_point that lies inside both
+// images: w x h pixels from (sx, sy) in the source to (dx, dy) in the
+// destination. Empty if w or h is not positive.
+struct blit_region {
+        int sx, sy, dx, dy, w, h;
+
+        bool empty() const noexcept { return w <= 0 || h <= 0; }
+};
+
+inline blit_region clip_blit(
+        int src_width, int src_height, Rect const &src_rect,
+        int dst_width, int dst_height, Coords const &dst_point
+) {
+        blit_region r{src_rect.left(), src_rect.top(),
+                      dst_point.x, dst_point.y,
+                      src_rect.width(), src_rect.height()};
+        // Clips the start of one axis so that both a and b are >= 0.
+        const auto clip_start = [] (int &a, int &b, int &n) {
+                const int d = std::max(0, std::max(-a, -b));
+                a += d;
+                b += d;
+                n -= d;
+        };
+        clip_start(r.sx, r.dx, r.w);
+        clip_start(r.sy, r.dy, r.h);
+        r.w = std::min(r.w, std::min(src_width - r.sx, dst_width - r.dx));
+        r.h = std::min(r.h, std::min(src_height - r.sy, dst_height - r.dy));
+        return r;
+}
+
+// Calls row(src, dst, n, overlap) for each row of the clipped blit. Rows
+// are visited bottom up if the destination starts later in memory, so that
+// overlapping rows of one image are read before they are overwritten.
+// overlap tells whether the source and destination memory intersect. The
+// pixel types may differ (see composite.hh).
+template <typename S, typename D, typename RowFunction>
+inline Rect blit_rows(
+        image_view<S> const &src, Rect const &src_rect,
+        mutable_image_view<D> const &dst, Coords const &dst_point,
+        RowFunction row
+) {
+        const blit_region r = clip_blit(src.width(), src.height(), src_rect,
+                                        dst.width(), dst.height(), dst_point);
+        if (r.empty())
+                return Rect{dst_point, dst_point};
+
+        S const *s = src.row(r.sy) + r.sx;
+        D *d = dst.row(r.dy) + r.dx;
+        const auto ss = std::ptrdiff_t(src.stride());
+        const auto ds = std::ptrdiff_t(dst.stride());
+        const auto addr = [] (void const *p) {
+                return reinterpret_cast<std::uintptr_t>(p);
+        };
+        const bool overlap =
+                addr(s) < addr(d + (r.h - 1) * ds + r.w) &&
+                addr(d) < addr(s + (r.h - 1) * ss + r.w);
+
+        if (overlap && addr(d) > addr(s)) {
+                for (int y=r.h-1; y>=0; --y)
+                        row(s + y*ss, d + y*ds, r.w, true);
+        } else {
+                for (int y=0; y!=r.h; ++y)
+                        row(s + y*ss, d + y*ds, r.w, overlap);
+        }
+        return Rect{{r.dx, r.dy}, {r.dx + r.w, r.dy + r.h}};
+}
+
+// As blit_rows(), for row functions that need src and dst to be disjoint:
+// overlapping source rows are copied to a buffer first.
+template <typename S, typename D, typename RowFunction>
+inline Rect blit_rows_disjoint(
+        image_view<S> const &src, Rect const &src_rect,
+        mutable_image_view<D> const &dst, Coords const &dst_point,
+        RowFunction row
+) {
+        std::vector<S> buffer;
+        return blit_rows(src, src_rect, dst, dst_point,
+                         [&] (S const *s, D *d, int n, bool overlap) {
+                if (overlap) {
+                        buffer.resize(n);
+                        copy_n(s, n, buffer.data());
+                        s = buffer.data();
+                }
+                row(s, d, n);
+        });
+}
+
+// -- keyed and masked rows ----------------------------------------------------
+template <typename T>
+inline void blit_keyed_row(T const *src, T *dst, int n, T const &key) {
+        for (int x=0; x!=n; ++x)
+                if (!(src[x] == key))
+                        dst[x] = src[x];
+}
+
+template <typename T>
+inline void blit_masked_row(T const *src, T *dst, int n) {
+        for (int x=0; x!=n; ++x)
+                if (src[x].a() != 0)
+                        dst[x] = src[x];
+}
+
+#if PUFFIN_HAS_SSE2
+// dst = src where keep is set, for whole 16 byte groups of pixels; the
+// rest with the scalar row function.
+template <typename P, typename Keep, typename Tail>
+inline void blit_select_sse2(P const *src, P *dst, int n,
+                             Keep keep, Tail tail) {
+        constexpr int step = 16 / sizeof(P);
+        int x = 0;
+        for (; x+step <= n; x+=step) {
+                const __m128i s = load_px(src + x);
+                const __m128i d = load_px(dst + x);
+                const __m128i m = keep(s);
+                store_px(dst + x, _mm_or_si128(_mm_and_si128(m, s),
+                                               _mm_andnot_si128(m, d)));
+        }
+        tail(src + x, dst + x, n - x);
+}
+
+template <typename O>
+inline void blit_keyed_row(rgba8<O> const *src, rgba8<O> *dst, int n,
+                           rgba8<O> const &key) {
+        const __m128i k = broadcast_px(key);
+        blit_select_sse2(src, dst, n, [&] (__m128i s) {
+                return _mm_xor_si128(_mm_cmpeq_epi32(s, k),
+                                     _mm_set1_epi32(-1));
+        }, [&] (rgba8<O> const *s, rgba8<O> *d, int m) {
+                for (int x=0; x!=m; ++x)
+                        if (!(s[x] == key))
+                                d[x] = s[x];
+        });
+}
+
+template <typename O>
+inline void blit_keyed_row(rgba16<O> const *src, rgba16<O> *dst, int n,
+                           rgba16<O> const &key) {
+        const __m128i k = broadcast_px(key);
+        blit_select_sse2(src, dst, n, [&] (__m128i s) {
+                // A pixel equals key if both of its 32 bit halves do.
+                const __m128i eq = _mm_cmpeq_epi32(s, k);
+                return _mm_xor_si128(
+                        _mm_and_si128(eq, _mm_shuffle_epi32(
+                                eq, _MM_SHUFFLE(2, 3, 0, 1))),
+                        _mm_set1_epi32(-1));
+        }, [&] (rgba16<O> const *s, rgba16<O> *d, int m) {
+                for (int x=0; x!=m; ++x)
+                        if (!(s[x] == key))
+                                d[x] = s[x];
+        });
+}
+
+// Alpha is the last channel in both channel orders.
+template <typename O>
+inline void blit_masked_row(rgba8<O> const *src, rgba8<O> *dst, int n) {
+        const __m128i alpha = _mm_set1_epi32(int32_t(0xFF000000u));
+        blit_select_sse2(src, dst, n, [&] (__m128i s) {
+                return _mm_xor_si128(
+                        _mm_cmpeq_epi32(_mm_and_si128(s, alpha),
+                                        _mm_setzero_si128()),
+                        _mm_set1_epi32(-1));
+        }, [] (rgba8<O> const *s, rgba8<O> *d, int m) {
+                for (int x=0; x!=m; ++x)
+                        if (s[x].a() != 0)
+                                d[x] = s[x];
+        });
+}
+
+template <typename O>
+inline void blit_masked_row(rgba16<O> const *src, rgba16<O> *dst, int n) {
+        const __m128i alpha = _mm_set_epi32(int32_t(0xFFFF0000u), 0,
+                                            int32_t(0xFFFF0000u), 0);
+        blit_select_sse2(src, dst, n, [&] (__m128i s) {
+                // Alpha is in the upper half of each pixel.
+                const __m128i zero = _mm_cmpeq_epi32(_mm_and_si128(s, alpha),
+                                                     _mm_setzero_si128());
+                return _mm_xor_si128(
+                        _mm_shuffle_epi32(zero, _MM_SHUFFLE(3, 3, 1, 1)),
+                        _mm_set1_epi32(-1));
+        }, [] (rgba16<O> const *s, rgba16<O> *d, int m) {
+                for (int x=0; x!=m; ++x)
+                        if (s[x].a() != 0)
+                                d[x] = s[x];
+        });
+}
+#endif
+
+} }
+
+namespace puffin {
+
+template <typename T>
+inline Rect blit(image_view<T> const &src, Rect const &src_rect,
+                 mutable_image_view<T> const &dst, Coords const &dst_point) {
+        return impl::blit_rows(src, src_rect, dst, dst_point,
+                               [] (T const *s, T *d, int n, bool) {
+                impl::move_n(s, n, d);
+        });
+}
+
+template <typename T>
+inline Rect blit(image_view<T> const &src,
+                 mutable_image_view<T> const &dst, Coords const &dst_point) {
+        return blit(src, Rect{{0, 0}, {src.width(), src.height()}},
+                    dst, dst_point);
+}
+
+template <typename T>
+inline Rect blit(base_image<T> const &src, Rect const &src_rect,
+                 base_image<T> &dst, Coords const &dst_point) {
+        return blit(image_view<T>{src}, src_rect,
+                    mutable_image_view<T>{dst}, dst_point);
+}
+
+template <typename T>
+inline Rect blit(base_image<T> const &src,
+                 base_image<T> &dst, Coords const &dst_point) {
+        return blit(image_view<T>{src}, mutable_image_view<T>{dst},
+                    dst_point);
+}
+
+template <typename T>
+inline Rect blit_keyed(image_view<T> const &src, Rect const &src_rect,
+                       mutable_image_view<T> const &dst,
+                       Coords const &dst_point, T const &key) {
+        return impl::blit_rows_disjoint(src, src_rect, dst, dst_point,
+                                        [&] (T const *s, T *d, int n) {
+                impl::blit_keyed_row(s, d, n, key);
+        });
+}
+
+template <typename T>
+inline Rect blit_keyed(base_image<T> const &src, Rect const &src_rect,
+                       base_image<T> &dst, Coords const &dst_point,
+                       T const &key) {
+        return blit_keyed(image_view<T>{src}, src_rect,
+                          mutable_image_view<T>{dst}, dst_point, key);
+}
+
+template <typename T>
+inline Rect blit_masked(image_view<T> const &src, Rect const &src_rect,
+                        mutable_image_view<T> const &dst,
+                        Coords const &dst_point) {
+        return impl::blit_rows_disjoint(src, src_rect, dst, dst_point,
+                                        [] (T const *s, T *d, int n) {
+                impl::blit_masked_row(s, d, n);
+        });
+}
+
+template <typename T>
+inline Rect blit_masked(base_image<T> const &src, Rect const &src_rect,
+                        base_image<T> &dst, Coords const &dst_point) {
+        return blit_masked(image_view<T>{src}, src_rect,
+                           mutable_image_view<T>{dst}, dst_point);
+}
+
+}
+
+#endif //BLIT_HH_INCLUDED_20261018
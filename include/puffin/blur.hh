@@ -0,0 +1,773 @@
+#ifndef BLUR_HH_INCLUDED_20261018
+#define BLUR_HH_INCLUDED_20261018
+
+#include "color.hh"
+#include "color_ops.hh"
+#include "execution.hh"
+#include "image.hh"
+#include "image_view.hh"
+#include "resize.hh"
+#include "impl/block_copy.hh"
+#include "impl/compiler.hh"
+#include "impl/contract.hh"
+#include "impl/resample.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin {
+
+// -- box_blur -----------------------------------------------------------------
+// Each pixel becomes the average of the (2*radius_x + 1) x (2*radius_y + 1)
+// pixels around it. At the borders, the window is cut off at the image and
+// the average taken over the pixels inside.
+//
+// Costs O(1) per pixel whatever the radius: a running sum per row is moved
+// along by adding the pixel that enters the window and subtracting the one
+// that leaves it. The vertical pass runs over strips of columns, keeping
+// one sum per column and reading whole rows of the strip, so that memory
+// is read in rows instead of down columns. Sums are exact 32 bit integers
+// for Color32 and Color64 (SSE2, all four channels of a pixel at a time),
+// hence radii are limited to 16383. With an execution policy, the
+// horizontal pass runs in bands of rows, the vertical one in bands of
+// strips.
+template <typename T>
+inline base_image<T> box_blur(image_view<T> const &src, int radius);
+template <typename T>
+inline base_image<T> box_blur(image_view<T> const &src,
+                              int radius_x, int radius_y);
+template <typename T>
+inline base_image<T> box_blur(base_image<T> const &src, int radius);
+template <typename T>
+inline base_image<T> box_blur(base_image<T> const &src,
+                              int radius_x, int radius_y);
+
+template <typename ExecutionPolicy, typename T>
+inline auto box_blur(ExecutionPolicy const &, image_view<T> const &src,
+                     int radius)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+template <typename ExecutionPolicy, typename T>
+inline auto box_blur(ExecutionPolicy const &, image_view<T> const &src,
+                     int radius_x, int radius_y)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+template <typename ExecutionPolicy, typename T>
+inline auto box_blur(ExecutionPolicy const &, base_image<T> const &src,
+                     int radius)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+template <typename ExecutionPolicy, typename T>
+inline auto box_blur(ExecutionPolicy const &, base_image<T> const &src,
+                     int radius_x, int radius_y)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+
+// -- BlurMethod ---------------------------------------------------------------
+// How gaussian_blur() filters.
+//
+// - Exact: convolution with the sampled Gaussian out to 3 sigma (rounded
+//   up to whole pixels), as two separable passes with the resize()
+//   kernels (impl/resample.hh). Costs O(sigma) per pixel; the borders
+//   renormalize like box_blur().
+// - Box: three successive box blurs with radii chosen to match the
+//   variance of the Gaussian ("boxes for Gauss"). O(1) per pixel, within
+//   a few percent of the Gaussian. The radii are subject to the limit of
+//   box_blur(), which allows sigma up to about 16382.
+// - Iir: the recursive filter of Young and van Vliet, a causal and an
+//   anti-causal third order recursion per axis, in single precision. O(1)
+//   per pixel and smooth, but borders repeat the edge pixels. Needs sigma
+//   of at least 0.5, and uses Exact below.
+// - Auto: Box for sigma above 2 as far as Box allows, Exact otherwise.
+enum class BlurMethod {
+        Auto,
+        Exact,
+        Box,
+        Iir
+};
+
+// -- gaussian_blur ------------------------------------------------------------
+// Blurs src with a Gaussian of standard deviation sigma pixels (>= 0; 0
+// copies). With an execution policy, each pass runs in bands of rows or
+// column strips.
+template <typename T>
+inline base_image<T> gaussian_blur(image_view<T> const &src, double sigma,
+                                   BlurMethod method = BlurMethod::Auto);
+template <typename T>
+inline base_image<T> gaussian_blur(base_image<T> const &src, double sigma,
+                                   BlurMethod method = BlurMethod::Auto);
+
+template <typename ExecutionPolicy, typename T>
+inline auto gaussian_blur(ExecutionPolicy const &,
+                          image_view<T> const &src, double sigma,
+                          BlurMethod method = BlurMethod::Auto)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+template <typename ExecutionPolicy, typename T>
+inline auto gaussian_blur(ExecutionPolicy const &,
+                          base_image<T> const &src, double sigma,
+                          BlurMethod method = BlurMethod::Auto)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+// -- four lanes ---------------------------------------------------------------
+// The channels of one pixel as four 32 bit integers (box sums) or floats
+// (recursive filtering), in memory order. One SSE2 register each.
+#if PUFFIN_HAS_SSE2
+struct blur_i4 { __m128i v; };
+struct blur_f4 { __m128 v; };
+
+inline blur_i4 operator+ (blur_i4 a, blur_i4 b) {
+        return {_mm_add_epi32(a.v, b.v)};
+}
+inline blur_i4 operator- (blur_i4 a, blur_i4 b) {
+        return {_mm_sub_epi32(a.v, b.v)};
+}
+inline blur_f4 operator+ (blur_f4 a, blur_f4 b) {
+        return {_mm_add_ps(a.v, b.v)};
+}
+inline blur_f4 operator- (blur_f4 a, blur_f4 b) {
+        return {_mm_sub_ps(a.v, b.v)};
+}
+inline blur_f4 operator* (blur_f4 a, float f) {
+        return {_mm_mul_ps(a.v, _mm_set1_ps(f))};
+}
+
+inline blur_i4 make_i4(int32_t const *v) {
+        return {_mm_loadu_si128(reinterpret_cast<__m128i const*>(v))};
+}
+inline void get_i4(blur_i4 a, int32_t *v) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v), a.v);
+}
+inline blur_f4 make_f4(float const *v) { return {_mm_loadu_ps(v)}; }
+inline void get_f4(blur_f4 a, float *v) { _mm_storeu_ps(v, a.v); }
+#else
+struct blur_i4 { int32_t v[4]; };
+struct blur_f4 { float v[4]; };
+
+inline blur_i4 operator+ (blur_i4 a, blur_i4 b) {
+        for (int i=0; i!=4; ++i)
+                a.v[i] += b.v[i];
+        return a;
+}
+inline blur_i4 operator- (blur_i4 a, blur_i4 b) {
+        for (int i=0; i!=4; ++i)
+                a.v[i] -= b.v[i];
+        return a;
+}
+inline blur_f4 operator+ (blur_f4 a, blur_f4 b) {
+        for (int i=0; i!=4; ++i)
+                a.v[i] += b.v[i];
+        return a;
+}
+inline blur_f4 operator- (blur_f4 a, blur_f4 b) {
+        for (int i=0; i!=4; ++i)
+                a.v[i] -= b.v[i];
+        return a;
+}
+inline blur_f4 operator* (blur_f4 a, float f) {
+        for (int i=0; i!=4; ++i)
+                a.v[i] *= f;
+        return a;
+}
+
+inline blur_i4 make_i4(int32_t const *v) {
+        return {{v[0], v[1], v[2], v[3]}};
+}
+inline void get_i4(blur_i4 a, int32_t *v) { std::memcpy(v, a.v, 16); }
+inline blur_f4 make_f4(float const *v) {
+        return {{v[0], v[1], v[2], v[3]}};
+}
+inline void get_f4(blur_f4 a, float *v) { std::memcpy(v, a.v, 16); }
+#endif
+
+// -- pixels to lanes and back -------------------------------------------------
+// box_in() and box_out() for box sums: integers for unsigned integer
+// channels, floats otherwise; box_out() scales by inv and rounds.
+// iir_in() and iir_out() for floats.
+template <typename S>
+using blur_sum = typename std::conditional<std::is_integral<S>::value,
+                                           blur_i4, blur_f4>::type;
+
+template <typename S, typename O>
+inline auto box_in(basic_rgba<S, S, S, S, O> const &p)
+        -> typename std::enable_if<std::is_integral<S>::value, blur_i4>::type
+{
+        const int32_t v[4] = {p.r(), p.g(), p.b(), p.a()};
+        return make_i4(v);
+}
+
+template <typename S, typename O>
+inline auto box_in(basic_rgba<S, S, S, S, O> const &p)
+        -> typename std::enable_if<!std::is_integral<S>::value,
+                                   blur_f4>::type
+{
+        const float v[4] = {float(p.r()), float(p.g()),
+                            float(p.b()), float(p.a())};
+        return make_f4(v);
+}
+
+template <typename S, typename O>
+inline auto box_out(blur_i4 sum, float inv, basic_rgba<S, S, S, S, O> &p)
+        -> typename std::enable_if<std::is_integral<S>::value>::type
+{
+        using arith = channel_arith<S>;
+        int32_t v[4];
+        get_i4(sum, v);
+        p = basic_rgba<S, S, S, S, O>{arith::from_real(float(v[0]) * inv),
+                                      arith::from_real(float(v[1]) * inv),
+                                      arith::from_real(float(v[2]) * inv),
+                                      arith::from_real(float(v[3]) * inv)};
+}
+
+template <typename S, typename O>
+inline auto box_out(blur_f4 sum, float inv, basic_rgba<S, S, S, S, O> &p)
+        -> typename std::enable_if<!std::is_integral<S>::value>::type
+{
+        float v[4];
+        get_f4(sum * inv, v);
+        p = basic_rgba<S, S, S, S, O>{S(v[0]), S(v[1]), S(v[2]), S(v[3])};
+}
+
+template <typename S, typename O>
+inline blur_f4 iir_in(basic_rgba<S, S, S, S, O> const &p) {
+        const float v[4] = {float(p.r()), float(p.g()),
+                            float(p.b()), float(p.a())};
+        return make_f4(v);
+}
+
+template <typename S, typename O>
+inline void iir_out(blur_f4 x, basic_rgba<S, S, S, S, O> &p) {
+        float v[4];
+        get_f4(x, v);
+        p = basic_rgba<S, S, S, S, O>{resample_channel<S>(v[0]),
+                                      resample_channel<S>(v[1]),
+                                      resample_channel<S>(v[2]),
+                                      resample_channel<S>(v[3])};
+}
+
+#if PUFFIN_HAS_SSE2
+// Color32 and Color64 without going through memory; the same arithmetic.
+template <typename O>
+inline blur_i4 box_in(rgba8<O> const &p) {
+        int32_t bits;
+        std::memcpy(&bits, &p, 4);
+        const __m128i zero = _mm_setzero_si128();
+        return {_mm_unpacklo_epi16(_mm_unpacklo_epi8(
+                _mm_cvtsi32_si128(bits), zero), zero)};
+}
+
+template <typename O>
+inline blur_i4 box_in(rgba16<O> const &p) {
+        return {_mm_unpacklo_epi16(
+                _mm_loadl_epi64(reinterpret_cast<__m128i const*>(&p)),
+                _mm_setzero_si128())};
+}
+
+inline void store_px8(__m128i v, void *p) {
+        const __m128i w = _mm_packs_epi32(v, v);
+        const int32_t bits = _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+        std::memcpy(p, &bits, 4);
+}
+
+inline void store_px16(__m128i v, void *p) {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p),
+                         packus_epi32_sse2(v, v));
+}
+
+template <typename O>
+inline void box_out(blur_i4 sum, float inv, rgba8<O> &p) {
+        store_px8(round_clamped(_mm_mul_ps(_mm_cvtepi32_ps(sum.v),
+                                           _mm_set1_ps(inv)), 255.f), &p);
+}
+
+template <typename O>
+inline void box_out(blur_i4 sum, float inv, rgba16<O> &p) {
+        store_px16(round_clamped(_mm_mul_ps(_mm_cvtepi32_ps(sum.v),
+                                            _mm_set1_ps(inv)), 65535.f), &p);
+}
+
+template <typename O>
+inline blur_f4 iir_in(rgba8<O> const &p) {
+        return {_mm_cvtepi32_ps(box_in(p).v)};
+}
+
+template <typename O>
+inline blur_f4 iir_in(rgba16<O> const &p) {
+        return {_mm_cvtepi32_ps(box_in(p).v)};
+}
+
+template <typename O>
+inline void iir_out(blur_f4 x, rgba8<O> &p) {
+        store_px8(round_clamped(x.v, 255.f), &p);
+}
+
+template <typename O>
+inline void iir_out(blur_f4 x, rgba16<O> &p) {
+        store_px16(round_clamped(x.v, 65535.f), &p);
+}
+#endif
+
+// -- box passes ---------------------------------------------------------------
+// The window of position i is [i-r, i+r] clipped to [0, n).
+inline float box_inverse_count(int i, int r, int n) {
+        return 1.f / float(std::min(i + r, n - 1) - std::max(i - r, 0) + 1);
+}
+
+// One row; src and dst must not overlap.
+template <typename T>
+inline void box_blur_row(T const *src, T *dst, int n, int r) {
+        using Sum = blur_sum<typename T::alpha_type>;
+        Sum sum{};
+        for (int x=0, end=std::min(r, n-1); x<=end; ++x)
+                sum = sum + box_in(src[x]);
+        const float inv_full = 1.f / float(2*r + 1);
+        for (int x=0; x!=n; ++x) {
+                const bool inside = x >= r && x + r < n;
+                box_out(sum, inside ? inv_full : box_inverse_count(x, r, n),
+                        dst[x]);
+                if (x + r + 1 < n)
+                        sum = sum + box_in(src[x + r + 1]);
+                if (x - r >= 0)
+                        sum = sum - box_in(src[x - r]);
+        }
+}
+
+// Columns [x0, x1) of src to dst, with one running sum per column.
+template <typename T, typename Sum>
+inline void box_blur_columns(image_view<T> const &src, base_image<T> &dst,
+                             int x0, int x1, int r, std::vector<Sum> &sums) {
+        const int w = x1 - x0, h = src.height();
+        sums.assign(w, Sum{});
+        for (int y=0, end=std::min(r, h-1); y<=end; ++y) {
+                T const *in = src.row(y) + x0;
+                for (int i=0; i!=w; ++i)
+                        sums[i] = sums[i] + box_in(in[i]);
+        }
+        const float inv_full = 1.f / float(2*r + 1);
+        for (int y=0; y!=h; ++y) {
+                const float inv = y >= r && y + r < h
+                        ? inv_full : box_inverse_count(y, r, h);
+                T *out = dst.row(y) + x0;
+                for (int i=0; i!=w; ++i)
+                        box_out(sums[i], inv, out[i]);
+                T const *enter = y + r + 1 < h ? src.row(y + r + 1) + x0
+                                               : nullptr;
+                T const *leave = y - r >= 0 ? src.row(y - r) + x0 : nullptr;
+                if (enter && leave) {
+                        for (int i=0; i!=w; ++i)
+                                sums[i] = sums[i] + box_in(enter[i])
+                                                  - box_in(leave[i]);
+                } else if (enter) {
+                        for (int i=0; i!=w; ++i)
+                                sums[i] = sums[i] + box_in(enter[i]);
+                } else if (leave) {
+                        for (int i=0; i!=w; ++i)
+                                sums[i] = sums[i] - box_in(leave[i]);
+                }
+        }
+}
+
+// Columns per strip of the vertical passes: the sums (4 KiB for 256
+// integer sums) and the strip of a few rows stay in L1.
+constexpr int blur_strip = 256;
+
+// Horizontal box blurs with each of radii in turn, row by row through two
+// row buffers, so that repeated passes stay in cache.
+template <typename ExecutionPolicy, typename T>
+inline void box_blur_rows(ExecutionPolicy const &policy,
+                          image_view<T> const &src, base_image<T> &dst,
+                          std::vector<int> const &radii) {
+        const int w = src.width();
+        for_each_band(policy, src.height(),
+                      (src.stride() + dst.stride()) * sizeof(T), 1,
+                      [&] (int y0, int y1) {
+                std::vector<T> a(radii.size() > 1 ? w : 0);
+                std::vector<T> b(radii.size() > 2 ? w : 0);
+                for (int y=y0; y!=y1; ++y) {
+                        T const *in = src.row(y);
+                        for (std::size_t k=0; k!=radii.size(); ++k) {
+                                T *out = k + 1 == radii.size() ? dst.row(y)
+                                       : k % 2 == 0 ? a.data() : b.data();
+                                box_blur_row(in, out, w, radii[k]);
+                                in = out;
+                        }
+                }
+        });
+}
+
+template <typename ExecutionPolicy, typename T>
+inline void box_blur_columns(ExecutionPolicy const &policy,
+                             image_view<T> const &src, base_image<T> &dst,
+                             int r) {
+        using Sum = blur_sum<typename T::alpha_type>;
+        const int strips = (src.width() + blur_strip - 1) / blur_strip;
+        for_each_band(policy, strips,
+                      std::size_t(src.height()) * blur_strip * sizeof(T) * 2,
+                      1, [&] (int s0, int s1) {
+                std::vector<Sum> sums;
+                for (int s=s0; s!=s1; ++s)
+                        box_blur_columns(src, dst, s * blur_strip,
+                                         std::min(src.width(),
+                                                  (s + 1) * blur_strip),
+                                         r, sums);
+        });
+}
+
+// Horizontal passes with radii_x, then vertical ones with radii_y.
+template <typename ExecutionPolicy, typename T>
+inline base_image<T> box_blur_passes(ExecutionPolicy const &policy,
+                                     image_view<T> const &src,
+                                     std::vector<int> radii_x,
+                                     std::vector<int> radii_y) {
+        for (int &r : radii_x)
+                r = std::min(r, src.width() - 1);
+        for (int &r : radii_y)
+                r = std::min(r, src.height() - 1);
+        radii_x.erase(std::remove(radii_x.begin(), radii_x.end(), 0),
+                      radii_x.end());
+        radii_y.erase(std::remove(radii_y.begin(), radii_y.end(), 0),
+                      radii_y.end());
+
+        base_image<T> ret{src.width(), src.height()};
+        if (radii_x.empty() && radii_y.empty()) {
+                for (int y=0; y!=src.height(); ++y)
+                        copy_n(src.row(y), src.width(), ret.row(y));
+                return ret;
+        }
+        if (radii_y.empty()) {
+                box_blur_rows(policy, src, ret, radii_x);
+                return ret;
+        }
+
+        // Passes alternate between ret and spare.
+        const int w = src.width(), h = src.height();
+        const bool two = radii_y.size() + !radii_x.empty() > 1;
+        base_image<T> spare{two ? w : 0, two ? h : 0};
+        image_view<T> in = src;
+        if (!radii_x.empty()) {
+                box_blur_rows(policy, src, ret, radii_x);
+                in = image_view<T>{ret};
+        }
+        for (int r : radii_y) {
+                base_image<T> &out = in.data() == ret.data() ? spare : ret;
+                box_blur_columns(policy, in, out, r);
+                in = image_view<T>{out};
+        }
+        return in.data() == ret.data() ? std::move(ret) : std::move(spare);
+}
+
+// The radii of n box blurs whose combined variance is about sigma^2
+// (Kovesi, "Fast almost-Gaussian filtering"): widths w and w + 2 around
+// sqrt(12 sigma^2 / n + 1).
+inline std::vector<int> gaussian_box_radii(double sigma, int n) {
+        const double ideal = std::sqrt(12 * sigma * sigma / n + 1);
+        int wl = static_cast<int>(std::floor(ideal));
+        if (wl % 2 == 0)
+                --wl;
+        const int wu = wl + 2;
+        const int m = static_cast<int>(std::lround(
+                (12 * sigma * sigma - n * double(wl) * wl - 4.0 * n * wl
+                 - 3 * n)
+                / (-4.0 * wl - 4)));
+        std::vector<int> radii(n);
+        for (int i=0; i!=n; ++i)
+                radii[i] = ((i < m ? wl : wu) - 1) / 2;
+        return radii;
+}
+
+// The largest sigma for which gaussian_box_radii(sigma, n) stays within
+// the radius limit of box_blur(), 16383: the widest box has at most
+// sqrt(12 sigma^2 / n + 1) + 2 pixels.
+inline double gaussian_box_max_sigma(int n) {
+        const double w = 2.0 * 16383 - 1;
+        return std::sqrt((w * w - 1) * n / 12);
+}
+
+// -- recursive Gaussian -------------------------------------------------------
+// Young, van Vliet, "Recursive implementation of the Gaussian filter"
+// (1995): w[i] = B x[i] + b1 w[i-1] + b2 w[i-2] + b3 w[i-3] forwards, the
+// same backwards over w. The coefficients are normalized by b0.
+struct iir_coefficients {
+        float B, b1, b2, b3;
+
+        explicit iir_coefficients(double sigma) {
+                const double q = sigma >= 2.5
+                        ? 0.98711 * sigma - 0.96330
+                        : 3.97156 - 4.14554 * std::sqrt(1 - 0.26891 * sigma);
+                const double q2 = q * q, q3 = q2 * q;
+                const double c0 = 1.57825 + 2.44413*q + 1.4281*q2
+                                + 0.422205*q3;
+                const double c1 = 2.44413*q + 2.85619*q2 + 1.26661*q3;
+                const double c2 = -(1.4281*q2 + 1.26661*q3);
+                const double c3 = 0.422205*q3;
+                b1 = float(c1 / c0);
+                b2 = float(c2 / c0);
+                b3 = float(c3 / c0);
+                B = float(1 - (c1 + c2 + c3) / c0);
+        }
+
+        blur_f4 step(blur_f4 x, blur_f4 p1, blur_f4 p2, blur_f4 p3) const {
+                return x * B + p1 * b1 + p2 * b2 + p3 * b3;
+        }
+};
+
+// One row; src and dst may be the same. buffer holds n values.
+template <typename T>
+inline void iir_blur_row(T const *src, T *dst, int n,
+                         iir_coefficients const &c,
+                         std::vector<blur_f4> &buffer) {
+        buffer.resize(n);
+        blur_f4 p1 = iir_in(src[0]), p2 = p1, p3 = p1;
+        for (int x=0; x!=n; ++x) {
+                const blur_f4 v = c.step(iir_in(src[x]), p1, p2, p3);
+                buffer[x] = v;
+                p3 = p2, p2 = p1, p1 = v;
+        }
+        p1 = p2 = p3 = buffer[n - 1];
+        for (int x=n-1; x>=0; --x) {
+                const blur_f4 v = c.step(buffer[x], p1, p2, p3);
+                iir_out(v, dst[x]);
+                p3 = p2, p2 = p1, p1 = v;
+        }
+}
+
+// Columns [x0, x1) in place: the forward recursion for all of them, row by
+// row, then the backward one. buffer holds the forward values of the h
+// rows, after the first row of input (the values before the image) and
+// followed by a copy of the last forward row (the values after it).
+template <typename T>
+inline void iir_blur_columns(base_image<T> &img, int x0, int x1,
+                             iir_coefficients const &c,
+                             std::vector<blur_f4> &buffer) {
+        const int w = x1 - x0, h = img.height();
+        buffer.resize(std::size_t(w) * (h + 2));
+        // Row y of the forward values, -1 and h being the borders.
+        const auto row = [&] (int y) {
+                return &buffer[std::size_t(std::min(std::max(y, -1), h) + 1)
+                               * w];
+        };
+        for (int i=0; i!=w; ++i)
+                row(-1)[i] = iir_in(img.row(0)[x0 + i]);
+        for (int y=0; y!=h; ++y) {
+                T const *in = img.row(y) + x0;
+                blur_f4 *v = row(y);
+                blur_f4 const *p1 = row(y-1), *p2 = row(y-2), *p3 = row(y-3);
+                for (int i=0; i!=w; ++i)
+                        v[i] = c.step(iir_in(in[i]), p1[i], p2[i], p3[i]);
+        }
+        std::copy(row(h-1), row(h-1) + w, row(h));
+        // The backward values replace the forward ones, which are read
+        // just before.
+        for (int y=h-1; y>=0; --y) {
+                T *out = img.row(y) + x0;
+                blur_f4 *v = row(y);
+                blur_f4 const *p1 = row(y+1), *p2 = row(y+2), *p3 = row(y+3);
+                for (int i=0; i!=w; ++i) {
+                        v[i] = c.step(v[i], p1[i], p2[i], p3[i]);
+                        iir_out(v[i], out[i]);
+                }
+        }
+}
+
+// Column strips for the recursive filter: 32 pixels of floats are 512
+// bytes per row, so a strip of a 4096 row image needs 2 MiB.
+constexpr int iir_strip = 32;
+
+template <typename ExecutionPolicy, typename T>
+inline base_image<T> iir_blur(ExecutionPolicy const &policy,
+                              image_view<T> const &src, double sigma) {
+        const iir_coefficients c{sigma};
+        base_image<T> ret{src.width(), src.height()};
+        for_each_band(policy, src.height(),
+                      (src.stride() + ret.stride()) * sizeof(T), 1,
+                      [&] (int y0, int y1) {
+                std::vector<blur_f4> buffer;
+                for (int y=y0; y!=y1; ++y)
+                        iir_blur_row(src.row(y), ret.row(y), src.width(), c,
+                                     buffer);
+        });
+        const int strips = (src.width() + iir_strip - 1) / iir_strip;
+        for_each_band(policy, strips,
+                      std::size_t(src.height()) * iir_strip
+                              * sizeof(blur_f4),
+                      1, [&] (int s0, int s1) {
+                std::vector<blur_f4> buffer;
+                for (int s=s0; s!=s1; ++s)
+                        iir_blur_columns(ret, s * iir_strip,
+                                         std::min(src.width(),
+                                                  (s + 1) * iir_strip),
+                                         c, buffer);
+        });
+        return ret;
+}
+
+// -- exact Gaussian -----------------------------------------------------------
+// Taps out to ceil(3 sigma) on both sides: with a support of that plus
+// 0.5, make_resample_weights() reads exactly those positions.
+inline resample_weights gaussian_weights(int n, double sigma) {
+        const double radius = std::ceil(3 * sigma);
+        return make_resample_weights(n, n, radius + 0.5, [sigma] (double x) {
+                return std::exp(-x * x / (2 * sigma * sigma));
+        });
+}
+
+template <typename ExecutionPolicy, typename T>
+inline base_image<T> exact_gaussian_blur(ExecutionPolicy const &policy,
+                                         image_view<T> const &src,
+                                         double sigma) {
+        base_image<T> tmp{src.width(), src.height()};
+        resize_rows(policy, src, 0, tmp,
+                    gaussian_weights(src.width(), sigma));
+        base_image<T> ret{src.width(), src.height()};
+        resize_columns(policy, image_view<T>{tmp}, 0, ret,
+                       gaussian_weights(src.height(), sigma));
+        return ret;
+}
+
+} }
+
+namespace puffin {
+
+template <typename ExecutionPolicy, typename T>
+inline auto box_blur(ExecutionPolicy const &policy, image_view<T> const &src,
+                     int radius_x, int radius_y)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        impl::greater_than(src.width(), 0);
+        impl::greater_than(src.height(), 0);
+        impl::less_or_equal(impl::positive(radius_x), 16383);
+        impl::less_or_equal(impl::positive(radius_y), 16383);
+        return impl::box_blur_passes(policy, src, {radius_x}, {radius_y});
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto box_blur(ExecutionPolicy const &policy, image_view<T> const &src,
+                     int radius)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return box_blur(policy, src, radius, radius);
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto box_blur(ExecutionPolicy const &policy, base_image<T> const &src,
+                     int radius)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return box_blur(policy, image_view<T>{src}, radius, radius);
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto box_blur(ExecutionPolicy const &policy, base_image<T> const &src,
+                     int radius_x, int radius_y)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return box_blur(policy, image_view<T>{src}, radius_x, radius_y);
+}
+
+template <typename T>
+inline base_image<T> box_blur(image_view<T> const &src, int radius) {
+        return box_blur(execution::seq, src, radius, radius);
+}
+
+template <typename T>
+inline base_image<T> box_blur(image_view<T> const &src,
+                              int radius_x, int radius_y) {
+        return box_blur(execution::seq, src, radius_x, radius_y);
+}
+
+template <typename T>
+inline base_image<T> box_blur(base_image<T> const &src, int radius) {
+        return box_blur(execution::seq, image_view<T>{src}, radius, radius);
+}
+
+template <typename T>
+inline base_image<T> box_blur(base_image<T> const &src,
+                              int radius_x, int radius_y) {
+        return box_blur(execution::seq, image_view<T>{src},
+                        radius_x, radius_y);
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto gaussian_blur(ExecutionPolicy const &policy,
+                          image_view<T> const &src, double sigma,
+                          BlurMethod method)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        impl::greater_than(src.width(), 0);
+        impl::greater_than(src.height(), 0);
+        impl::positive(sigma);
+
+        if (method == BlurMethod::Auto) {
+                method = sigma > 2 &&
+                         sigma <= impl::gaussian_box_max_sigma(3)
+                         ? BlurMethod::Box
+                         : BlurMethod::Exact;
+        }
+        if (method == BlurMethod::Box)
+                impl::less_or_equal(sigma, impl::gaussian_box_max_sigma(3));
+        if (method == BlurMethod::Iir && sigma < 0.5)
+                method = BlurMethod::Exact;
+
+        if (sigma == 0)
+                return impl::box_blur_passes(policy, src, {}, {});
+        switch (method) {
+        case BlurMethod::Box:
+                return impl::box_blur_passes(
+                        policy, src,
+                        impl::gaussian_box_radii(sigma, 3),
+                        impl::gaussian_box_radii(sigma, 3));
+        case BlurMethod::Iir:
+                return impl::iir_blur(policy, src, sigma);
+        case BlurMethod::Exact:
+        default:
+                return impl::exact_gaussian_blur(policy, src, sigma);
+        }
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto gaussian_blur(ExecutionPolicy const &policy,
+                          base_image<T> const &src, double sigma,
+                          BlurMethod method)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return gaussian_blur(policy, image_view<T>{src}, sigma, method);
+}
+
+template <typename T>
+inline base_image<T> gaussian_blur(image_view<T> const &src, double sigma,
+                                   BlurMethod method) {
+        return gaussian_blur(execution::seq, src, sigma, method);
+}
+
+template <typename T>
+inline base_image<T> gaussian_blur(base_image<T> const &src, double sigma,
+                                   BlurMethod method) {
+        return gaussian_blur(execution::seq, image_view<T>{src}, sigma,
+                             method);
+}
+
+}
+
+#endif //BLUR_HH_INCLUDED_20261018
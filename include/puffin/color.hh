@@ -5,10 +5,24 @@
 #include "impl/compiler.hh"
 #include <limits>
 #include <cstdint>
+#include <type_traits>
 
 namespace puffin {
 
-class ColorSpace {}; // TODO: Color space support
+// __ ColorSpace _______________________________________________________________
+// How the colour channels of pixels encode light:
+//
+// - Srgb: with the sRGB transfer function ("gamma encoded"), as decoded
+//   images, screens and most files are. Perceptually even, but averages
+//   and blends of encoded values come out too dark.
+// - Linear: proportional to light intensity. Filtering, blending and
+//   scaling are physically correct on linear values.
+//
+// Alpha is linear in both. See color_space.hh for conversions.
+enum class ColorSpace {
+        Srgb,
+        Linear
+};
 
 // __ rgba_scalar_traits<T> ____________________________________________________
 template <typename ScalarT, typename=void>
@@ -80,16 +94,56 @@ struct basic_rgba_base<RgbaCommonT, RgbaCommonT, RgbaCommonT, RgbaCommonT> {
 };
 }
 
+// __ channel order ____________________________________________________________
+// The order in which basic_rgba stores its channels in memory. It does not
+// change the interface: constructors always take r, g, b(, a) and the
+// accessors are the same.
+struct rgba_order {}; // r g b a, as in RGBA8888 byte order
+struct bgra_order {}; // b g r a, as BMP rows and ARGB8888 (little endian)
+
+namespace impl {
+template<typename RedT, typename GreenT, typename BlueT, typename AlphaT,
+         typename OrderT>
+struct basic_rgba_storage;
+
+template<typename RedT, typename GreenT, typename BlueT, typename AlphaT>
+struct basic_rgba_storage<RedT, GreenT, BlueT, AlphaT, rgba_order> {
+        basic_rgba_storage(RedT r, GreenT g, BlueT b, AlphaT a) :
+                r_(r), g_(g), b_(b), a_(a)
+        {}
+protected:
+        RedT   r_;
+        GreenT g_;
+        BlueT  b_;
+        AlphaT a_;
+};
+
+template<typename RedT, typename GreenT, typename BlueT, typename AlphaT>
+struct basic_rgba_storage<RedT, GreenT, BlueT, AlphaT, bgra_order> {
+        basic_rgba_storage(RedT r, GreenT g, BlueT b, AlphaT a) :
+                b_(b), g_(g), r_(r), a_(a)
+        {}
+protected:
+        BlueT  b_;
+        GreenT g_;
+        RedT   r_;
+        AlphaT a_;
+};
+}
+
 // __ basic_rgba<T> ____________________________________________________________
-template <typename RedT, typename GreenT, typename BlueT, typename AlphaT>
+template <typename RedT, typename GreenT, typename BlueT, typename AlphaT,
+          typename OrderT = rgba_order>
 struct basic_rgba
         : impl::basic_rgba_base<RedT, GreenT, BlueT, AlphaT>
+        , impl::basic_rgba_storage<RedT, GreenT, BlueT, AlphaT, OrderT>
 {
         // -- types ------------------------------------------------------------
         typedef RedT   red_type;
         typedef GreenT green_type;
         typedef BlueT  blue_type;
         typedef AlphaT alpha_type;
+        typedef OrderT order_type;
 
         typedef rgba_scalar_traits<red_type>   red_traits_type;
         typedef rgba_scalar_traits<green_type> green_traits_type;
@@ -113,48 +167,21 @@ struct basic_rgba
         //   - true, if RedT, GreenT, BlueT and AlphaT are the same,
         //   - false, otherwise.
         //
+        typedef impl::basic_rgba_storage<RedT, GreenT, BlueT, AlphaT, OrderT>
+                storage_type;
 
         // -- ctor/dtor/copy/move ----------------------------------------------
-        basic_rgba(basic_rgba const &v) :
-                r_(v.r_),
-                g_(v.g_),
-                b_(v.b_),
-                a_(v.a_)
-        {}
-
-        basic_rgba& operator= (basic_rgba const &v) {
-                r_ = v.r_;
-                g_ = v.g_;
-                b_ = v.b_;
-                a_ = v.a_;
-                return *this;
-        }
-
-#if PUFFIN_HAS_MOVE_SEMANTICS
-        basic_rgba(basic_rgba &&v) :
-                r_(std::move(v.r_)),
-                g_(std::move(v.g_)),
-                b_(std::move(v.b_)),
-                a_(std::move(v.a_))
-        {}
-
-        basic_rgba& operator= (basic_rgba &&v) {
-                r_ = std::move(v.r_);
-                g_ = std::move(v.g_);
-                b_ = std::move(v.b_);
-                a_ = std::move(v.a_);
-                return *this;
-        }
-#endif
+        // Copy and move are implicit, which keeps basic_rgba trivially
+        // copyable: images of it are copied and filled with memcpy/memset.
 
         // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
         // basic_rgba() -> {default, default, default, default}
         // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
         basic_rgba() :
-                r_(red_traits_type::color_default()),
-                g_(green_traits_type::color_default()),
-                b_(blue_traits_type::color_default()),
-                a_(alpha_traits_type::alpha_default())
+                storage_type(red_traits_type::color_default(),
+                             green_traits_type::color_default(),
+                             blue_traits_type::color_default(),
+                             alpha_traits_type::alpha_default())
         {}
 
         // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -168,7 +195,7 @@ struct basic_rgba
         explicit basic_rgba(
                 red_type   v
         ) :
-                r_(v), g_(v), b_(v), a_(alpha_traits_type::alpha_default())
+                storage_type(v, v, v, alpha_traits_type::alpha_default())
         {}
 
         template< typename =
@@ -177,7 +204,7 @@ struct basic_rgba
                 red_type   v,
                 alpha_type a
         ) :
-                r_(v), g_(v), b_(v), a_(a)
+                storage_type(v, v, v, a)
         {}
 
         // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -188,7 +215,7 @@ struct basic_rgba
                 green_type g,
                 blue_type  b
         ) :
-                r_(r), g_(g), b_(b), a_(alpha_traits_type::alpha_default())
+                storage_type(r, g, b, alpha_traits_type::alpha_default())
         {}
 
         basic_rgba(
@@ -197,31 +224,57 @@ struct basic_rgba
                 blue_type  b,
                 alpha_type a
         ) :
-                r_(r), g_(g), b_(b), a_(a)
+                storage_type(r, g, b, a)
         {}
 
-        // -- accessors --------------------------------------------------------
-        red_type   r()  const { return r_; }
-        green_type g()  const { return g_; }
-        blue_type  b()  const { return b_; }
-        alpha_type a()  const { return a_; }
-
-        void r(red_type   const &v)  { r_ = v; }
-        void g(green_type const &v)  { g_ = v; }
-        void b(blue_type  const &v)  { b_ = v; }
-        void a(alpha_type const &v)  { a_ = v; }
+        // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+        // basic_rgba(basic_rgba<..., other order>) -> same channels
+        // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+        template <typename OtherOrderT>
+        explicit basic_rgba(
+                basic_rgba<RedT, GreenT, BlueT, AlphaT, OtherOrderT> const &v
+        ) :
+                storage_type(v.r(), v.g(), v.b(), v.a())
+        {}
 
-private:
-        // -- fields -----------------------------------------------------------
-        red_type   r_;
-        green_type g_;
-        blue_type  b_;
-        alpha_type a_;
+        // -- accessors --------------------------------------------------------
+        red_type   r()  const { return this->r_; }
+        green_type g()  const { return this->g_; }
+        blue_type  b()  const { return this->b_; }
+        alpha_type a()  const { return this->a_; }
+
+        void r(red_type   const &v)  { this->r_ = v; }
+        void g(green_type const &v)  { this->g_ = v; }
+        void b(blue_type  const &v)  { this->b_ = v; }
+        void a(alpha_type const &v)  { this->a_ = v; }
 };
 
 typedef basic_rgba<uint16_t, uint16_t, uint16_t, uint16_t> Color64;
 typedef basic_rgba<uint8_t, uint8_t, uint8_t, uint8_t> Color32;
 
+typedef basic_rgba<uint16_t, uint16_t, uint16_t, uint16_t, bgra_order>
+        Color64Bgra;
+typedef basic_rgba<uint8_t, uint8_t, uint8_t, uint8_t, bgra_order>
+        Color32Bgra;
+
+// Channels in [0, 1], e.g. linear light without rounding (color_space.hh).
+typedef basic_rgba<float, float, float, float> ColorF;
+
+static_assert(sizeof(Color32) == 4 && sizeof(Color64) == 8 &&
+              sizeof(Color32Bgra) == 4 && sizeof(Color64Bgra) == 8,
+              "pixels must be four packed channels");
+static_assert(sizeof(ColorF) == 16, "pixels must be four packed channels");
+static_assert(std::is_trivially_copyable<Color32>::value &&
+              std::is_trivially_copyable<Color64>::value &&
+              std::is_trivially_copyable<Color32Bgra>::value &&
+              std::is_trivially_copyable<Color64Bgra>::value,
+              "pixels must be trivially copyable");
+static_assert(std::is_standard_layout<Color32>::value &&
+              std::is_standard_layout<Color64>::value &&
+              std::is_standard_layout<Color32Bgra>::value &&
+              std::is_standard_layout<Color64Bgra>::value,
+              "pixels must be standard layout");
+
 }
 
 #endif // COLOR_HH_INCLUDED_20181221
@@ -0,0 +1,637 @@
+#ifndef COLOR_OPS_HH_INCLUDED_20261018
+#define COLOR_OPS_HH_INCLUDED_20261018
+
+#include "color.hh"
+#include "impl/compiler.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin {
+
+// -- arithmetic on basic_rgba -------------------------------------------------
+// All operations work channel-wise, on alpha as well.
+//
+// For unsigned integer channels, results saturate to [0, max]:
+//   - a + b, a - b     saturating add/subtract
+//   - a * b            modulate, a*b/max rounded to nearest
+//   - a * f, a / f     scale by a real factor, rounded to nearest (even)
+//   - lerp(a, b, t)    a + (b-a)*t, rounded to nearest (even)
+// Scaling and lerp compute in float, the same way as the SIMD span
+// functions below, so both give identical results. Floating point
+// channels use plain arithmetic without clamping.
+//
+// The *_span functions apply an operation to n pixels, out[i] = op(a[i],
+// b[i]) or op(a[i], v); out may be a or b. Color32 and Color64 spans, in
+// either channel order, use SSE2; any other T falls back to the single
+// pixel operators.
+
+namespace impl {
+template <typename S, typename = void>
+struct channel_arith;
+
+template <typename S>
+struct channel_arith<S, typename std::enable_if<
+        std::is_integral<S>::value && std::is_unsigned<S>::value>::type>
+{
+        static constexpr S max_value = std::numeric_limits<S>::max();
+        static constexpr int bits = std::numeric_limits<S>::digits;
+        using real = typename std::conditional<
+                (sizeof(S) <= 2), float, double>::type;
+
+        static S add(S a, S b) {
+                return b > S(max_value - a) ? max_value : S(a + b);
+        }
+        static S sub(S a, S b) {
+                return a > b ? S(a - b) : S(0);
+        }
+        static S mul(S a, S b) {
+                // Exact round(a*b / max) for max = 2^bits - 1.
+                const uint64_t t = uint64_t(a) * b + (uint64_t(1) << (bits-1));
+                return S((t + (t >> bits)) >> bits);
+        }
+        static S from_real(real v) {
+                v = std::min(std::max(v, real(0)), real(max_value));
+                return S(std::nearbyint(v));
+        }
+        static S from_unit(double f) {
+                return from_real(real(f) * real(max_value));
+        }
+        static S scale(S a, double f) {
+                return from_real(real(a) * real(f));
+        }
+        static S lerp(S a, S b, double t) {
+                const real ra = real(a);
+                return from_real(ra + (real(b) - ra) * real(t));
+        }
+};
+
+template <typename S>
+struct channel_arith<S, typename std::enable_if<
+        std::is_floating_point<S>::value>::type>
+{
+        static S add(S a, S b) { return a + b; }
+        static S sub(S a, S b) { return a - b; }
+        static S mul(S a, S b) { return a * b; }
+        static S from_unit(double f) { return S(f); }
+        static S scale(S a, double f) { return S(a * f); }
+        static S lerp(S a, S b, double t) { return S(a + (b - a) * t); }
+};
+
+// The pixel that a plain number stands for where images are combined with
+// one, as in min(img, 0.9): for basic_rgba, f is a fraction of full scale
+// (0 black, 1 white) in every channel, alpha included, rounded to nearest
+// and clamped for integer channels. Other types take f as their value.
+template <typename T>
+inline auto pixel_from_scalar(double f, T const *)
+        -> typename std::enable_if<std::is_arithmetic<T>::value, T>::type
+{
+        return static_cast<T>(f);
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> pixel_from_scalar(
+        double f, basic_rgba<R, G, B, A, O> const *) {
+        return basic_rgba<R, G, B, A, O>(channel_arith<R>::from_unit(f),
+                                         channel_arith<G>::from_unit(f),
+                                         channel_arith<B>::from_unit(f),
+                                         channel_arith<A>::from_unit(f));
+}
+
+template <typename T>
+inline T pixel_from_scalar(double f) {
+        return pixel_from_scalar(f, static_cast<T const*>(nullptr));
+}
+}
+
+#define PUFFIN_RGBA_CHANNELWISE(expr_r, expr_g, expr_b, expr_a)                \
+        basic_rgba<R, G, B, A, O>(expr_r, expr_g, expr_b, expr_a)
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> operator+ (basic_rgba<R, G, B, A, O> const &x,
+                                         basic_rgba<R, G, B, A, O> const &y) {
+        return PUFFIN_RGBA_CHANNELWISE(
+                impl::channel_arith<R>::add(x.r(), y.r()),
+                impl::channel_arith<G>::add(x.g(), y.g()),
+                impl::channel_arith<B>::add(x.b(), y.b()),
+                impl::channel_arith<A>::add(x.a(), y.a()));
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> operator- (basic_rgba<R, G, B, A, O> const &x,
+                                         basic_rgba<R, G, B, A, O> const &y) {
+        return PUFFIN_RGBA_CHANNELWISE(
+                impl::channel_arith<R>::sub(x.r(), y.r()),
+                impl::channel_arith<G>::sub(x.g(), y.g()),
+                impl::channel_arith<B>::sub(x.b(), y.b()),
+                impl::channel_arith<A>::sub(x.a(), y.a()));
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> operator* (basic_rgba<R, G, B, A, O> const &x,
+                                         basic_rgba<R, G, B, A, O> const &y) {
+        return PUFFIN_RGBA_CHANNELWISE(
+                impl::channel_arith<R>::mul(x.r(), y.r()),
+                impl::channel_arith<G>::mul(x.g(), y.g()),
+                impl::channel_arith<B>::mul(x.b(), y.b()),
+                impl::channel_arith<A>::mul(x.a(), y.a()));
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> operator* (basic_rgba<R, G, B, A, O> const &x,
+                                         double f) {
+        return PUFFIN_RGBA_CHANNELWISE(
+                impl::channel_arith<R>::scale(x.r(), f),
+                impl::channel_arith<G>::scale(x.g(), f),
+                impl::channel_arith<B>::scale(x.b(), f),
+                impl::channel_arith<A>::scale(x.a(), f));
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> operator* (double f,
+                                         basic_rgba<R, G, B, A, O> const &x) {
+        return x * f;
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> operator/ (basic_rgba<R, G, B, A, O> const &x,
+                                         double f) {
+        return x * (1.0 / f);
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> lerp(basic_rgba<R, G, B, A, O> const &x,
+                                   basic_rgba<R, G, B, A, O> const &y,
+                                   double t) {
+        return PUFFIN_RGBA_CHANNELWISE(
+                impl::channel_arith<R>::lerp(x.r(), y.r(), t),
+                impl::channel_arith<G>::lerp(x.g(), y.g(), t),
+                impl::channel_arith<B>::lerp(x.b(), y.b(), t),
+                impl::channel_arith<A>::lerp(x.a(), y.a(), t));
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> min(basic_rgba<R, G, B, A, O> const &x,
+                                  basic_rgba<R, G, B, A, O> const &y) {
+        return PUFFIN_RGBA_CHANNELWISE(
+                std::min(x.r(), y.r()), std::min(x.g(), y.g()),
+                std::min(x.b(), y.b()), std::min(x.a(), y.a()));
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> max(basic_rgba<R, G, B, A, O> const &x,
+                                  basic_rgba<R, G, B, A, O> const &y) {
+        return PUFFIN_RGBA_CHANNELWISE(
+                std::max(x.r(), y.r()), std::max(x.g(), y.g()),
+                std::max(x.b(), y.b()), std::max(x.a(), y.a()));
+}
+
+#undef PUFFIN_RGBA_CHANNELWISE
+
+// Channel-wise clamp of x to [lo, hi].
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> clamp(basic_rgba<R, G, B, A, O> const &x,
+                                    basic_rgba<R, G, B, A, O> const &lo,
+                                    basic_rgba<R, G, B, A, O> const &hi) {
+        return min(max(x, lo), hi);
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline bool operator== (basic_rgba<R, G, B, A, O> const &x,
+                        basic_rgba<R, G, B, A, O> const &y) {
+        return x.r() == y.r() && x.g() == y.g() &&
+               x.b() == y.b() && x.a() == y.a();
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline bool operator!= (basic_rgba<R, G, B, A, O> const &x,
+                        basic_rgba<R, G, B, A, O> const &y) {
+        return !(x == y);
+}
+
+// Scalar counterpart, so that generic code (e.g. ImageFilter) can lerp
+// both pixel types.
+template <typename T>
+inline auto lerp(T a, T b, double t)
+        -> typename std::enable_if<std::is_arithmetic<T>::value, T>::type
+{
+        return T(a + (b - a) * t);
+}
+
+// -- spans, generic -----------------------------------------------------------
+template <typename T>
+inline void add_span(T const *a, T const *b, T *out, std::size_t n) {
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = a[i] + b[i];
+}
+
+template <typename T>
+inline void sub_span(T const *a, T const *b, T *out, std::size_t n) {
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = a[i] - b[i];
+}
+
+template <typename T>
+inline void mul_span(T const *a, T const *b, T *out, std::size_t n) {
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = a[i] * b[i];
+}
+
+template <typename T>
+inline void scale_span(T const *a, double f, T *out, std::size_t n) {
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = static_cast<T>(a[i] * f);
+}
+
+template <typename T>
+inline void div_span(T const *a, double f, T *out, std::size_t n) {
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = static_cast<T>(a[i] / f);
+}
+
+template <typename T>
+inline void lerp_span(T const *a, T const *b, double t, T *out,
+                      std::size_t n) {
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = lerp(a[i], b[i], t);
+}
+
+template <typename T>
+inline void min_span(T const *a, T const *b, T *out, std::size_t n) {
+        using std::min;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = min(a[i], b[i]);
+}
+
+template <typename T>
+inline void min_span(T const *a, T const &v, T *out, std::size_t n) {
+        using std::min;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = min(a[i], v);
+}
+
+template <typename T>
+inline void max_span(T const *a, T const *b, T *out, std::size_t n) {
+        using std::max;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = max(a[i], b[i]);
+}
+
+template <typename T>
+inline void max_span(T const *a, T const &v, T *out, std::size_t n) {
+        using std::max;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = max(a[i], v);
+}
+
+template <typename T>
+inline void clamp_span(T const *a, T const &lo, T const &hi, T *out,
+                       std::size_t n) {
+        max_span(a, lo, out, n);
+        min_span(out, hi, out, n);
+}
+
+}
+
+//==============================================================================
+// SSE2 spans for Color32 and Color64.
+//==============================================================================
+namespace puffin { namespace impl {
+
+// Both channel orders of Color32 and Color64: the span operations treat
+// all channels alike, so they share one implementation.
+template <typename O>
+using rgba8 = basic_rgba<uint8_t, uint8_t, uint8_t, uint8_t, O>;
+template <typename O>
+using rgba16 = basic_rgba<uint16_t, uint16_t, uint16_t, uint16_t, O>;
+
+#if PUFFIN_HAS_SSE2
+template <typename P>
+inline __m128i load_px(P const *p) {
+        return _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+}
+
+template <typename P>
+inline void store_px(P *p, __m128i v) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+// Four copies of a 4 byte pixel, or two of an 8 byte one.
+template <typename P>
+inline __m128i broadcast_px(P const &v) {
+        static_assert(sizeof(P) == 4 || sizeof(P) == 8, "");
+        int32_t bits[2];
+        std::memcpy(bits, &v, sizeof(P));
+        if (sizeof(P) == 4)
+                bits[1] = bits[0];
+        return _mm_set_epi32(bits[1], bits[0], bits[1], bits[0]);
+}
+
+// Unsigned 16 bit min/max through saturating subtraction.
+inline __m128i min_epu16(__m128i a, __m128i b) {
+        return _mm_sub_epi16(a, _mm_subs_epu16(a, b));
+}
+
+inline __m128i max_epu16(__m128i a, __m128i b) {
+        return _mm_add_epi16(b, _mm_subs_epu16(a, b));
+}
+
+// Packs two vectors of int32 in [0, 65535] into unsigned 16 bit.
+inline __m128i packus_epi32_sse2(__m128i lo, __m128i hi) {
+        const __m128i bias32 = _mm_set1_epi32(32768);
+        const __m128i bias16 = _mm_set1_epi16(-32768);
+        return _mm_add_epi16(_mm_packs_epi32(_mm_sub_epi32(lo, bias32),
+                                             _mm_sub_epi32(hi, bias32)),
+                             bias16);
+}
+
+// Rounds clamped floats to int32 (nearest even, as std::nearbyint).
+inline __m128i round_clamped(__m128 v, float hi) {
+        v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(hi));
+        return _mm_cvtps_epi32(v);
+}
+
+// -- 8 bit channel kernels
+inline __m128i mul_u8(__m128i a, __m128i b) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i half = _mm_set1_epi16(128);
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero),
+                                                   _mm_unpacklo_epi8(b, zero)),
+                                   half);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero),
+                                                   _mm_unpackhi_epi8(b, zero)),
+                                   half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        return _mm_packus_epi16(lo, hi);
+}
+
+// Calls f on the 16 channels of a and b as pairs of float vectors, and
+// packs the rounded, clamped results.
+template <typename F>
+inline __m128i map_u8_ps(__m128i a, __m128i b, F f) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i a16[2] = {_mm_unpacklo_epi8(a, zero),
+                                _mm_unpackhi_epi8(a, zero)};
+        const __m128i b16[2] = {_mm_unpacklo_epi8(b, zero),
+                                _mm_unpackhi_epi8(b, zero)};
+        __m128i r32[4];
+        for (int i=0; i!=4; ++i) {
+                const __m128i a32 = (i & 1)
+                        ? _mm_unpackhi_epi16(a16[i/2], zero)
+                        : _mm_unpacklo_epi16(a16[i/2], zero);
+                const __m128i b32 = (i & 1)
+                        ? _mm_unpackhi_epi16(b16[i/2], zero)
+                        : _mm_unpacklo_epi16(b16[i/2], zero);
+                r32[i] = round_clamped(f(_mm_cvtepi32_ps(a32),
+                                         _mm_cvtepi32_ps(b32)), 255.f);
+        }
+        return _mm_packus_epi16(_mm_packs_epi32(r32[0], r32[1]),
+                                _mm_packs_epi32(r32[2], r32[3]));
+}
+
+// -- 16 bit channel kernels
+inline __m128i mul_u16(__m128i a, __m128i b) {
+        const __m128i pl = _mm_mullo_epi16(a, b);
+        const __m128i ph = _mm_mulhi_epu16(a, b);
+        const __m128i half = _mm_set1_epi32(32768);
+        __m128i lo = _mm_add_epi32(_mm_unpacklo_epi16(pl, ph), half);
+        __m128i hi = _mm_add_epi32(_mm_unpackhi_epi16(pl, ph), half);
+        lo = _mm_srli_epi32(_mm_add_epi32(lo, _mm_srli_epi32(lo, 16)), 16);
+        hi = _mm_srli_epi32(_mm_add_epi32(hi, _mm_srli_epi32(hi, 16)), 16);
+        return packus_epi32_sse2(lo, hi);
+}
+
+template <typename F>
+inline __m128i map_u16_ps(__m128i a, __m128i b, F f) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo = round_clamped(
+                f(_mm_cvtepi32_ps(_mm_unpacklo_epi16(a, zero)),
+                  _mm_cvtepi32_ps(_mm_unpacklo_epi16(b, zero))),
+                65535.f);
+        const __m128i hi = round_clamped(
+                f(_mm_cvtepi32_ps(_mm_unpackhi_epi16(a, zero)),
+                  _mm_cvtepi32_ps(_mm_unpackhi_epi16(b, zero))),
+                65535.f);
+        return packus_epi32_sse2(lo, hi);
+}
+
+// Runs vop on 16 bytes at a time, sop on the remaining pixels. b is either
+// an array or, with broadcast_b, a single pixel.
+template <typename P, typename VecOp, typename ScalarOp>
+inline void binary_span_sse2(
+        P const *a, P const *b, bool broadcast_b,
+        P *out, std::size_t n,
+        VecOp vop, ScalarOp sop
+) {
+        constexpr std::size_t per = 16 / sizeof(P);
+        const __m128i vb = broadcast_px(*b);
+        std::size_t i = 0;
+        for (; i + per <= n; i += per) {
+                const __m128i x = load_px(a + i);
+                const __m128i y = broadcast_b ? vb : load_px(b + i);
+                store_px(out + i, vop(x, y));
+        }
+        for (; i != n; ++i)
+                out[i] = sop(a[i], broadcast_b ? *b : b[i]);
+}
+#endif
+
+} }
+
+namespace puffin {
+
+#if PUFFIN_HAS_SSE2
+// -- Color32, Color32Bgra -----------------------------------------------------
+template <typename O>
+inline void add_span(impl::rgba8<O> const *a, impl::rgba8<O> const *b,
+                     impl::rgba8<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return _mm_adds_epu8(x, y); },
+                [] (auto x, auto y) { return x + y; });
+}
+
+template <typename O>
+inline void sub_span(impl::rgba8<O> const *a, impl::rgba8<O> const *b,
+                     impl::rgba8<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return _mm_subs_epu8(x, y); },
+                [] (auto x, auto y) { return x - y; });
+}
+
+template <typename O>
+inline void mul_span(impl::rgba8<O> const *a, impl::rgba8<O> const *b,
+                     impl::rgba8<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return impl::mul_u8(x, y); },
+                [] (auto x, auto y) { return x * y; });
+}
+
+template <typename O>
+inline void scale_span(impl::rgba8<O> const *a, double f, impl::rgba8<O> *out,
+                       std::size_t n) {
+        const __m128 vf = _mm_set1_ps(static_cast<float>(f));
+        impl::binary_span_sse2(a, a, true, out, n,
+                [vf] (__m128i x, __m128i) {
+                        return impl::map_u8_ps(x, x, [vf] (__m128 v, __m128) {
+                                return _mm_mul_ps(v, vf);
+                        });
+                },
+                [f] (auto x, auto) { return x * f; });
+}
+
+template <typename O>
+inline void div_span(impl::rgba8<O> const *a, double f, impl::rgba8<O> *out,
+                     std::size_t n) {
+        scale_span(a, 1.0 / f, out, n);
+}
+
+template <typename O>
+inline void lerp_span(impl::rgba8<O> const *a, impl::rgba8<O> const *b,
+                      double t, impl::rgba8<O> *out, std::size_t n) {
+        const __m128 vt = _mm_set1_ps(static_cast<float>(t));
+        impl::binary_span_sse2(a, b, false, out, n,
+                [vt] (__m128i x, __m128i y) {
+                        return impl::map_u8_ps(x, y, [vt] (__m128 u, __m128 v) {
+                                return _mm_add_ps(
+                                        u, _mm_mul_ps(_mm_sub_ps(v, u), vt));
+                        });
+                },
+                [t] (auto x, auto y) { return lerp(x, y, t); });
+}
+
+template <typename O>
+inline void min_span(impl::rgba8<O> const *a, impl::rgba8<O> const *b,
+                     impl::rgba8<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return _mm_min_epu8(x, y); },
+                [] (auto x, auto y) { return min(x, y); });
+}
+
+template <typename O>
+inline void min_span(impl::rgba8<O> const *a, impl::rgba8<O> const &v,
+                     impl::rgba8<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, &v, true, out, n,
+                [] (__m128i x, __m128i y) { return _mm_min_epu8(x, y); },
+                [] (auto x, auto y) { return min(x, y); });
+}
+
+template <typename O>
+inline void max_span(impl::rgba8<O> const *a, impl::rgba8<O> const *b,
+                     impl::rgba8<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return _mm_max_epu8(x, y); },
+                [] (auto x, auto y) { return max(x, y); });
+}
+
+template <typename O>
+inline void max_span(impl::rgba8<O> const *a, impl::rgba8<O> const &v,
+                     impl::rgba8<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, &v, true, out, n,
+                [] (__m128i x, __m128i y) { return _mm_max_epu8(x, y); },
+                [] (auto x, auto y) { return max(x, y); });
+}
+
+// -- Color64, Color64Bgra -----------------------------------------------------
+template <typename O>
+inline void add_span(impl::rgba16<O> const *a, impl::rgba16<O> const *b,
+                     impl::rgba16<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return _mm_adds_epu16(x, y); },
+                [] (auto x, auto y) { return x + y; });
+}
+
+template <typename O>
+inline void sub_span(impl::rgba16<O> const *a, impl::rgba16<O> const *b,
+                     impl::rgba16<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return _mm_subs_epu16(x, y); },
+                [] (auto x, auto y) { return x - y; });
+}
+
+template <typename O>
+inline void mul_span(impl::rgba16<O> const *a, impl::rgba16<O> const *b,
+                     impl::rgba16<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return impl::mul_u16(x, y); },
+                [] (auto x, auto y) { return x * y; });
+}
+
+template <typename O>
+inline void scale_span(impl::rgba16<O> const *a, double f, impl::rgba16<O> *out,
+                       std::size_t n) {
+        const __m128 vf = _mm_set1_ps(static_cast<float>(f));
+        impl::binary_span_sse2(a, a, true, out, n,
+                [vf] (__m128i x, __m128i) {
+                        return impl::map_u16_ps(x, x, [vf] (__m128 v, __m128) {
+                                return _mm_mul_ps(v, vf);
+                        });
+                },
+                [f] (auto x, auto) { return x * f; });
+}
+
+template <typename O>
+inline void div_span(impl::rgba16<O> const *a, double f, impl::rgba16<O> *out,
+                     std::size_t n) {
+        scale_span(a, 1.0 / f, out, n);
+}
+
+template <typename O>
+inline void lerp_span(impl::rgba16<O> const *a, impl::rgba16<O> const *b,
+                      double t, impl::rgba16<O> *out, std::size_t n) {
+        const __m128 vt = _mm_set1_ps(static_cast<float>(t));
+        impl::binary_span_sse2(a, b, false, out, n,
+                [vt] (__m128i x, __m128i y) {
+                        return impl::map_u16_ps(x, y,
+                                                [vt] (__m128 u, __m128 v) {
+                                return _mm_add_ps(
+                                        u, _mm_mul_ps(_mm_sub_ps(v, u), vt));
+                        });
+                },
+                [t] (auto x, auto y) { return lerp(x, y, t); });
+}
+
+template <typename O>
+inline void min_span(impl::rgba16<O> const *a, impl::rgba16<O> const *b,
+                     impl::rgba16<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return impl::min_epu16(x, y); },
+                [] (auto x, auto y) { return min(x, y); });
+}
+
+template <typename O>
+inline void min_span(impl::rgba16<O> const *a, impl::rgba16<O> const &v,
+                     impl::rgba16<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, &v, true, out, n,
+                [] (__m128i x, __m128i y) { return impl::min_epu16(x, y); },
+                [] (auto x, auto y) { return min(x, y); });
+}
+
+template <typename O>
+inline void max_span(impl::rgba16<O> const *a, impl::rgba16<O> const *b,
+                     impl::rgba16<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, b, false, out, n,
+                [] (__m128i x, __m128i y) { return impl::max_epu16(x, y); },
+                [] (auto x, auto y) { return max(x, y); });
+}
+
+template <typename O>
+inline void max_span(impl::rgba16<O> const *a, impl::rgba16<O> const &v,
+                     impl::rgba16<O> *out, std::size_t n) {
+        impl::binary_span_sse2(a, &v, true, out, n,
+                [] (__m128i x, __m128i y) { return impl::max_epu16(x, y); },
+                [] (auto x, auto y) { return max(x, y); });
+}
+#endif
+
+}
+
+#endif //COLOR_OPS_HH_INCLUDED_20261018
@@ -0,0 +1,429 @@
+#ifndef COLOR_SPACE_HH_INCLUDED_20261018
+#define COLOR_SPACE_HH_INCLUDED_20261018
+
+#include "color.hh"
+#include "color_ops.hh"
+#include "execution.hh"
+#include "image.hh"
+#include "image_view.hh"
+#include "impl/block_copy.hh"
+#include "impl/compiler.hh"
+#include "impl/srgb.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin {
+
+// -- convert_span -------------------------------------------------------------
+// Converts n pixels between Color32, Color64 (either channel order) and
+// ColorF, and between colour spaces: out[i] is in[i], taken as being in
+// space from, expressed in space to. in and out must not overlap.
+//
+// There is no pow() per pixel. sRGB is decoded with a table over the
+// channel values, and encoded with a search of the table's thresholds (see
+// impl/srgb.hh), which is a single comparison for 8 bit output. Color32
+// sRGB to Color64 linear and back, the pair for processing 8 bit images in
+// linear light, is one table load per channel either way. Other pairs go
+// through ColorF, 256 pixels at a time; integer channels are converted to
+// and from float with SSE2. ColorF is decoded from sRGB and encoded to it
+// with 16 bit precision.
+//
+// Alpha is only rescaled. Results are rounded to nearest; Color32 to
+// Color64 and back, in either direction of space, gives back the input.
+template <typename In, typename Out>
+inline void convert_span(In const *in, ColorSpace from,
+                         Out *out, ColorSpace to, std::size_t n);
+
+// -- convert ------------------------------------------------------------------
+// An image of the pixels of src converted with convert_span(); with an
+// execution policy, in bands of rows.
+template <typename Out, typename In>
+inline base_image<Out> convert(image_view<In> const &src,
+                               ColorSpace from, ColorSpace to);
+template <typename Out, typename In>
+inline base_image<Out> convert(base_image<In> const &src,
+                               ColorSpace from, ColorSpace to);
+
+template <typename Out, typename ExecutionPolicy, typename In>
+inline auto convert(ExecutionPolicy const &, image_view<In> const &src,
+                    ColorSpace from, ColorSpace to)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<Out>>;
+template <typename Out, typename ExecutionPolicy, typename In>
+inline auto convert(ExecutionPolicy const &, base_image<In> const &src,
+                    ColorSpace from, ColorSpace to)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<Out>>;
+
+// -- linear light -------------------------------------------------------------
+// linear_type<T> holds T in linear light without visible loss: Color64 of
+// the same channel order for Color32, ColorF for anything else.
+//
+// to_linear() decodes an sRGB image to linear_type, to_srgb<T>() encodes a
+// linear one to T. in_linear_light(img, f) is to_srgb<T>(f(to_linear(img))),
+// which runs image algorithms in linear light:
+//
+//   Image32 half = in_linear_light(img, [] (Image64 const &lin) {
+//           return resize(lin, lin.width() / 2, lin.height() / 2);
+//   });
+//
+// For Color32, f sees Color64 and so gets the SSE2 kernels of resize(),
+// mip_chain, composite() and the span operations of color_ops.hh.
+template <typename T>
+struct linear_pixel {
+        using type = ColorF;
+};
+
+template <typename O>
+struct linear_pixel<impl::rgba8<O>> {
+        using type = impl::rgba16<O>;
+};
+
+template <typename T>
+using linear_type = typename linear_pixel<T>::type;
+
+template <typename T>
+inline base_image<linear_type<T>> to_linear(base_image<T> const &img);
+template <typename T, typename L>
+inline base_image<T> to_srgb(base_image<L> const &img);
+template <typename T, typename F>
+inline base_image<T> in_linear_light(base_image<T> const &img, F &&f);
+
+template <typename ExecutionPolicy, typename T>
+inline auto to_linear(ExecutionPolicy const &, base_image<T> const &img)
+        -> execution::enable_if_execution_policy<
+                ExecutionPolicy, base_image<linear_type<T>>>;
+template <typename T, typename ExecutionPolicy, typename L>
+inline auto to_srgb(ExecutionPolicy const &, base_image<L> const &img)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+template <typename ExecutionPolicy, typename T, typename F>
+inline auto in_linear_light(ExecutionPolicy const &,
+                            base_image<T> const &img, F &&f)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+// -- ColorF in [0, 1] from pixels and back ------------------------------------
+// load_unit() and store_unit() only rescale, load_srgb() also decodes and
+// store_srgb() also encodes. The SSE2 versions, taking an int where the
+// generic ones take "...", compute exactly the same.
+template <typename S, typename O>
+inline void load_unit(basic_rgba<S, S, S, S, O> const *in, ColorF *out,
+                      std::size_t n, ...) {
+        const float f = 1.f / channel_arith<S>::max_value;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = ColorF{in[i].r() * f, in[i].g() * f,
+                                in[i].b() * f, in[i].a() * f};
+}
+
+inline void load_unit(ColorF const *in, ColorF *out, std::size_t n, ...) {
+        copy_n(in, n, out);
+}
+
+template <typename S, typename O>
+inline void store_unit(ColorF const *in, basic_rgba<S, S, S, S, O> *out,
+                       std::size_t n, ...) {
+        using arith = channel_arith<S>;
+        const float max = arith::max_value;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = basic_rgba<S, S, S, S, O>{
+                        arith::from_real(in[i].r() * max),
+                        arith::from_real(in[i].g() * max),
+                        arith::from_real(in[i].b() * max),
+                        arith::from_real(in[i].a() * max)};
+}
+
+inline void store_unit(ColorF const *in, ColorF *out, std::size_t n, ...) {
+        copy_n(in, n, out);
+}
+
+template <typename S, typename O>
+inline void load_srgb(basic_rgba<S, S, S, S, O> const *in, ColorF *out,
+                      std::size_t n) {
+        srgb_table<S> const &t = srgb_table<S>::get();
+        const float f = 1.f / channel_arith<S>::max_value;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = ColorF{t.decode(in[i].r()), t.decode(in[i].g()),
+                                t.decode(in[i].b()), in[i].a() * f};
+}
+
+inline void load_srgb(ColorF const *in, ColorF *out, std::size_t n) {
+        srgb_table<uint16_t> const &t = srgb_table<uint16_t>::get();
+        const auto decode = [&t] (float v) {
+                return t.decode(channel_arith<uint16_t>::from_real(
+                        v * 65535.f));
+        };
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = ColorF{decode(in[i].r()), decode(in[i].g()),
+                                decode(in[i].b()), in[i].a()};
+}
+
+template <typename S, typename O>
+inline void store_srgb(ColorF const *in, basic_rgba<S, S, S, S, O> *out,
+                       std::size_t n) {
+        using arith = channel_arith<S>;
+        srgb_table<S> const &t = srgb_table<S>::get();
+        const float max = arith::max_value;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = basic_rgba<S, S, S, S, O>{
+                        t.encode(in[i].r()), t.encode(in[i].g()),
+                        t.encode(in[i].b()),
+                        arith::from_real(in[i].a() * max)};
+}
+
+inline void store_srgb(ColorF const *in, ColorF *out, std::size_t n) {
+        srgb_table<uint16_t> const &t = srgb_table<uint16_t>::get();
+        const auto encode = [&t] (float v) {
+                return t.encode(v) * (1.f / 65535.f);
+        };
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = ColorF{encode(in[i].r()), encode(in[i].g()),
+                                encode(in[i].b()), in[i].a()};
+}
+
+#if PUFFIN_HAS_SSE2
+// One pixel as 4 floats in memory order, to r g b a and back.
+template <typename O>
+inline __m128 rgba_order_ps(__m128 v) {
+        return std::is_same<O, bgra_order>::value
+                ? _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2))
+                : v;
+}
+
+template <typename O>
+inline void load_unit(rgba8<O> const *in, ColorF *out, std::size_t n, int) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 f = _mm_set1_ps(1.f / 255);
+        float *dst = reinterpret_cast<float*>(out);
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+                const __m128i x = load_px(in + i);
+                const __m128i w[2] = {_mm_unpacklo_epi8(x, zero),
+                                      _mm_unpackhi_epi8(x, zero)};
+                for (int k=0; k!=4; ++k) {
+                        const __m128i p = (k & 1)
+                                ? _mm_unpackhi_epi16(w[k/2], zero)
+                                : _mm_unpacklo_epi16(w[k/2], zero);
+                        _mm_storeu_ps(dst + 4*(i+k), rgba_order_ps<O>(
+                                _mm_mul_ps(_mm_cvtepi32_ps(p), f)));
+                }
+        }
+        load_unit(in + i, out + i, n - i, nullptr);
+}
+
+template <typename O>
+inline void load_unit(rgba16<O> const *in, ColorF *out, std::size_t n, int) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 f = _mm_set1_ps(1.f / 65535);
+        float *dst = reinterpret_cast<float*>(out);
+        std::size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+                const __m128i x = load_px(in + i);
+                _mm_storeu_ps(dst + 4*i, rgba_order_ps<O>(_mm_mul_ps(
+                        _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)), f)));
+                _mm_storeu_ps(dst + 4*i + 4, rgba_order_ps<O>(_mm_mul_ps(
+                        _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)), f)));
+        }
+        load_unit(in + i, out + i, n - i, nullptr);
+}
+
+template <typename O>
+inline void store_unit(ColorF const *in, rgba8<O> *out, std::size_t n, int) {
+        const __m128 max = _mm_set1_ps(255.f);
+        float const *src = reinterpret_cast<float const*>(in);
+        const auto px = [&] (std::size_t i) {
+                return round_clamped(_mm_mul_ps(rgba_order_ps<O>(
+                        _mm_loadu_ps(src + 4*i)), max), 255.f);
+        };
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+                store_px(out + i, _mm_packus_epi16(
+                        _mm_packs_epi32(px(i), px(i+1)),
+                        _mm_packs_epi32(px(i+2), px(i+3))));
+        store_unit(in + i, out + i, n - i, nullptr);
+}
+
+template <typename O>
+inline void store_unit(ColorF const *in, rgba16<O> *out, std::size_t n,
+                       int) {
+        const __m128 max = _mm_set1_ps(65535.f);
+        float const *src = reinterpret_cast<float const*>(in);
+        const auto px = [&] (std::size_t i) {
+                return round_clamped(_mm_mul_ps(rgba_order_ps<O>(
+                        _mm_loadu_ps(src + 4*i)), max), 65535.f);
+        };
+        std::size_t i = 0;
+        for (; i + 2 <= n; i += 2)
+                store_px(out + i, packus_epi32_sse2(px(i), px(i+1)));
+        store_unit(in + i, out + i, n - i, nullptr);
+}
+#endif
+
+// -- direct conversions -------------------------------------------------------
+// Pairs that need no float intermediate; false if this is not one.
+template <typename In, typename Out>
+inline bool convert_direct(In const *, ColorSpace, Out *, ColorSpace,
+                           std::size_t) {
+        return false;
+}
+
+template <typename T>
+inline bool convert_direct(T const *in, ColorSpace from,
+                           T *out, ColorSpace to, std::size_t n) {
+        if (from != to)
+                return false;
+        copy_n(in, n, out);
+        return true;
+}
+
+template <typename O1, typename O2>
+inline bool convert_direct(rgba8<O1> const *in, ColorSpace from,
+                           rgba16<O2> *out, ColorSpace to, std::size_t n) {
+        if (from != ColorSpace::Srgb || to != ColorSpace::Linear)
+                return false;
+        uint16_t const *lut = srgb8_linear16_table::get().to_linear;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = rgba16<O2>{lut[in[i].r()], lut[in[i].g()],
+                                    lut[in[i].b()],
+                                    uint16_t(in[i].a() * 257)};
+        return true;
+}
+
+template <typename O1, typename O2>
+inline bool convert_direct(rgba16<O1> const *in, ColorSpace from,
+                           rgba8<O2> *out, ColorSpace to, std::size_t n) {
+        if (from != ColorSpace::Linear || to != ColorSpace::Srgb)
+                return false;
+        uint8_t const *lut = srgb8_linear16_table::get().to_srgb;
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = rgba8<O2>{lut[in[i].r()], lut[in[i].g()],
+                                   lut[in[i].b()],
+                                   uint8_t((in[i].a() + 128) / 257)};
+        return true;
+}
+
+} }
+
+namespace puffin {
+
+template <typename In, typename Out>
+inline void convert_span(In const *in, ColorSpace from,
+                         Out *out, ColorSpace to, std::size_t n) {
+        if (impl::convert_direct(in, from, out, to, n))
+                return;
+        const bool decode = from == ColorSpace::Srgb &&
+                            to == ColorSpace::Linear;
+        const bool encode = from == ColorSpace::Linear &&
+                            to == ColorSpace::Srgb;
+        constexpr std::size_t block = 256;
+        ColorF buffer[block];
+        for (std::size_t i=0; i<n; i+=block) {
+                const std::size_t m = std::min(block, n - i);
+                if (decode)
+                        impl::load_srgb(in + i, buffer, m);
+                else
+                        impl::load_unit(in + i, buffer, m, 0);
+                if (encode)
+                        impl::store_srgb(buffer, out + i, m);
+                else
+                        impl::store_unit(buffer, out + i, m, 0);
+        }
+}
+
+template <typename Out, typename ExecutionPolicy, typename In>
+inline auto convert(ExecutionPolicy const &policy, image_view<In> const &src,
+                    ColorSpace from, ColorSpace to)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<Out>>
+{
+        base_image<Out> ret{src.width(), src.height()};
+        impl::for_each_band(policy, src.height(),
+                            src.stride() * sizeof(In) +
+                            ret.stride() * sizeof(Out), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y)
+                        convert_span(src.row(y), from, ret.row(y), to,
+                                     std::size_t(src.width()));
+        });
+        return ret;
+}
+
+template <typename Out, typename ExecutionPolicy, typename In>
+inline auto convert(ExecutionPolicy const &policy, base_image<In> const &src,
+                    ColorSpace from, ColorSpace to)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<Out>>
+{
+        return convert<Out>(policy, image_view<In>{src}, from, to);
+}
+
+template <typename Out, typename In>
+inline base_image<Out> convert(image_view<In> const &src,
+                               ColorSpace from, ColorSpace to) {
+        return convert<Out>(execution::seq, src, from, to);
+}
+
+template <typename Out, typename In>
+inline base_image<Out> convert(base_image<In> const &src,
+                               ColorSpace from, ColorSpace to) {
+        return convert<Out>(execution::seq, image_view<In>{src}, from, to);
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto to_linear(ExecutionPolicy const &policy, base_image<T> const &img)
+        -> execution::enable_if_execution_policy<
+                ExecutionPolicy, base_image<linear_type<T>>>
+{
+        return convert<linear_type<T>>(policy, img, ColorSpace::Srgb,
+                                       ColorSpace::Linear);
+}
+
+template <typename T, typename ExecutionPolicy, typename L>
+inline auto to_srgb(ExecutionPolicy const &policy, base_image<L> const &img)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return convert<T>(policy, img, ColorSpace::Linear, ColorSpace::Srgb);
+}
+
+template <typename ExecutionPolicy, typename T, typename F>
+inline auto in_linear_light(ExecutionPolicy const &policy,
+                            base_image<T> const &img, F &&f)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return to_srgb<T>(policy, std::forward<F>(f)(to_linear(policy, img)));
+}
+
+template <typename T>
+inline base_image<linear_type<T>> to_linear(base_image<T> const &img) {
+        return to_linear(execution::seq, img);
+}
+
+template <typename T, typename L>
+inline base_image<T> to_srgb(base_image<L> const &img) {
+        return to_srgb<T>(execution::seq, img);
+}
+
+template <typename T, typename F>
+inline base_image<T> in_linear_light(base_image<T> const &img, F &&f) {
+        return in_linear_light(execution::seq, img, std::forward<F>(f));
+}
+
+}
+
+#endif //COLOR_SPACE_HH_INCLUDED_20261018
@@ -0,0 +1,657 @@
+#ifndef COMPOSITE_HH_INCLUDED_20261018
+#define COMPOSITE_HH_INCLUDED_20261018
+
+#include "blit.hh"
+#include "color.hh"
+#include "color_ops.hh"
+#include "coords.hh"
+#include "execution.hh"
+#include "image.hh"
+#include "image_view.hh"
+#include "impl/compiler.hh"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin {
+
+// -- premultiplied ------------------------------------------------------------
+// A pixel of type C whose colour channels have been multiplied by its alpha
+// ("premultiplied" or "associated" alpha): half transparent white is
+// {128, 128, 128, 128}. Same layout as C, so that images of it can be
+// handed to anything that takes raw pixels.
+//
+// Compositing premultiplied pixels needs no division; compositing straight
+// (non-premultiplied) ones needs one per pixel to get back to straight
+// alpha. Convert sprites that are drawn many times once, with premultiply(),
+// and keep frames that are composited into repeatedly premultiplied.
+//
+// C has four unsigned integer channels of one type, e.g. Color32.
+template <typename C>
+struct premultiplied : C {
+        using straight_type = C;
+
+        premultiplied() = default;
+        using C::C;
+
+        // Takes the channels of c as they are, which must already be
+        // premultiplied. See premultiply() for converting a straight colour.
+        explicit premultiplied(C const &c) : C(c) {}
+};
+
+typedef premultiplied<Color64> Color64Premultiplied;
+typedef premultiplied<Color32> Color32Premultiplied;
+typedef premultiplied<Color64Bgra> Color64BgraPremultiplied;
+typedef premultiplied<Color32Bgra> Color32BgraPremultiplied;
+
+typedef base_image<Color64Premultiplied> Image64Premultiplied;
+typedef base_image<Color32Premultiplied> Image32Premultiplied;
+
+static_assert(sizeof(Color32Premultiplied) == sizeof(Color32) &&
+              sizeof(Color64Premultiplied) == sizeof(Color64),
+              "premultiplied pixels must have the layout of straight ones");
+static_assert(std::is_trivially_copyable<Color32Premultiplied>::value &&
+              std::is_trivially_copyable<Color64Premultiplied>::value,
+              "pixels must be trivially copyable");
+
+// -- BlendMode ----------------------------------------------------------------
+// How composite() combines a source pixel s with a destination pixel d,
+// both premultiplied, channel-wise and for alpha alike (max is 255 for
+// Color32, 65535 for Color64, sa the alpha of s):
+//
+// - SourceOver: s + d*(max-sa)/max, Porter-Duff "over".
+// - Multiply:   s*d/max + s*(max-da)/max + d*(max-sa)/max; darkens.
+// - Screen:     s + d - s*d/max; lightens.
+// - Add:        s + d, saturating ("linear dodge").
+//
+// Every product is rounded to nearest and every sum saturates, in that
+// order, so the SIMD kernels and the single pixel functions agree exactly.
+enum class BlendMode {
+        SourceOver,
+        Multiply,
+        Screen,
+        Add
+};
+
+// -- premultiply, unpremultiply -----------------------------------------------
+// premultiply() rounds c*a/max to nearest. unpremultiply() rounds c*max/a
+// to nearest (even), clamped to max; pixels with an alpha of zero become
+// {0, 0, 0, 0}. Premultiplying loses precision at low alpha, so the round
+// trip is only exact for opaque pixels.
+//
+// The *_span functions convert n pixels; in and out must not overlap. The
+// image functions convert in bands of rows with an execution policy.
+template <typename C>
+inline premultiplied<C> premultiply(C const &c);
+template <typename C>
+inline C unpremultiply(premultiplied<C> const &c);
+
+template <typename C>
+inline void premultiply_span(C const *in, premultiplied<C> *out,
+                             std::size_t n);
+template <typename C>
+inline void unpremultiply_span(premultiplied<C> const *in, C *out,
+                               std::size_t n);
+
+template <typename C>
+inline base_image<premultiplied<C>> premultiply(base_image<C> const &img);
+template <typename C>
+inline base_image<C> unpremultiply(base_image<premultiplied<C>> const &img);
+
+template <typename ExecutionPolicy, typename C>
+inline auto premultiply(ExecutionPolicy const &, base_image<C> const &img)
+        -> execution::enable_if_execution_policy<
+                ExecutionPolicy, base_image<premultiplied<C>>>;
+template <typename ExecutionPolicy, typename C>
+inline auto unpremultiply(ExecutionPolicy const &,
+                          base_image<premultiplied<C>> const &img)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<C>>;
+
+// -- blend, composite_span ----------------------------------------------------
+// blend() composites one premultiplied pixel onto another.
+//
+// composite_span() composites src[i] onto dst[i] for n pixels:
+// - premultiplied onto premultiplied: no division.
+// - straight onto premultiplied: src is premultiplied on the fly, still no
+//   division.
+// - straight onto straight: both are premultiplied, and the result is
+//   converted back, with one division per pixel.
+//
+// Color32 and Color64, in either channel order, are composited with SSE2,
+// 4 or 2 pixels at a time.
+template <typename C>
+inline premultiplied<C> blend(premultiplied<C> const &src,
+                              premultiplied<C> const &dst,
+                              BlendMode mode = BlendMode::SourceOver);
+
+template <typename C>
+inline void composite_span(premultiplied<C> const *src,
+                           premultiplied<C> *dst, std::size_t n,
+                           BlendMode mode = BlendMode::SourceOver);
+template <typename C>
+inline void composite_span(C const *src, premultiplied<C> *dst,
+                           std::size_t n,
+                           BlendMode mode = BlendMode::SourceOver);
+template <typename C>
+inline void composite_span(C const *src, C *dst, std::size_t n,
+                           BlendMode mode = BlendMode::SourceOver);
+
+// -- composite ----------------------------------------------------------------
+// As blit(), but blends the pixels of src_rect onto dst with mode instead of
+// replacing them; any of the pixel type pairs of composite_span() works.
+// Clipped against both images; returns the rectangle of dst that was
+// written. src and dst may overlap.
+template <typename S, typename D>
+inline Rect composite(image_view<S> const &src, Rect const &src_rect,
+                      mutable_image_view<D> const &dst,
+                      Coords const &dst_point,
+                      BlendMode mode = BlendMode::SourceOver);
+template <typename S, typename D>
+inline Rect composite(image_view<S> const &src,
+                      mutable_image_view<D> const &dst,
+                      Coords const &dst_point,
+                      BlendMode mode = BlendMode::SourceOver);
+
+template <typename S, typename D>
+inline Rect composite(base_image<S> const &src, Rect const &src_rect,
+                      base_image<D> &dst, Coords const &dst_point,
+                      BlendMode mode = BlendMode::SourceOver);
+template <typename S, typename D>
+inline Rect composite(base_image<S> const &src,
+                      base_image<D> &dst, Coords const &dst_point,
+                      BlendMode mode = BlendMode::SourceOver);
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+template <BlendMode M>
+using blend_mode_constant = std::integral_constant<BlendMode, M>;
+
+// Calls f with mode as a compile time constant, so that the span loops are
+// specialized for one mode each.
+template <typename F>
+inline void with_blend_mode(BlendMode mode, F &&f) {
+        switch (mode) {
+        case BlendMode::SourceOver:
+                f(blend_mode_constant<BlendMode::SourceOver>{});
+                break;
+        case BlendMode::Multiply:
+                f(blend_mode_constant<BlendMode::Multiply>{});
+                break;
+        case BlendMode::Screen:
+                f(blend_mode_constant<BlendMode::Screen>{});
+                break;
+        case BlendMode::Add:
+                f(blend_mode_constant<BlendMode::Add>{});
+                break;
+        }
+}
+
+// -- single pixels ------------------------------------------------------------
+// On the channels of premultiplied pixels, with the saturating and rounding
+// operators of color_ops.hh.
+template <typename C>
+inline C inverse_alpha(C const &p) {
+        using S = typename C::alpha_type;
+        const S v = S(channel_arith<S>::max_value - p.a());
+        return C{v, v};
+}
+
+template <typename C>
+inline C blend_px(C const &s, C const &d,
+                  blend_mode_constant<BlendMode::SourceOver>) {
+        return s + d * inverse_alpha(s);
+}
+
+template <typename C>
+inline C blend_px(C const &s, C const &d,
+                  blend_mode_constant<BlendMode::Multiply>) {
+        return s * (inverse_alpha(d) + d) + d * inverse_alpha(s);
+}
+
+template <typename C>
+inline C blend_px(C const &s, C const &d,
+                  blend_mode_constant<BlendMode::Screen>) {
+        return s + (d - s * d);
+}
+
+template <typename C>
+inline C blend_px(C const &s, C const &d,
+                  blend_mode_constant<BlendMode::Add>) {
+        return s + d;
+}
+
+template <typename C>
+inline C premultiply_px(C const &c) {
+        static_assert(C::rgba_have_common_type,
+                      "premultiplied alpha needs one channel type");
+        using arith = channel_arith<typename C::alpha_type>;
+        return C{arith::mul(c.r(), c.a()), arith::mul(c.g(), c.a()),
+                 arith::mul(c.b(), c.a()), c.a()};
+}
+
+// The same float computation as the SSE2 version.
+template <typename C>
+inline C unpremultiply_px(C const &c) {
+        using S = typename C::alpha_type;
+        using arith = channel_arith<S>;
+        using real = typename arith::real;
+        if (c.a() == 0)
+                return C{S(0), S(0), S(0), S(0)};
+        const real f = real(arith::max_value) / real(c.a());
+        return C{arith::from_real(real(c.r()) * f),
+                 arith::from_real(real(c.g()) * f),
+                 arith::from_real(real(c.b()) * f),
+                 c.a()};
+}
+
+#if PUFFIN_HAS_SSE2
+// -- SSE2 ---------------------------------------------------------------------
+// Packed premultiplied pixels, 4 of Color32 or 2 of Color64 per vector.
+// Alpha is the last channel in both channel orders.
+template <int Bits>
+struct premultiplied_sse2;
+
+template <>
+struct premultiplied_sse2<8> {
+        static __m128i alpha_mask() {
+                return _mm_set1_epi32(int32_t(0xFF000000u));
+        }
+        // The alpha of each pixel in all of its channels.
+        static __m128i alpha(__m128i x) {
+                const __m128i a = _mm_srli_epi32(x, 24);
+                const __m128i aa = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+                return _mm_or_si128(aa, _mm_slli_epi32(aa, 16));
+        }
+        static __m128i mul(__m128i a, __m128i b) { return mul_u8(a, b); }
+        static __m128i adds(__m128i a, __m128i b) {
+                return _mm_adds_epu8(a, b);
+        }
+        static __m128i subs(__m128i a, __m128i b) {
+                return _mm_subs_epu8(a, b);
+        }
+        template <typename F>
+        static __m128i map_ps(__m128i a, __m128i b, F f) {
+                return map_u8_ps(a, b, f);
+        }
+        static constexpr float max_value = 255.f;
+};
+
+template <>
+struct premultiplied_sse2<16> {
+        static __m128i alpha_mask() {
+                return _mm_set_epi32(int32_t(0xFFFF0000u), 0,
+                                     int32_t(0xFFFF0000u), 0);
+        }
+        static __m128i alpha(__m128i x) {
+                return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xFF), 0xFF);
+        }
+        static __m128i mul(__m128i a, __m128i b) { return mul_u16(a, b); }
+        static __m128i adds(__m128i a, __m128i b) {
+                return _mm_adds_epu16(a, b);
+        }
+        static __m128i subs(__m128i a, __m128i b) {
+                return _mm_subs_epu16(a, b);
+        }
+        template <typename F>
+        static __m128i map_ps(__m128i a, __m128i b, F f) {
+                return map_u16_ps(a, b, f);
+        }
+        static constexpr float max_value = 65535.f;
+};
+
+template <typename Ops>
+inline __m128i inverse_alpha_sse2(__m128i x) {
+        return _mm_xor_si128(Ops::alpha(x), _mm_set1_epi32(-1));
+}
+
+// The colour channels of c, alpha from a.
+template <typename Ops>
+inline __m128i with_alpha_sse2(__m128i c, __m128i a) {
+        const __m128i m = Ops::alpha_mask();
+        return _mm_or_si128(_mm_andnot_si128(m, c), _mm_and_si128(m, a));
+}
+
+template <typename Ops>
+inline __m128i premultiply_sse2(__m128i x) {
+        return with_alpha_sse2<Ops>(Ops::mul(x, Ops::alpha(x)), x);
+}
+
+// For alpha 0 the factor is infinite and 0*inf is NaN, which
+// round_clamped() turns into 0, as in unpremultiply_px().
+template <typename Ops>
+inline __m128i unpremultiply_sse2(__m128i x) {
+        const __m128 max = _mm_set1_ps(Ops::max_value);
+        const __m128i c = Ops::map_ps(x, Ops::alpha(x),
+                                      [max] (__m128 v, __m128 a) {
+                return _mm_mul_ps(v, _mm_div_ps(max, a));
+        });
+        return with_alpha_sse2<Ops>(c, x);
+}
+
+template <typename Ops>
+inline __m128i blend_sse2(__m128i s, __m128i d,
+                          blend_mode_constant<BlendMode::SourceOver>) {
+        return Ops::adds(s, Ops::mul(d, inverse_alpha_sse2<Ops>(s)));
+}
+
+template <typename Ops>
+inline __m128i blend_sse2(__m128i s, __m128i d,
+                          blend_mode_constant<BlendMode::Multiply>) {
+        return Ops::adds(
+                Ops::mul(s, Ops::adds(inverse_alpha_sse2<Ops>(d), d)),
+                Ops::mul(d, inverse_alpha_sse2<Ops>(s)));
+}
+
+template <typename Ops>
+inline __m128i blend_sse2(__m128i s, __m128i d,
+                          blend_mode_constant<BlendMode::Screen>) {
+        return Ops::adds(s, Ops::subs(d, Ops::mul(s, d)));
+}
+
+template <typename Ops>
+inline __m128i blend_sse2(__m128i s, __m128i d,
+                          blend_mode_constant<BlendMode::Add>) {
+        return Ops::adds(s, d);
+}
+
+// out[i] = vop(in[i]) for 16 bytes at a time, sop for the rest.
+template <typename P, typename Q, typename VecOp, typename ScalarOp>
+inline void convert_span_sse2(P const *in, Q *out, std::size_t n,
+                              VecOp vop, ScalarOp sop) {
+        constexpr std::size_t per = 16 / sizeof(P);
+        std::size_t i = 0;
+        for (; i + per <= n; i += per)
+                store_px(out + i, vop(load_px(in + i)));
+        for (; i != n; ++i)
+                out[i] = sop(in[i]);
+}
+
+// dst[i] = vop(src[i], dst[i]) for 16 bytes at a time, sop for the rest.
+template <typename P, typename Q, typename VecOp, typename ScalarOp>
+inline void composite_span_sse2(P const *src, Q *dst, std::size_t n,
+                                VecOp vop, ScalarOp sop) {
+        constexpr std::size_t per = 16 / sizeof(P);
+        std::size_t i = 0;
+        for (; i + per <= n; i += per)
+                store_px(dst + i, vop(load_px(src + i), load_px(dst + i)));
+        for (; i != n; ++i)
+                dst[i] = sop(src[i], dst[i]);
+}
+
+template <typename C>
+using premultiplied_ops = premultiplied_sse2<
+        8 * sizeof(typename C::alpha_type)>;
+
+template <typename C>
+using if_simd_pixel = typename std::enable_if<
+        std::is_same<C, rgba8<typename C::order_type>>::value ||
+        std::is_same<C, rgba16<typename C::order_type>>::value>::type;
+#endif
+
+// -- spans --------------------------------------------------------------------
+// Called with a trailing 0: the SSE2 versions for Color32 and Color64 take
+// an int there and win over the generic ones, which take "...".
+template <typename C>
+inline void premultiply_row(C const *in, premultiplied<C> *out,
+                             std::size_t n, ...) {
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = premultiplied<C>{premultiply_px(in[i])};
+}
+
+template <typename C>
+inline void unpremultiply_row(premultiplied<C> const *in, C *out,
+                               std::size_t n, ...) {
+        for (std::size_t i=0; i!=n; ++i)
+                out[i] = unpremultiply_px(C{in[i]});
+}
+
+// The three pairs of pixel types of composite_span(); straight pixels are
+// premultiplied on load, and if dst is straight, the result is converted
+// back on store.
+template <typename C, typename M>
+inline void composite_row(premultiplied<C> const *src,
+                           premultiplied<C> *dst, std::size_t n, M mode,
+                           ...) {
+        for (std::size_t i=0; i!=n; ++i)
+                dst[i] = premultiplied<C>{blend_px(C{src[i]}, C{dst[i]},
+                                                   mode)};
+}
+
+template <typename C, typename M>
+inline void composite_row(C const *src, premultiplied<C> *dst,
+                           std::size_t n, M mode, ...) {
+        for (std::size_t i=0; i!=n; ++i)
+                dst[i] = premultiplied<C>{blend_px(premultiply_px(src[i]),
+                                                   C{dst[i]}, mode)};
+}
+
+template <typename C, typename M>
+inline void composite_row(C const *src, C *dst, std::size_t n, M mode,
+                           ...) {
+        for (std::size_t i=0; i!=n; ++i)
+                dst[i] = unpremultiply_px(blend_px(premultiply_px(src[i]),
+                                                   premultiply_px(dst[i]),
+                                                   mode));
+}
+
+#if PUFFIN_HAS_SSE2
+template <typename C, typename = if_simd_pixel<C>>
+inline void premultiply_row(C const *in, premultiplied<C> *out,
+                             std::size_t n, int) {
+        using Ops = premultiplied_ops<C>;
+        convert_span_sse2(in, out, n,
+                [] (__m128i x) { return premultiply_sse2<Ops>(x); },
+                [] (C const &c) { return premultiplied<C>{premultiply_px(c)}; });
+}
+
+template <typename C, typename = if_simd_pixel<C>>
+inline void unpremultiply_row(premultiplied<C> const *in, C *out,
+                               std::size_t n, int) {
+        using Ops = premultiplied_ops<C>;
+        convert_span_sse2(in, out, n,
+                [] (__m128i x) { return unpremultiply_sse2<Ops>(x); },
+                [] (premultiplied<C> const &c) {
+                        return unpremultiply_px(C{c});
+                });
+}
+
+template <typename C, typename M, typename = if_simd_pixel<C>>
+inline void composite_row(premultiplied<C> const *src,
+                           premultiplied<C> *dst, std::size_t n, M mode,
+                           int) {
+        using Ops = premultiplied_ops<C>;
+        composite_span_sse2(src, dst, n,
+                [mode] (__m128i s, __m128i d) {
+                        return blend_sse2<Ops>(s, d, mode);
+                },
+                [mode] (premultiplied<C> const &s, premultiplied<C> const &d) {
+                        return premultiplied<C>{blend_px(C{s}, C{d}, mode)};
+                });
+}
+
+template <typename C, typename M, typename = if_simd_pixel<C>>
+inline void composite_row(C const *src, premultiplied<C> *dst,
+                           std::size_t n, M mode, int) {
+        using Ops = premultiplied_ops<C>;
+        composite_span_sse2(src, dst, n,
+                [mode] (__m128i s, __m128i d) {
+                        return blend_sse2<Ops>(premultiply_sse2<Ops>(s), d,
+                                               mode);
+                },
+                [mode] (C const &s, premultiplied<C> const &d) {
+                        return premultiplied<C>{
+                                blend_px(premultiply_px(s), C{d}, mode)};
+                });
+}
+
+template <typename C, typename M, typename = if_simd_pixel<C>>
+inline void composite_row(C const *src, C *dst, std::size_t n, M mode,
+                           int) {
+        using Ops = premultiplied_ops<C>;
+        composite_span_sse2(src, dst, n,
+                [mode] (__m128i s, __m128i d) {
+                        return unpremultiply_sse2<Ops>(blend_sse2<Ops>(
+                                premultiply_sse2<Ops>(s),
+                                premultiply_sse2<Ops>(d), mode));
+                },
+                [mode] (C const &s, C const &d) {
+                        return unpremultiply_px(blend_px(
+                                premultiply_px(s), premultiply_px(d), mode));
+                });
+}
+#endif
+
+} }
+
+namespace puffin {
+
+template <typename C>
+inline premultiplied<C> premultiply(C const &c) {
+        return premultiplied<C>{impl::premultiply_px(c)};
+}
+
+template <typename C>
+inline C unpremultiply(premultiplied<C> const &c) {
+        return impl::unpremultiply_px(C{c});
+}
+
+template <typename C>
+inline void premultiply_span(C const *in, premultiplied<C> *out,
+                             std::size_t n) {
+        impl::premultiply_row(in, out, n, 0);
+}
+
+template <typename C>
+inline void unpremultiply_span(premultiplied<C> const *in, C *out,
+                               std::size_t n) {
+        impl::unpremultiply_row(in, out, n, 0);
+}
+
+template <typename ExecutionPolicy, typename C>
+inline auto premultiply(ExecutionPolicy const &policy,
+                        base_image<C> const &img)
+        -> execution::enable_if_execution_policy<
+                ExecutionPolicy, base_image<premultiplied<C>>>
+{
+        base_image<premultiplied<C>> ret{img.width(), img.height(),
+                                         img.layout()};
+        impl::for_each_band(policy, img.height(),
+                            (img.stride() + ret.stride()) * sizeof(C), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y)
+                        premultiply_span(img.row(y), ret.row(y),
+                                         std::size_t(img.width()));
+        });
+        return ret;
+}
+
+template <typename ExecutionPolicy, typename C>
+inline auto unpremultiply(ExecutionPolicy const &policy,
+                          base_image<premultiplied<C>> const &img)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<C>>
+{
+        base_image<C> ret{img.width(), img.height(), img.layout()};
+        impl::for_each_band(policy, img.height(),
+                            (img.stride() + ret.stride()) * sizeof(C), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y)
+                        unpremultiply_span(img.row(y), ret.row(y),
+                                           std::size_t(img.width()));
+        });
+        return ret;
+}
+
+template <typename C>
+inline base_image<premultiplied<C>> premultiply(base_image<C> const &img) {
+        return premultiply(execution::seq, img);
+}
+
+template <typename C>
+inline base_image<C> unpremultiply(base_image<premultiplied<C>> const &img) {
+        return unpremultiply(execution::seq, img);
+}
+
+template <typename C>
+inline premultiplied<C> blend(premultiplied<C> const &src,
+                              premultiplied<C> const &dst,
+                              BlendMode mode) {
+        premultiplied<C> ret;
+        impl::with_blend_mode(mode, [&] (auto m) {
+                ret = premultiplied<C>{impl::blend_px(C{src}, C{dst}, m)};
+        });
+        return ret;
+}
+
+template <typename C>
+inline void composite_span(premultiplied<C> const *src,
+                           premultiplied<C> *dst, std::size_t n,
+                           BlendMode mode) {
+        impl::with_blend_mode(mode, [&] (auto m) {
+                impl::composite_row(src, dst, n, m, 0);
+        });
+}
+
+template <typename C>
+inline void composite_span(C const *src, premultiplied<C> *dst,
+                           std::size_t n, BlendMode mode) {
+        impl::with_blend_mode(mode, [&] (auto m) {
+                impl::composite_row(src, dst, n, m, 0);
+        });
+}
+
+template <typename C>
+inline void composite_span(C const *src, C *dst, std::size_t n,
+                           BlendMode mode) {
+        impl::with_blend_mode(mode, [&] (auto m) {
+                impl::composite_row(src, dst, n, m, 0);
+        });
+}
+
+template <typename S, typename D>
+inline Rect composite(image_view<S> const &src, Rect const &src_rect,
+                      mutable_image_view<D> const &dst,
+                      Coords const &dst_point, BlendMode mode) {
+        return impl::blit_rows_disjoint(src, src_rect, dst, dst_point,
+                                        [mode] (S const *s, D *d, int n) {
+                composite_span(s, d, std::size_t(n), mode);
+        });
+}
+
+template <typename S, typename D>
+inline Rect composite(image_view<S> const &src,
+                      mutable_image_view<D> const &dst,
+                      Coords const &dst_point, BlendMode mode) {
+        return composite(src, Rect{{0, 0}, {src.width(), src.height()}},
+                         dst, dst_point, mode);
+}
+
+template <typename S, typename D>
+inline Rect composite(base_image<S> const &src, Rect const &src_rect,
+                      base_image<D> &dst, Coords const &dst_point,
+                      BlendMode mode) {
+        return composite(image_view<S>{src}, src_rect,
+                         mutable_image_view<D>{dst}, dst_point, mode);
+}
+
+template <typename S, typename D>
+inline Rect composite(base_image<S> const &src,
+                      base_image<D> &dst, Coords const &dst_point,
+                      BlendMode mode) {
+        return composite(image_view<S>{src}, mutable_image_view<D>{dst},
+                         dst_point, mode);
+}
+
+}
+
+#endif //COMPOSITE_HH_INCLUDED_20261018
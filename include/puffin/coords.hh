@@ -64,13 +64,13 @@ constexpr int wrap_x(ScreenT const &screen, int x) noexcept {
 }
 template <typename ScreenT>
 constexpr int wrap_y(ScreenT const &screen, int y) noexcept {
-        using puffin::impl;
+        using puffin::impl::wrap;
         return wrap(y, height(screen)-1);
 }
 template <typename ScreenT>
 constexpr Coords wrap(ScreenT const &screen, Coords const &coords) noexcept {
-        return {wrap_x(coords.x, screen),
-                wrap_y(coords.y, screen)};
+        return {wrap_x(screen, coords.x),
+                wrap_y(screen, coords.y)};
 }
 // clamp
 template <typename ScreenT>
@@ -101,8 +101,8 @@ constexpr int mirror_y(ScreenT const &screen, int y) noexcept {
 }
 template <typename ScreenT>
 constexpr Coords mirror(ScreenT const &screen, Coords const &coords) noexcept {
-        return {mirror_x(coords.x, screen),
-                mirror_y(coords.y, screen)};
+        return {mirror_x(screen, coords.x),
+                mirror_y(screen, coords.y)};
 }
 enum class Wrapping {
         Wrap,
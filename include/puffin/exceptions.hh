@@ -3,6 +3,7 @@
 
 #include <stdexcept>
 #include <sstream>
+#include <cstdint>
 
 namespace puffin { namespace exceptions {
 
@@ -87,6 +88,64 @@ private:
 };
 
 
+// -- decode_budget_exceeded ---------------------------------------------------
+class decode_budget_exceeded : public load_image {
+public:
+        decode_budget_exceeded(
+                std::string const &resource,
+                uint64_t required,
+                uint64_t limit
+        ) :
+                load_image(fmt_msg(resource, required, limit)),
+                resource(resource),
+                required(required),
+                limit(limit)
+        { }
+
+        std::string resource;
+        uint64_t required;
+        uint64_t limit;
+private:
+        decode_budget_exceeded(); // delete
+
+        static
+        std::string fmt_msg(
+                std::string const &resource,
+                uint64_t required,
+                uint64_t limit
+        ) {
+                std::stringstream ss;
+                ss << "decode budget exceeded: " << resource
+                   << " required " << required
+                   << ", limit " << limit;
+                return ss.str();
+        }
+};
+
+
+// -- truncated_image_data -----------------------------------------------------
+class truncated_image_data : public load_image {
+public:
+        truncated_image_data(uint64_t required, uint64_t available) :
+                load_image(fmt_msg(required, available)),
+                required(required),
+                available(available)
+        { }
+
+        uint64_t required;
+        uint64_t available;
+private:
+        truncated_image_data(); // delete
+
+        static
+        std::string fmt_msg(uint64_t required, uint64_t available) {
+                std::stringstream ss;
+                ss << "image data truncated: headers declare "
+                   << required << " bytes, but the file has only "
+                   << available;
+                return ss.str();
+        }
+};
 
 
 } }
@@ -0,0 +1,114 @@
+#ifndef EXECUTION_HH_INCLUDED_20261018
+#define EXECUTION_HH_INCLUDED_20261018
+
+#include "impl/thread_pool.hh"
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+namespace puffin { namespace execution {
+
+// Execution policies for the image algorithms, modelled after <execution>.
+//
+// par and par_unseq split an image into bands of whole rows (or tile rows
+// for transposes) and run them on impl::thread_pool::shared(). Every
+// pixel is computed by the same code as with seq, so results do not depend
+// on the policy or the number of threads. The number of threads of one
+// call can be capped, e.g. par(2), to leave room for other work.
+//
+// par_unseq additionally allows the calls of one band to be vectorised;
+// puffin currently treats it like par.
+
+struct sequenced_policy {};
+
+struct parallel_policy {
+        unsigned max_threads = 0; // 0: no cap
+
+        constexpr parallel_policy operator() (unsigned n) const noexcept {
+                return parallel_policy{n};
+        }
+};
+
+struct parallel_unsequenced_policy {
+        unsigned max_threads = 0; // 0: no cap
+
+        constexpr
+        parallel_unsequenced_policy operator() (unsigned n) const noexcept {
+                return parallel_unsequenced_policy{n};
+        }
+};
+
+constexpr sequenced_policy            seq {};
+constexpr parallel_policy             par {};
+constexpr parallel_unsequenced_policy par_unseq {};
+
+template <typename T>
+struct is_execution_policy : std::false_type {};
+template <>
+struct is_execution_policy<sequenced_policy> : std::true_type {};
+template <>
+struct is_execution_policy<parallel_policy> : std::true_type {};
+template <>
+struct is_execution_policy<parallel_unsequenced_policy> : std::true_type {};
+
+template <typename ExecutionPolicy, typename T = void>
+using enable_if_execution_policy = typename std::enable_if<
+        is_execution_policy<typename std::decay<ExecutionPolicy>::type>::value,
+        T
+>::type;
+
+} }
+
+namespace puffin { namespace impl {
+
+// Bands aim at this many bytes, so that a band is worth a task and
+// neighbouring bands rarely share cache lines.
+constexpr std::size_t parallel_band_bytes = 256 * 1024;
+
+inline unsigned max_threads(execution::sequenced_policy const &) {
+        return 1;
+}
+
+inline unsigned max_threads(execution::parallel_policy const &p) {
+        return p.max_threads;
+}
+
+inline unsigned max_threads(execution::parallel_unsequenced_policy const &p) {
+        return p.max_threads;
+}
+
+// Calls f(begin, end) for consecutive ranges covering [0, count). Range
+// boundaries are multiples of granularity (except for the last one), and
+// ranges span about parallel_band_bytes given bytes_per_unit.
+template <typename ExecutionPolicy, typename F>
+inline void for_each_band(
+        ExecutionPolicy const &policy,
+        int count,
+        std::size_t bytes_per_unit,
+        int granularity,
+        F &&f
+) {
+        if (count <= 0)
+                return;
+        const unsigned threads = max_threads(policy);
+        if (threads == 1) {
+                f(0, count);
+                return;
+        }
+
+        const std::size_t units = std::max<std::size_t>(
+                1, parallel_band_bytes / std::max<std::size_t>(
+                        1, bytes_per_unit));
+        int band = static_cast<int>(std::min<std::size_t>(units, count));
+        band = (band + granularity - 1) / granularity * granularity;
+        const int bands = (count + band - 1) / band;
+
+        thread_pool::shared().parallel_for(bands, threads, [&] (int i) {
+                const int begin = i * band;
+                f(begin, std::min(count, begin + band));
+        });
+}
+
+} }
+
+#endif //EXECUTION_HH_INCLUDED_20261018
@@ -0,0 +1,418 @@
+#ifndef EXPRESSION_HH_INCLUDED_20261018
+#define EXPRESSION_HH_INCLUDED_20261018
+
+#include "color_ops.hh"
+#include "image.hh"
+#include "execution.hh"
+#include "impl/contract.hh"
+#include <type_traits>
+#include <utility>
+
+namespace puffin {
+
+// -- pixel_expression ---------------------------------------------------------
+// Lazy, fused per-pixel arithmetic on base_image.
+//
+// The operators of image.hh take and return whole images, so
+// min(max(img * 0.5, 0.1), 0.9) makes three passes and two temporaries.
+// Starting a chain with lazy() builds an expression instead:
+//
+//     base_image<float> out = min(max(lazy(img) * 0.5, 0.1), 0.9);
+//     Image32 out32 = min(max(lazy(img32) * 0.5, 0.1), 0.9);
+//     Image64 out64 = min(max(lazy(img64) * 0.5, 0.1), 0.9);
+//
+// Nothing is computed until the expression is converted to an image,
+// eval()'d, or eval_into() an existing one. Evaluation makes a single pass
+// in which each output row is computed from the same row of every input,
+// with all operations of the chain inlined into one loop.
+//
+// Pixels combine with the operators of color_ops.hh (channel-wise and
+// saturating for basic_rgba), so an expression gives exactly the pixels of
+// the same chain of image.hh operators. As there, a scalar scales in * and
+// /, and otherwise stands for the pixel impl::pixel_from_scalar() makes of
+// it once, when the expression is built: a fraction of full scale for
+// basic_rgba. basic_rgba has no division by pixels, so only a scalar can
+// divide a basic_rgba expression. All images of one expression must have
+// the same value_type and size. Since each output pixel depends only on
+// the input pixels at the same position, it is fine to eval_into() one of
+// the inputs.
+template <typename E>
+struct pixel_expression {
+        E const& self() const noexcept {
+                return static_cast<E const&>(*this);
+        }
+
+        // (D only delays the lookup of value_type until E is complete.)
+        template <typename D = E>
+        base_image<typename D::value_type> eval() const {
+                return eval(execution::seq);
+        }
+
+        template <typename ExecutionPolicy, typename D = E>
+        auto eval(ExecutionPolicy const &policy) const
+                -> execution::enable_if_execution_policy<
+                        ExecutionPolicy,
+                        base_image<typename D::value_type>>
+        {
+                base_image<typename D::value_type> ret {width(), height()};
+                eval_into(policy, ret);
+                return ret;
+        }
+
+        template <typename T>
+        void eval_into(base_image<T> &dst) const {
+                eval_into(execution::seq, dst);
+        }
+
+        template <typename ExecutionPolicy, typename T>
+        auto eval_into(ExecutionPolicy const &policy,
+                       base_image<T> &dst) const
+                -> execution::enable_if_execution_policy<ExecutionPolicy>;
+
+        template <typename T>
+        operator base_image<T> () const {
+                static_assert(std::is_same<T, typename E::value_type>::value,
+                              "expression and image value_type differ");
+                return eval();
+        }
+
+        int width() const { return self().width(); }
+        int height() const { return self().height(); }
+};
+
+// Starts an expression that reads canvas, which must outlive it.
+template <typename T>
+inline auto lazy(base_image<T> const &canvas);
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+// -- operations ---------------------------------------------------------------
+struct expr_plus {
+        template <typename T>
+        T operator() (T a, T b) const { return static_cast<T>(a + b); }
+};
+
+struct expr_minus {
+        template <typename T>
+        T operator() (T a, T b) const { return static_cast<T>(a - b); }
+};
+
+struct expr_multiplies {
+        template <typename T>
+        T operator() (T a, T b) const { return static_cast<T>(a * b); }
+};
+
+struct expr_divides {
+        template <typename T>
+        T operator() (T a, T b) const { return static_cast<T>(a / b); }
+};
+
+// Written as conditionals rather than std::min/max, which return
+// references, so that compilers turn them into packed min/max. basic_rgba
+// has no order, and takes the channel-wise min/max of color_ops.hh.
+struct expr_min {
+        template <typename T>
+        auto operator() (T a, T b) const
+                -> typename std::enable_if<std::is_arithmetic<T>::value,
+                                           T>::type
+        {
+                return b < a ? b : a;
+        }
+
+        template <typename R, typename G, typename B, typename A,
+                  typename O>
+        basic_rgba<R, G, B, A, O> operator() (
+                basic_rgba<R, G, B, A, O> const &a,
+                basic_rgba<R, G, B, A, O> const &b) const
+        {
+                return puffin::min(a, b);
+        }
+};
+
+struct expr_max {
+        template <typename T>
+        auto operator() (T a, T b) const
+                -> typename std::enable_if<std::is_arithmetic<T>::value,
+                                           T>::type
+        {
+                return a < b ? b : a;
+        }
+
+        template <typename R, typename G, typename B, typename A,
+                  typename O>
+        basic_rgba<R, G, B, A, O> operator() (
+                basic_rgba<R, G, B, A, O> const &a,
+                basic_rgba<R, G, B, A, O> const &b) const
+        {
+                return puffin::max(a, b);
+        }
+};
+
+// Scaling by a double, as scale_span() and div_span() do.
+struct expr_scale {
+        double f;
+
+        template <typename T>
+        T operator() (T const &a) const { return static_cast<T>(a * f); }
+};
+
+struct expr_scale_down {
+        double f;
+
+        template <typename T>
+        T operator() (T const &a) const { return static_cast<T>(a / f); }
+};
+
+// Whether Op combines two pixels of type T. basic_rgba has no division, so
+// it can only be divided by a scalar.
+template <typename Op, typename T>
+struct combines_pixels : std::true_type {};
+
+template <typename T>
+struct combines_pixels<expr_divides, T> : std::is_arithmetic<T> {};
+
+template <typename Op, typename E>
+using enable_if_combines_pixels = typename std::enable_if<
+        combines_pixels<Op, typename E::value_type>::value>::type;
+
+// -- leaves -------------------------------------------------------------------
+template <typename T>
+class image_leaf : public pixel_expression<image_leaf<T>> {
+public:
+        using value_type = T;
+
+        struct cursor {
+                T const *p;
+                T operator[] (int x) const { return p[x]; }
+        };
+
+        explicit image_leaf(base_image<T> const &canvas) noexcept :
+                canvas_(&canvas)
+        {}
+
+        cursor row(int y) const { return cursor{canvas_->row(y)}; }
+        int width() const { return canvas_->width(); }
+        int height() const { return canvas_->height(); }
+
+private:
+        base_image<T> const *canvas_;
+};
+
+// Scalars have no size; -1 stands for "matches anything".
+template <typename T>
+class scalar_leaf : public pixel_expression<scalar_leaf<T>> {
+public:
+        using value_type = T;
+
+        struct cursor {
+                T v;
+                T operator[] (int) const { return v; }
+        };
+
+        explicit scalar_leaf(T v) noexcept : v_(v) {}
+
+        cursor row(int) const { return cursor{v_}; }
+        int width() const { return -1; }
+        int height() const { return -1; }
+
+private:
+        T v_;
+};
+
+inline int common_extent(int a, int b) {
+        if (a < 0)
+                return b;
+        if (b < 0)
+                return a;
+        return equal_to(a, b);
+}
+
+// -- nodes --------------------------------------------------------------------
+template <typename Op, typename L, typename R>
+class binary_node : public pixel_expression<binary_node<Op, L, R>> {
+public:
+        static_assert(std::is_same<typename L::value_type,
+                                   typename R::value_type>::value,
+                      "operands of an expression must have one value_type");
+        using value_type = typename L::value_type;
+
+        struct cursor {
+                typename L::cursor l;
+                typename R::cursor r;
+                value_type operator[] (int x) const { return Op()(l[x], r[x]); }
+        };
+
+        binary_node(L const &l, R const &r) :
+                l_(l),
+                r_(r),
+                width_(common_extent(l.width(), r.width())),
+                height_(common_extent(l.height(), r.height()))
+        {}
+
+        cursor row(int y) const { return cursor{l_.row(y), r_.row(y)}; }
+        int width() const { return width_; }
+        int height() const { return height_; }
+
+private:
+        L l_;
+        R r_;
+        int width_, height_;
+};
+
+// Applies a user function value_type -> value_type to each pixel.
+template <typename F, typename E>
+class map_node : public pixel_expression<map_node<F, E>> {
+public:
+        using value_type = typename E::value_type;
+
+        struct cursor {
+                typename E::cursor e;
+                F const *f;
+                value_type operator[] (int x) const { return (*f)(e[x]); }
+        };
+
+        map_node(E const &e, F f) : e_(e), f_(std::move(f)) {}
+
+        cursor row(int y) const { return cursor{e_.row(y), &f_}; }
+        int width() const { return e_.width(); }
+        int height() const { return e_.height(); }
+
+private:
+        E e_;
+        F f_;
+};
+
+template <typename Op, typename L, typename R>
+inline auto make_binary(L const &l, R const &r) {
+        return binary_node<Op, L, R>(l, r);
+}
+
+// A scalar operand scales in * and /, and is a pixel in the rest.
+template <typename Op, typename L>
+inline auto make_scalar_binary(Op, L const &l, double r) {
+        using T = typename L::value_type;
+        return make_binary<Op>(l, scalar_leaf<T>(pixel_from_scalar<T>(r)));
+}
+
+template <typename Op, typename R>
+inline auto make_scalar_binary(Op, double l, R const &r) {
+        using T = typename R::value_type;
+        return make_binary<Op>(scalar_leaf<T>(pixel_from_scalar<T>(l)), r);
+}
+
+template <typename L>
+inline auto make_scalar_binary(expr_multiplies, L const &l, double r) {
+        return map_node<expr_scale, L>(l, expr_scale{r});
+}
+
+template <typename R>
+inline auto make_scalar_binary(expr_multiplies, double l, R const &r) {
+        return map_node<expr_scale, R>(r, expr_scale{l});
+}
+
+template <typename L>
+inline auto make_scalar_binary(expr_divides, L const &l, double r) {
+        return map_node<expr_scale_down, L>(l, expr_scale_down{r});
+}
+
+template <typename Op, typename L>
+inline auto make_binary(L const &l, double r) {
+        return make_scalar_binary(Op(), l, r);
+}
+
+template <typename Op, typename R>
+inline auto make_binary(double l, R const &r) {
+        return make_scalar_binary(Op(), l, r);
+}
+
+} }
+
+namespace puffin {
+
+template <typename E>
+template <typename ExecutionPolicy, typename T>
+inline auto pixel_expression<E>::eval_into(
+        ExecutionPolicy const &policy,
+        base_image<T> &dst
+) const -> execution::enable_if_execution_policy<ExecutionPolicy> {
+        static_assert(std::is_same<T, typename E::value_type>::value,
+                      "expression and image value_type differ");
+        E const &e = self();
+        impl::equal_to(dst.width(), e.width());
+        impl::equal_to(dst.height(), e.height());
+
+        const int w = dst.width();
+        impl::for_each_band(policy, dst.height(), dst.stride() * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        T *out = dst.row(y);
+                        const auto in = e.row(y);
+                        for (int x=0; x!=w; ++x)
+                                out[x] = in[x];
+                }
+        });
+}
+
+template <typename T>
+inline auto lazy(base_image<T> const &canvas) {
+        return impl::image_leaf<T>(canvas);
+}
+
+// Applies f to every pixel of the expression, within the same pass.
+template <typename E, typename F>
+inline auto map(pixel_expression<E> const &e, F f) {
+        return impl::map_node<F, E>(e.self(), std::move(f));
+}
+
+// An operator whose right operand is a pixel expression only exists where
+// op can combine pixels, see impl::combines_pixels.
+#define PUFFIN_EXPRESSION_OPERATOR(name, op)                                   \
+template <typename L, typename R,                                              \
+          typename = impl::enable_if_combines_pixels<op, R>>                   \
+inline auto name(pixel_expression<L> const &l, pixel_expression<R> const &r) { \
+        return impl::make_binary<op>(l.self(), r.self());                      \
+}                                                                              \
+template <typename L>                                                          \
+inline auto name(pixel_expression<L> const &l, double r) {                     \
+        return impl::make_binary<op>(l.self(), r);                             \
+}                                                                              \
+template <typename R,                                                          \
+          typename = impl::enable_if_combines_pixels<op, R>>                   \
+inline auto name(double l, pixel_expression<R> const &r) {                     \
+        return impl::make_binary<op>(l, r.self());                             \
+}
+PUFFIN_EXPRESSION_OPERATOR(operator+, impl::expr_plus)
+PUFFIN_EXPRESSION_OPERATOR(operator-, impl::expr_minus)
+PUFFIN_EXPRESSION_OPERATOR(operator*, impl::expr_multiplies)
+PUFFIN_EXPRESSION_OPERATOR(operator/, impl::expr_divides)
+PUFFIN_EXPRESSION_OPERATOR(min, impl::expr_min)
+PUFFIN_EXPRESSION_OPERATOR(max, impl::expr_max)
+#undef PUFFIN_EXPRESSION_OPERATOR
+
+namespace impl {
+template <typename L, typename R, typename = void>
+struct is_divisible : std::false_type {};
+
+template <typename L, typename R>
+struct is_divisible<L, R, decltype(void(std::declval<L>() /
+                                        std::declval<R>()))>
+        : std::true_type {};
+}
+
+static_assert(impl::is_divisible<double, impl::image_leaf<float>>::value &&
+              impl::is_divisible<impl::image_leaf<Color32>, double>::value,
+              "scalars and expressions must divide each other");
+static_assert(!impl::is_divisible<double, impl::image_leaf<Color32>>::value &&
+              !impl::is_divisible<double, impl::image_leaf<Color64>>::value &&
+              !impl::is_divisible<impl::image_leaf<Color32>,
+                                  impl::image_leaf<Color32>>::value,
+              "basic_rgba pixels cannot be divided by pixels");
+
+}
+
+#endif //EXPRESSION_HH_INCLUDED_20261018
@@ -3,17 +3,94 @@
 
 #include "coords.hh"
 #include "color.hh"
+#include "color_ops.hh"
+#include "execution.hh"
+#include "sampling.hh"
+#include "impl/aligned_allocator.hh"
+#include "impl/block_copy.hh"
 #include "impl/contract.hh"
+#include "impl/reverse.hh"
+#include "impl/transpose.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
 #include <vector>
 
 namespace puffin {
 
+// -- image_layout -------------------------------------------------------------
+// Describes how the rows of a base_image are placed in memory. The first
+// row always starts on a 64 byte boundary (a cache line, and wide enough
+// for AVX-512 loads).
+//
+// - packed: rows follow each other without gaps, stride() == width().
+// - aligned: every row starts on a multiple of row_alignment bytes, so SIMD
+//   kernels can use aligned loads on each row.
+// - avoid_set_aliasing: additionally, if the row pitch would be a multiple
+//   of 1 KiB (e.g. for power-of-two widths), one more row_alignment is
+//   added. Otherwise, vertically adjacent pixels map to the same few cache
+//   sets, and column-wise algorithms evict their own data.
+//
+// Any further row_padding bytes are added to each row before alignment.
+struct image_layout {
+        std::size_t row_alignment = 0;
+        std::size_t row_padding = 0;
+        bool avoid_set_aliasing = false;
+
+        static constexpr std::size_t storage_alignment = 64;
+
+        static image_layout packed() noexcept {
+                return image_layout{};
+        }
+
+        static image_layout aligned(
+                std::size_t row_alignment = storage_alignment,
+                std::size_t row_padding = 0
+        ) noexcept {
+                image_layout ret;
+                ret.row_alignment = row_alignment;
+                ret.row_padding = row_padding;
+                return ret;
+        }
+
+        static image_layout anti_aliased(
+                std::size_t row_alignment = storage_alignment
+        ) noexcept {
+                image_layout ret = aligned(row_alignment);
+                ret.avoid_set_aliasing = true;
+                return ret;
+        }
+
+        bool is_packed() const noexcept {
+                return row_alignment <= 1 && row_padding == 0 &&
+                       !avoid_set_aliasing;
+        }
+
+        // Number of elements of size elem_size between two row starts.
+        std::size_t stride(int width, std::size_t elem_size) const noexcept {
+                if (is_packed())
+                        return static_cast<std::size_t>(width);
+                const std::size_t align =
+                        row_alignment > elem_size ? row_alignment : elem_size;
+                const std::size_t raw = width * elem_size + row_padding;
+                std::size_t bytes = (raw + align - 1) / align * align;
+                if (avoid_set_aliasing && bytes % 1024 == 0)
+                        bytes += align;
+                // Alignments that elem_size does not divide cannot be met
+                // for every row; round up to whole elements in that case.
+                return (bytes + elem_size - 1) / elem_size;
+        }
+};
+
 template <typename T>
 class base_image final {
 public:
         // -- types ------------------------------------------------------------
         using value_type = T;
-        using container_type = std::vector<value_type>;
+        using allocator_type = impl::aligned_allocator<
+                value_type, image_layout::storage_alignment>;
+        using container_type = std::vector<value_type, allocator_type>;
 
         using size_type = typename container_type::size_type;
         using difference_type = typename container_type::difference_type;
@@ -30,6 +107,9 @@ public:
         // -- constructors -----------------------------------------------------
         base_image(int width, int height);
         base_image(int width, int height, value_type const &init);
+        base_image(int width, int height, image_layout const &layout);
+        base_image(int width, int height, image_layout const &layout,
+                   value_type const &init);
 
         base_image(base_image const &) = default;
         base_image& operator= (base_image const &) = default;
@@ -52,7 +132,18 @@ public:
         value_type& at(Coords const &);
         value_type at(Coords const &) const;
 
+        // -- raw access -------------------------------------------------------
+        // Rows are stride() elements apart; see image_layout.
+        pointer data() noexcept;
+        const_pointer data() const noexcept;
+
+        pointer row(int y) noexcept;
+        const_pointer row(int y) const noexcept;
+
         // -- iterators --------------------------------------------------------
+        // Iterators traverse the underlying storage. For layouts other than
+        // image_layout::packed(), this includes the padding at the end of
+        // each row; use the algorithms below or row() to visit pixels only.
         iterator begin();
         const_iterator begin() const;
         const_iterator cbegin() const;
@@ -63,35 +154,63 @@ public:
 
         // -- capacity ---------------------------------------------------------
         bool empty() const;
-        size_type size() const;
+        size_type size() const;         // width() * height()
+        size_type storage_size() const; // stride() * height()
         size_type max_size() const;
 
         // -- dimensions -------------------------------------------------------
         int width() const;
         int height() const;
         size_type stride() const;
+        image_layout const& layout() const;
+        bool is_contiguous() const;
 
         // -- algorithms -------------------------------------------------------
+        // The overloads taking an execution policy (see execution.hh) may
+        // call the function concurrently for different rows.
         template <typename RgbFunction>
         void for_each (RgbFunction f);
 
+        template <typename ExecutionPolicy, typename RgbFunction>
+        auto for_each (ExecutionPolicy const &, RgbFunction f)
+                -> execution::enable_if_execution_policy<ExecutionPolicy>;
+
         template <typename RgbFunction>
         void for_each_2di (RgbFunction f);
 
+        template <typename ExecutionPolicy, typename RgbFunction>
+        auto for_each_2di (ExecutionPolicy const &, RgbFunction f)
+                -> execution::enable_if_execution_policy<ExecutionPolicy>;
+
         template <typename RgbFunction>
         void for_each_2dr (RgbFunction f);
 
+        template <typename ExecutionPolicy, typename RgbFunction>
+        auto for_each_2dr (ExecutionPolicy const &, RgbFunction f)
+                -> execution::enable_if_execution_policy<ExecutionPolicy>;
+
         template <typename UnaryPredicate>
         void replace_if(UnaryPredicate pred, const_reference newValue);
 
+        template <typename ExecutionPolicy, typename UnaryPredicate>
+        auto replace_if(ExecutionPolicy const &,
+                        UnaryPredicate pred, const_reference newValue)
+                -> execution::enable_if_execution_policy<ExecutionPolicy>;
+
         void fill(const_reference val);
 
+        template <typename ExecutionPolicy>
+        auto fill(ExecutionPolicy const &, const_reference val)
+                -> execution::enable_if_execution_policy<ExecutionPolicy>;
+
 private:
         int width_ = 0, height_ = 0;
+        image_layout layout_;
+        size_type stride_ = 0;
         container_type pixels_;
 
         void ensureBoundsContract(int x, int y) const {
-                namespace cont = impl::contract;
+                namespace cont = impl;
                 cont::positive(x);
                 cont::less_than(x, width_);
                 cont::positive(y);
@@ -102,9 +221,8 @@ private:
 template <typename T> inline base_image<T> operator* (base_image<T> canvas, double f);
 template <typename T> inline base_image<T> operator* (double f, base_image<T> canvas);
 template <typename T> inline base_image<T> operator/ (base_image<T> canvas, double f);
-template <typename T> inline base_image<T> operator/ (double f, base_image<T> canvas);
-template <typename T> inline base_image<T> operator*= (base_image<T> &canvas, double f);
-template <typename T> inline base_image<T> operator/= (base_image<T> &canvas, double f);
+template <typename T> inline base_image<T>& operator*= (base_image<T> &canvas, double f);
+template <typename T> inline base_image<T>& operator/= (base_image<T> &canvas, double f);
 template <typename T> inline base_image<T> min(base_image<T> canvas, double f);
 template <typename T> inline base_image<T> min(double f, base_image<T> canvas);
 template <typename T> inline base_image<T> max(base_image<T> canvas, double f);
@@ -124,6 +242,48 @@ template <typename T> inline base_image<T> rotate180ccw(base_image<T> const &can
 template <typename T> inline base_image<T> rotate270ccw(base_image<T> const &canvas);
 template <typename T> inline base_image<T> copy(base_image<T> const &, Rect const &);
 
+// In place variants; these need no second image. transpose_inplace
+// requires a square image.
+template <typename T> inline void mirror_x_inplace(base_image<T> &canvas);
+template <typename T> inline void mirror_y_inplace(base_image<T> &canvas);
+template <typename T> inline void transpose_inplace(base_image<T> &canvas);
+template <typename T> inline void rotate180cw_inplace(base_image<T> &canvas);
+template <typename T> inline void rotate180ccw_inplace(base_image<T> &canvas);
+
+// Overloads with an execution policy as first argument, e.g.
+// transpose(execution::par, canvas).
+#define PUFFIN_POLICY_TRANSFORM(name)                                          \
+template <typename ExecutionPolicy, typename T>                                \
+inline auto name(ExecutionPolicy const &, base_image<T> const &canvas)         \
+        -> execution::enable_if_execution_policy<ExecutionPolicy,              \
+                                                 base_image<T>>;
+PUFFIN_POLICY_TRANSFORM(mirror_x)
+PUFFIN_POLICY_TRANSFORM(mirror_y)
+PUFFIN_POLICY_TRANSFORM(transpose)
+PUFFIN_POLICY_TRANSFORM(rotate90cw)
+PUFFIN_POLICY_TRANSFORM(rotate180cw)
+PUFFIN_POLICY_TRANSFORM(rotate270cw)
+PUFFIN_POLICY_TRANSFORM(rotate90ccw)
+PUFFIN_POLICY_TRANSFORM(rotate180ccw)
+PUFFIN_POLICY_TRANSFORM(rotate270ccw)
+#undef PUFFIN_POLICY_TRANSFORM
+
+template <typename ExecutionPolicy, typename T>
+inline auto copy(ExecutionPolicy const &, base_image<T> const &, Rect const &)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+
+#define PUFFIN_POLICY_INPLACE(name)                                            \
+template <typename ExecutionPolicy, typename T>                                \
+inline auto name(ExecutionPolicy const &, base_image<T> &canvas)               \
+        -> execution::enable_if_execution_policy<ExecutionPolicy>;
+PUFFIN_POLICY_INPLACE(mirror_x_inplace)
+PUFFIN_POLICY_INPLACE(mirror_y_inplace)
+PUFFIN_POLICY_INPLACE(transpose_inplace)
+PUFFIN_POLICY_INPLACE(rotate180cw_inplace)
+PUFFIN_POLICY_INPLACE(rotate180ccw_inplace)
+#undef PUFFIN_POLICY_INPLACE
+
 }
 
 //==============================================================================
@@ -133,9 +293,7 @@ namespace puffin {
 
 template <typename T>
 inline base_image<T>::base_image (int width, int height) :
-        width_{support::contract::positive(width)},
-        height_{support::contract::positive(height)},
-        pixels_{width*height}
+        base_image{width, height, image_layout::packed()}
 {
 }
 
@@ -145,9 +303,32 @@ inline base_image<T>::base_image (
         int height,
         value_type const &init
 ) :
-        width_{support::contract::positive(width)},
-        height_{support::contract::positive(height)},
-        pixels_{width*height, init}
+        base_image{width, height, image_layout::packed(), init}
+{
+}
+
+template <typename T>
+inline base_image<T>::base_image (
+        int width,
+        int height,
+        image_layout const &layout
+) :
+        base_image{width, height, layout, value_type()}
+{
+}
+
+template <typename T>
+inline base_image<T>::base_image (
+        int width,
+        int height,
+        image_layout const &layout,
+        value_type const &init
+) :
+        width_{impl::positive(width)},
+        height_{impl::positive(height)},
+        layout_(layout),
+        stride_{layout.stride(width, sizeof(value_type))},
+        pixels_(stride_ * static_cast<size_type>(height), init)
 {
 }
 
@@ -156,13 +337,13 @@ inline base_image<T>::base_image (
 template <typename T>
 inline auto base_image<T>::operator() (int x, int y) -> value_type& {
         ensureBoundsContract(x, y);
-        return pixels_[y*width_ + x];
+        return pixels_[y*stride_ + x];
 }
 
 template <typename T>
 inline auto base_image<T>::operator() (int x, int y) const -> value_type {
         ensureBoundsContract(x, y);
-        return pixels_[y*width_ + x];
+        return pixels_[y*stride_ + x];
 }
 
 template <typename T>
@@ -178,13 +359,13 @@ inline auto base_image<T>::operator() (Coords const &coords) const -> value_type
 template <typename T>
 inline auto base_image<T>::at(int x, int y) -> value_type& {
         ensureBoundsContract(x, y);
-        return pixels_[y*width_ + x];
+        return pixels_[y*stride_ + x];
 }
 
 template <typename T>
 inline auto base_image<T>::at(int x, int y) const -> value_type {
         ensureBoundsContract(x, y);
-        return pixels_[y*width_ + x];
+        return pixels_[y*stride_ + x];
 }
 
 template <typename T>
@@ -197,6 +378,28 @@ inline auto base_image<T>::at(Coords const &coords) const -> value_type {
         return at(coords.x, coords.y);
 }
 
+// -- raw access -------------------------------------------------------
+
+template <typename T>
+inline auto base_image<T>::data() noexcept -> pointer {
+        return pixels_.data();
+}
+
+template <typename T>
+inline auto base_image<T>::data() const noexcept -> const_pointer {
+        return pixels_.data();
+}
+
+template <typename T>
+inline auto base_image<T>::row(int y) noexcept -> pointer {
+        return pixels_.data() + y*stride_;
+}
+
+template <typename T>
+inline auto base_image<T>::row(int y) const noexcept -> const_pointer {
+        return pixels_.data() + y*stride_;
+}
+
 // -- iterators --------------------------------------------------------
 
 template <typename T>
@@ -238,6 +441,11 @@ inline auto base_image<T>::empty() const -> bool {
 
 template <typename T>
 inline auto base_image<T>::size() const -> size_type {
+        return static_cast<size_type>(width_) * height_;
+}
+
+template <typename T>
+inline auto base_image<T>::storage_size() const -> size_type {
         return pixels_.size();
 }
 
@@ -260,7 +468,17 @@ inline auto base_image<T>::height() const -> int {
 
 template <typename T>
 inline auto base_image<T>::stride() const -> size_type {
-        return width();
+        return stride_;
+}
+
+template <typename T>
+inline auto base_image<T>::layout() const -> image_layout const& {
+        return layout_;
+}
+
+template <typename T>
+inline auto base_image<T>::is_contiguous() const -> bool {
+        return stride_ == static_cast<size_type>(width_);
 }
 
 // -- algorithms -------------------------------------------------------
@@ -268,38 +486,77 @@ inline auto base_image<T>::stride() const -> size_type {
 template <typename T>
 template <typename RgbFunction>
 inline auto base_image<T>::for_each (RgbFunction f) -> void {
-        std::for_each(begin(), end(), f);
+        for_each(execution::seq, f);
+}
+
+template <typename T>
+template <typename ExecutionPolicy, typename RgbFunction>
+inline auto base_image<T>::for_each (ExecutionPolicy const &policy,
+                                     RgbFunction f)
+        -> execution::enable_if_execution_policy<ExecutionPolicy>
+{
+        impl::for_each_band(policy, height_, stride_ * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        pointer pixel = row(y);
+                        std::for_each(pixel, pixel + width_, f);
+                }
+        });
 }
 
 template <typename T>
 template <typename RgbFunction>
 inline auto base_image<T>::for_each_2di (RgbFunction f) -> void {
-        for (int y=0; y!=height_; ++y) {
-                pointer pixel = pixels_.data() + y*stride();
-                for (int x=0; x!=width_; ++x) {
-                        f(x, y, *pixel);
-                        ++pixel;
+        for_each_2di(execution::seq, f);
+}
+
+template <typename T>
+template <typename ExecutionPolicy, typename RgbFunction>
+inline auto base_image<T>::for_each_2di (ExecutionPolicy const &policy,
+                                         RgbFunction f)
+        -> execution::enable_if_execution_policy<ExecutionPolicy>
+{
+        impl::for_each_band(policy, height_, stride_ * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        pointer pixel = row(y);
+                        for (int x=0; x!=width_; ++x) {
+                                f(x, y, *pixel);
+                                ++pixel;
+                        }
                 }
-        }
+        });
 }
 
 template <typename T>
 template <typename RgbFunction>
 inline auto base_image<T>::for_each_2dr (RgbFunction f) -> void {
-        using double;
+        for_each_2dr(execution::seq, f);
+}
+
+template <typename T>
+template <typename ExecutionPolicy, typename RgbFunction>
+inline auto base_image<T>::for_each_2dr (ExecutionPolicy const &policy,
+                                         RgbFunction f)
+        -> execution::enable_if_execution_policy<ExecutionPolicy>
+{
         const auto yStep = double{1} / double{height()};
         const auto xStep = double{1} / double{width()};
-        auto fy = double(0);
-        for (int y=0; y!=height_; ++y) {
-                auto fx = double(0);
-                pointer pixel = pixels_.data() + y*stride();
-                for (int x=0; x!=width_; ++x) {
-                        f(fx, fy, *pixel);
-                        ++pixel;
-                        fx += xStep;
+        impl::for_each_band(policy, height_, stride_ * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        // Not accumulated across rows, so that fy does not
+                        // depend on where a band starts.
+                        const auto fy = y * yStep;
+                        auto fx = double(0);
+                        pointer pixel = row(y);
+                        for (int x=0; x!=width_; ++x) {
+                                f(fx, fy, *pixel);
+                                ++pixel;
+                                fx += xStep;
+                        }
                 }
-                fy += yStep;
-        }
+        });
 }
 
 template <typename T>
@@ -308,94 +565,104 @@ inline auto base_image<T>::replace_if(
         UnaryPredicate pred,
         const_reference newValue
 ) -> void {
-        std::replace_if(begin(), end(), pred, newValue);
+        replace_if(execution::seq, pred, newValue);
 }
 
 template <typename T>
-inline auto base_image<T>::fill(const_reference val) -> void {
-        for_each([=] (reference pixel) {
-                pixel = val;
+template <typename ExecutionPolicy, typename UnaryPredicate>
+inline auto base_image<T>::replace_if(
+        ExecutionPolicy const &policy,
+        UnaryPredicate pred,
+        const_reference newValue
+) -> execution::enable_if_execution_policy<ExecutionPolicy> {
+        impl::for_each_band(policy, height_, stride_ * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        pointer pixel = row(y);
+                        std::replace_if(pixel, pixel + width_, pred, newValue);
+                }
         });
 }
 
 template <typename T>
-inline auto operator* (base_image<T> canvas, double f) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = rgb * f;
-        });
-        return canvas;
+inline auto base_image<T>::fill(const_reference val) -> void {
+        fill(execution::seq, val);
 }
 
 template <typename T>
-inline auto operator* (double f, base_image<T> canvas) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = f * rgb;
+template <typename ExecutionPolicy>
+inline auto base_image<T>::fill(
+        ExecutionPolicy const &policy,
+        const_reference val
+) -> execution::enable_if_execution_policy<ExecutionPolicy> {
+        impl::for_each_band(policy, height_, stride_ * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y)
+                        impl::fill_n(row(y), width_, val);
         });
+}
+
+// The scalar operators below run on whole rows through the *_span
+// functions of color_ops.hh, which are SIMD for Color32 and Color64. In *
+// and /, f is a scale factor; in min() and max() it stands for the pixel
+// impl::pixel_from_scalar() makes of it, a fraction of full scale for
+// basic_rgba, so that min(img, 0.9) caps every channel at 90%.
+template <typename T>
+inline auto operator* (base_image<T> canvas, double f) -> base_image<T> {
+        canvas *= f;
         return canvas;
 }
 
 template <typename T>
-inline auto operator/ (base_image<T> canvas, double f) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = rgb / f;
-        });
+inline auto operator* (double f, base_image<T> canvas) -> base_image<T> {
+        canvas *= f;
         return canvas;
 }
 
 template <typename T>
-inline auto operator/ (double f, base_image<T> canvas) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = f / rgb;
-        });
+inline auto operator/ (base_image<T> canvas, double f) -> base_image<T> {
+        canvas /= f;
         return canvas;
 }
 
 template <typename T>
-inline auto operator*= (base_image<T> &canvas, double f) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = rgb * f;
-        });
+inline auto operator*= (base_image<T> &canvas, double f) -> base_image<T>& {
+        for (int y=0; y!=canvas.height(); ++y)
+                scale_span(canvas.row(y), f, canvas.row(y), canvas.width());
         return canvas;
 }
 
 template <typename T>
-inline auto operator/= (base_image<T> &canvas, double f) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = rgb / f;
-        });
+inline auto operator/= (base_image<T> &canvas, double f) -> base_image<T>& {
+        for (int y=0; y!=canvas.height(); ++y)
+                div_span(canvas.row(y), f, canvas.row(y), canvas.width());
         return canvas;
 }
 
 template <typename T>
 inline auto min (base_image<T> canvas, double f) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = min(rgb, f);
-        });
+        const T v = impl::pixel_from_scalar<T>(f);
+        for (int y=0; y!=canvas.height(); ++y)
+                min_span(canvas.row(y), v, canvas.row(y), canvas.width());
         return canvas;
 }
 
 template <typename T>
 inline auto min (double f, base_image<T> canvas) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = min(f, rgb);
-        });
-        return canvas;
+        return min(std::move(canvas), f);
 }
 
 template <typename T>
 inline auto max (base_image<T> canvas, double f) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = max(rgb, f);
-        });
+        const T v = impl::pixel_from_scalar<T>(f);
+        for (int y=0; y!=canvas.height(); ++y)
+                max_span(canvas.row(y), v, canvas.row(y), canvas.width());
         return canvas;
 }
 
 template <typename T>
 inline auto max (double f, base_image<T> canvas) -> base_image<T> {
-        canvas.for_each([f] (Rgb &rgb) {
-                rgb = max(f, rgb);
-        });
-        return canvas;
+        return max(std::move(canvas), f);
 }
 
 template <typename T>
@@ -408,93 +675,295 @@ inline auto height (base_image<T> const &canvas) -> int {
         return canvas.height();
 }
 
+// Sequential transforms forward to the policy overloads.
+#define PUFFIN_SEQ_TRANSFORM(name)                                             \
+template <typename T>                                                          \
+inline auto name(base_image<T> const &canvas) -> base_image<T> {               \
+        return name(execution::seq, canvas);                                   \
+}
+PUFFIN_SEQ_TRANSFORM(mirror_x)
+PUFFIN_SEQ_TRANSFORM(mirror_y)
+PUFFIN_SEQ_TRANSFORM(transpose)
+PUFFIN_SEQ_TRANSFORM(rotate90cw)
+PUFFIN_SEQ_TRANSFORM(rotate180cw)
+PUFFIN_SEQ_TRANSFORM(rotate270cw)
+PUFFIN_SEQ_TRANSFORM(rotate90ccw)
+PUFFIN_SEQ_TRANSFORM(rotate180ccw)
+PUFFIN_SEQ_TRANSFORM(rotate270ccw)
+#undef PUFFIN_SEQ_TRANSFORM
+
+#define PUFFIN_SEQ_INPLACE(name)                                               \
+template <typename T>                                                          \
+inline void name(base_image<T> &canvas) {                                      \
+        name(execution::seq, canvas);                                          \
+}
+PUFFIN_SEQ_INPLACE(mirror_x_inplace)
+PUFFIN_SEQ_INPLACE(mirror_y_inplace)
+PUFFIN_SEQ_INPLACE(transpose_inplace)
+PUFFIN_SEQ_INPLACE(rotate180cw_inplace)
+PUFFIN_SEQ_INPLACE(rotate180ccw_inplace)
+#undef PUFFIN_SEQ_INPLACE
+
 template <typename T>
-inline auto mirror_x(base_image<T> const &canvas) -> base_image<T> {
-        base_image<T> ret {canvas.width(), canvas.height()};
-        const auto m = canvas.width() - 1;
-        ret.for_each_2di([&] (auto x, auto y, T &p) {
-                p = canvas(m - x, y);
+inline base_image<T> copy(base_image<T> const &canvas, Rect const &rect) {
+        return copy(execution::seq, canvas, rect);
+}
+
+// -- mirror, rotate180 --------------------------------------------------------
+template <typename ExecutionPolicy, typename T>
+inline auto mirror_x(ExecutionPolicy const &policy, base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        base_image<T> ret {canvas.width(), canvas.height(), canvas.layout()};
+        impl::for_each_band(policy, canvas.height(),
+                            canvas.stride() * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        T const *src = canvas.row(y);
+                        std::reverse_copy(src, src + canvas.width(),
+                                          ret.row(y));
+                }
         });
         return ret;
 }
 
-template <typename T>
-inline auto mirror_y(base_image<T> const &canvas) -> base_image<T> {
-        base_image<T> ret {canvas.width(), canvas.height()};
+template <typename ExecutionPolicy, typename T>
+inline auto mirror_y(ExecutionPolicy const &policy, base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        base_image<T> ret {canvas.width(), canvas.height(), canvas.layout()};
         const auto m = canvas.height() - 1;
-        ret.for_each_2di([&] (auto x, auto y, T &p) {
-                p = canvas(x, m - y);
+        impl::for_each_band(policy, canvas.height(),
+                            canvas.stride() * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        impl::copy_n(canvas.row(m - y), canvas.width(),
+                                     ret.row(y));
+                }
         });
         return ret;
 }
 
-template <typename T>
-inline auto transpose(base_image<T> const &canvas) -> base_image<T> {
-        base_image<T> ret {canvas.height(), canvas.width()};
-        ret.for_each_2di([&] (auto x, auto y, T &p) {
-                p = canvas(y, x);
+template <typename ExecutionPolicy, typename T>
+inline auto rotate180cw(ExecutionPolicy const &policy,
+                        base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        base_image<T> ret {canvas.width(), canvas.height(), canvas.layout()};
+        const auto m = canvas.height() - 1;
+        impl::for_each_band(policy, canvas.height(),
+                            canvas.stride() * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        T const *src = canvas.row(m - y);
+                        std::reverse_copy(src, src + canvas.width(),
+                                          ret.row(y));
+                }
         });
         return ret;
 }
 
-template <typename T>
-inline auto rotate90cw(base_image<T> const &canvas) -> base_image<T> {
+// -- transpose, rotate90/270 --------------------------------------------------
+namespace impl {
+// Transposes canvas into ret, which must be canvas.height() x
+// canvas.width(). src/dst may address the first or the last row, with
+// the stride negated for the latter, see rotate90cw and rotate270cw.
+// Bands are whole tile rows of the source, so that no two threads write
+// into the same cache line of the destination.
+template <typename ExecutionPolicy, typename T>
+inline void transpose_into(
+        ExecutionPolicy const &policy,
+        base_image<T> const &canvas,
+        T const *src, std::ptrdiff_t srcStride,
+        T *dst, std::ptrdiff_t dstStride
+) {
+        const int w = canvas.width();
+        for_each_band(policy, canvas.height(), canvas.stride() * sizeof(T),
+                      transpose_tile, [&] (int y0, int y1) {
+                transpose(src + y0*srcStride, srcStride,
+                          dst + y0, dstStride,
+                          w, y1 - y0);
+        });
+}
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto transpose(ExecutionPolicy const &policy,
+                      base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        base_image<T> ret {canvas.height(), canvas.width(), canvas.layout()};
+        impl::transpose_into(policy, canvas,
+                             canvas.row(0), std::ptrdiff_t(canvas.stride()),
+                             ret.row(0), std::ptrdiff_t(ret.stride()));
+        return ret;
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate90cw(ExecutionPolicy const &policy,
+                       base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
         // [00 10 20]             [00 01 02]            [02 01 00]
         // [01 11 21], transpose: [10 11 12], mirror_x: [12 11 10]
         // [02 12 22]             [20 21 22]            [22 21 20]
-        base_image<T> ret {canvas.height(), canvas.width()};
-        const auto m = canvas.height() - 1;
-        ret.for_each_2di([&] (auto x, auto y, T &p) {
-                p = canvas(y, m - x);
-        });
+        //
+        // Equivalently, transpose the source read from its last row up.
+        base_image<T> ret {canvas.height(), canvas.width(), canvas.layout()};
+        impl::transpose_into(policy, canvas,
+                             canvas.row(canvas.height() - 1),
+                             -std::ptrdiff_t(canvas.stride()),
+                             ret.row(0), std::ptrdiff_t(ret.stride()));
         return ret;
 }
 
-template <typename T>
-inline auto rotate180cw(base_image<T> const &canvas) -> base_image<T> {
-        base_image<T> ret {canvas.width(), canvas.height()};
-        const auto mw = canvas.width() - 1;
-        const auto mh = canvas.height() - 1;
-        ret.for_each_2di([&] (auto x, auto y, T &p) {
-                p = canvas(mw - x, mh - y);
-        });
+template <typename ExecutionPolicy, typename T>
+inline auto rotate270cw(ExecutionPolicy const &policy,
+                        base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        // Transpose, writing the destination from its last row up.
+        base_image<T> ret {canvas.height(), canvas.width(), canvas.layout()};
+        impl::transpose_into(policy, canvas,
+                             canvas.row(0), std::ptrdiff_t(canvas.stride()),
+                             ret.row(ret.height() - 1),
+                             -std::ptrdiff_t(ret.stride()));
         return ret;
 }
 
-template <typename T>
-inline auto rotate270cw(base_image<T> const &canvas) -> base_image<T> {
-        base_image<T> ret {canvas.height(), canvas.width()};
-        const auto m = canvas.width() - 1;
-        ret.for_each_2di([&] (auto x, auto y, T &p) {
-                p = canvas(m - y, x);
+template <typename ExecutionPolicy, typename T>
+inline auto rotate90ccw(ExecutionPolicy const &policy,
+                        base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return rotate270cw(policy, canvas);
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate180ccw(ExecutionPolicy const &policy,
+                         base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return rotate180cw(policy, canvas);
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate270ccw(ExecutionPolicy const &policy,
+                         base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return rotate90cw(policy, canvas);
+}
+
+// -- copy ---------------------------------------------------------------------
+template <typename ExecutionPolicy, typename T>
+inline auto copy(ExecutionPolicy const &policy,
+                 base_image<T> const &canvas,
+                 Rect const &rect)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        impl::positive(rect.left());
+        impl::positive(rect.top());
+        impl::less_or_equal(rect.right(), canvas.width());
+        impl::less_or_equal(rect.bottom(), canvas.height());
+
+        base_image<T> ret {rect.width(), rect.height()};
+        impl::for_each_band(policy, rect.height(),
+                            ret.stride() * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                impl::copy_rows(canvas.row(y0 + rect.top()) + rect.left(),
+                                canvas.stride(),
+                                ret.row(y0), ret.stride(),
+                                rect.width(), y1 - y0);
         });
         return ret;
 }
 
-template <typename T>
-inline auto rotate90ccw(base_image<T> const &canvas) -> base_image<T> {
-        return rotate270cw(canvas);
+// -- in place -----------------------------------------------------------------
+template <typename ExecutionPolicy, typename T>
+inline auto mirror_x_inplace(ExecutionPolicy const &policy,
+                             base_image<T> &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy>
+{
+        impl::for_each_band(policy, canvas.height(),
+                            canvas.stride() * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y)
+                        impl::reverse(canvas.row(y), canvas.width());
+        });
 }
 
-template <typename T>
-inline auto rotate180ccw(base_image<T> const &canvas) -> base_image<T> {
-        return rotate180cw(canvas);
+template <typename ExecutionPolicy, typename T>
+inline auto mirror_y_inplace(ExecutionPolicy const &policy,
+                             base_image<T> &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy>
+{
+        const auto m = canvas.height() - 1;
+        impl::for_each_band(policy, canvas.height() / 2,
+                            2 * canvas.stride() * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        T *a = canvas.row(y);
+                        std::swap_ranges(a, a + canvas.width(),
+                                         canvas.row(m - y));
+                }
+        });
 }
 
-template <typename T>
-inline auto rotate270ccw(base_image<T> const &canvas) -> base_image<T> {
-        return rotate90cw(canvas);
+template <typename ExecutionPolicy, typename T>
+inline auto transpose_inplace(ExecutionPolicy const &policy,
+                              base_image<T> &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy>
+{
+        using impl::transpose_tile;
+        const int n = impl::equal_to(canvas.width(), canvas.height());
+        const auto stride = std::ptrdiff_t(canvas.stride());
+        // One unit per tile row; the tile row at by owns all tile pairs
+        // (by, bx) with bx >= by.
+        impl::for_each_band(policy, (n + transpose_tile - 1) / transpose_tile,
+                            transpose_tile * stride * sizeof(T), 1,
+                            [&] (int t0, int t1) {
+                for (int t=t0; t!=t1; ++t) {
+                        impl::transpose_square_inplace_tile_row(
+                                canvas.row(0), stride, n, t * transpose_tile);
+                }
+        });
 }
 
-template <typename T>
-inline base_image<T> copy(base_image<T> const &canvas, Rect const &rect) {
-        base_image<T> ret {rect.width(), rect.height()};
-        for (int y=rect.top(); y!=rect.bottom(); y++) {
-                for (int x=rect.left(); x!=rect.right(); x++) {
-                        ret(x-rect.left(), y-rect.top()) = canvas(x, y);
+template <typename ExecutionPolicy, typename T>
+inline auto rotate180cw_inplace(ExecutionPolicy const &policy,
+                                base_image<T> &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy>
+{
+        const auto m = canvas.height() - 1;
+        impl::for_each_band(policy, canvas.height() / 2,
+                            2 * canvas.stride() * sizeof(T), 1,
+                            [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        impl::swap_reversed(canvas.row(y), canvas.row(m - y),
+                                            canvas.width());
                 }
-        }
-        return ret;
+        });
+        if (canvas.height() % 2 != 0)
+                impl::reverse(canvas.row(m / 2), canvas.width());
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate180ccw_inplace(ExecutionPolicy const &policy,
+                                 base_image<T> &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy>
+{
+        rotate180cw_inplace(policy, canvas);
 }
 }
 
@@ -502,11 +971,7 @@ inline base_image<T> copy(base_image<T> const &canvas, Rect const &rect) {
 // ImageFilter
 namespace puffin {
 
-enum class Filtering {
-        Nearest,
-        Bilinear,
-        // TODO: Anisotropic
-};
+template <typename T> class mip_chain; // mipmap.hh
 
 struct ImageFilter {
 
@@ -528,13 +993,62 @@ struct ImageFilter {
                 double u,
                 double v
         ) const noexcept -> typename ImageT::value_type {
-                switch (filtering_) {
-                case Filtering::Bilinear:
-                        return bilinear(img, u, v);
-                case Filtering::Nearest:
-                default:
-                        return nearest(img, u, v);
-                }
+                return visit([&] (auto sampler) {
+                        return sampler(img, u, v);
+                });
+        }
+
+        // Samples n points at once, out[i] = (*this)(img, u[i], v[i]), but
+        // with the coordinates computed in float. Filtering and wrapping
+        // are resolved once per call instead of per sample, and texel
+        // indices and weights are computed for several samples at a time
+        // (see sampling.hh).
+        template<typename ImageT>
+        void sample(
+                ImageT const &img,
+                float const *u, float const *v, std::size_t n,
+                typename ImageT::value_type *out
+        ) const noexcept {
+                visit([&] (auto sampler) {
+                        sampler.sample(img, u, v, n, out);
+                });
+        }
+
+        // As sample(), for the n points (u0 + i*du, v0 + i*dv) of a line,
+        // e.g. a scanline of a textured span.
+        template<typename ImageT>
+        void sample_span(
+                ImageT const &img,
+                float u0, float v0, float du, float dv, std::size_t n,
+                typename ImageT::value_type *out
+        ) const noexcept {
+                visit([&] (auto sampler) {
+                        sampler.sample_span(img, u0, v0, du, dv, n, out);
+                });
+        }
+
+        // Samples a mip_chain (see mipmap.hh) for a pixel whose footprint
+        // spans du x dv texture coordinates, e.g. the differences of u and
+        // v to the neighbouring pixels. Nearest and Bilinear sample the
+        // nearest level, Trilinear blends bilinear samples of the two
+        // levels around mip_chain::lod(du, dv). At most 8 texels are read,
+        // however far the image is minified.
+        template<typename T>
+        T operator()(
+                mip_chain<T> const &chain,
+                double u, double v,
+                double du, double dv
+        ) const noexcept;
+
+        // Calls fn with the Sampler (see sampling.hh) for this filter's
+        // settings and returns its result. Loops over many samples can
+        // resolve the settings once this way, rather than per call of
+        // operator().
+        template<typename Fn>
+        auto visit(Fn &&fn) const {
+                return visit_sampler(filtering_,
+                                     wrap_.wrapping_x, wrap_.wrapping_y,
+                                     std::forward<Fn>(fn));
         }
 
 private:
@@ -543,11 +1057,10 @@ private:
                 ImageT const &img,
                 double u, double v
         ) const noexcept -> typename ImageT::value_type {
-                const auto coords = wrap_(img, {
-                        static_cast<int>(round(u * double{img.width()})),
-                        static_cast<int>(round(v * double{img.height()}))
-                });
-                return img(coords.x, coords.y);
+                return visit_sampler(
+                        Filtering::Nearest,
+                        wrap_.wrapping_x, wrap_.wrapping_y,
+                        [&] (auto sampler) { return sampler(img, u, v); });
         }
 
         template<typename ImageT>
@@ -555,30 +1068,10 @@ private:
                 ImageT const &img,
                 double u, double v
         ) const noexcept -> typename ImageT::value_type {
-                const auto fx = u * double{img.width()};
-                const auto fy = v * double{img.height()};
-                const auto ix = static_cast<int>(floor(fx));
-                const auto iy = static_cast<int>(floor(fy));
-
-                const double frac_x = fx - double{ix};
-                const double frac_y = fy - double{iy};
-
-                const Coords
-                        w00{wrap_(img, Coords{ix, iy})},
-                        w10{wrap_(img, Coords{ix + 1, iy})},
-                        w01{wrap_(img, Coords{ix, iy + 1})},
-                        w11{wrap_(img, Coords{ix + 1, iy + 1})};
-
-                const auto
-                        C00 = img(w00),
-                        C10 = img(w10),
-                        C01 = img(w01),
-                        C11 = img(w11);
-
-                const auto A = (1_R - frac_x) * C00 + frac_x * C10;
-                const auto B = (1_R - frac_x) * C01 + frac_x * C11;
-                const auto C = (1_R - frac_y) * A + frac_y * B;
-                return C;
+                return visit_sampler(
+                        Filtering::Bilinear,
+                        wrap_.wrapping_x, wrap_.wrapping_y,
+                        [&] (auto sampler) { return sampler(img, u, v); });
         }
 
 private:
@@ -588,5 +1081,8 @@ private:
 
 typedef base_image<Color64> Image64;
 typedef base_image<Color32> Image32;
+typedef base_image<Color64Bgra> Image64Bgra;
+typedef base_image<Color32Bgra> Image32Bgra;
+typedef base_image<ColorF> ImageF;
 }
 #endif //CANVAS_HH_INCLUDED_20181221
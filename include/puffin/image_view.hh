@@ -0,0 +1,362 @@
+#ifndef IMAGE_VIEW_HH_INCLUDED_20261018
+#define IMAGE_VIEW_HH_INCLUDED_20261018
+
+#include "coords.hh"
+#include "image.hh"
+#include "impl/contract.hh"
+#include <cstddef>
+
+namespace puffin {
+
+// -- image_view ---------------------------------------------------------------
+// A read-only, non-owning view of width() x height() pixels whose rows are
+// stride() elements apart, e.g. a base_image or a rectangle of one. Views are
+// cheap to copy; the viewed pixels must outlive them.
+//
+// Algorithms that only read pixels take an image_view, so that they work on
+// parts of images and on pixels owned by others (decoders, SDL surfaces)
+// without a copy. base_image converts implicitly.
+template <typename T>
+class image_view final {
+public:
+        // -- types ------------------------------------------------------------
+        using value_type = T;
+        using size_type = std::size_t;
+        using const_pointer = T const *;
+
+        // -- constructors -----------------------------------------------------
+        image_view(T const *data, int width, int height, size_type stride);
+        image_view(base_image<T> const &canvas) noexcept;
+
+        // -- element access ---------------------------------------------------
+        value_type operator() (int x, int y) const;
+        value_type operator() (Coords const &) const;
+
+        value_type at(int x, int y) const;
+        value_type at(Coords const &) const;
+
+        // -- raw access -------------------------------------------------------
+        const_pointer data() const noexcept;
+        const_pointer row(int y) const noexcept;
+
+        // -- dimensions -------------------------------------------------------
+        bool empty() const noexcept;
+        int width() const noexcept;
+        int height() const noexcept;
+        size_type stride() const noexcept;
+
+        // The pixels of rect, which must lie inside the view.
+        image_view subview(Rect const &rect) const;
+
+private:
+        T const *data_;
+        int width_, height_;
+        size_type stride_;
+
+        void ensureBoundsContract(int x, int y) const {
+                impl::positive(x);
+                impl::less_than(x, width_);
+                impl::positive(y);
+                impl::less_than(y, height_);
+        }
+};
+
+// -- mutable_image_view -------------------------------------------------------
+// As image_view, with write access to the pixels, e.g. the destination of
+// blit(). Converts to image_view.
+template <typename T>
+class mutable_image_view final {
+public:
+        // -- types ------------------------------------------------------------
+        using value_type = T;
+        using size_type = std::size_t;
+        using pointer = T *;
+
+        // -- constructors -----------------------------------------------------
+        mutable_image_view(T *data, int width, int height, size_type stride);
+        mutable_image_view(base_image<T> &canvas) noexcept;
+
+        operator image_view<T> () const noexcept;
+
+        // -- element access ---------------------------------------------------
+        value_type& operator() (int x, int y) const;
+        value_type& operator() (Coords const &) const;
+
+        value_type& at(int x, int y) const;
+        value_type& at(Coords const &) const;
+
+        // -- raw access -------------------------------------------------------
+        pointer data() const noexcept;
+        pointer row(int y) const noexcept;
+
+        // -- dimensions -------------------------------------------------------
+        bool empty() const noexcept;
+        int width() const noexcept;
+        int height() const noexcept;
+        size_type stride() const noexcept;
+
+        mutable_image_view subview(Rect const &rect) const;
+
+private:
+        T *data_;
+        int width_, height_;
+        size_type stride_;
+};
+
+template <typename T> inline int width(image_view<T> const &view);
+template <typename T> inline int height(image_view<T> const &view);
+
+// view(canvas[, rect]): a view of canvas, or of a rectangle of it.
+template <typename T>
+inline image_view<T> view(base_image<T> const &canvas);
+template <typename T>
+inline image_view<T> view(base_image<T> const &canvas, Rect const &rect);
+
+template <typename T>
+inline int width(mutable_image_view<T> const &view);
+template <typename T>
+inline int height(mutable_image_view<T> const &view);
+
+template <typename T>
+inline mutable_image_view<T> mutable_view(base_image<T> &canvas);
+template <typename T>
+inline mutable_image_view<T> mutable_view(base_image<T> &canvas,
+                                          Rect const &rect);
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin {
+
+template <typename T>
+inline image_view<T>::image_view(
+        T const *data,
+        int width, int height,
+        size_type stride
+) :
+        data_{data},
+        width_{impl::positive(width)},
+        height_{impl::positive(height)},
+        stride_{impl::greater_or_equal(stride, size_type(width))}
+{
+}
+
+template <typename T>
+inline image_view<T>::image_view(base_image<T> const &canvas) noexcept :
+        data_{canvas.data()},
+        width_{canvas.width()},
+        height_{canvas.height()},
+        stride_{canvas.stride()}
+{
+}
+
+template <typename T>
+inline auto image_view<T>::operator() (int x, int y) const -> value_type {
+        ensureBoundsContract(x, y);
+        return row(y)[x];
+}
+
+template <typename T>
+inline auto image_view<T>::operator() (Coords const &coords) const
+        -> value_type
+{
+        return (*this)(coords.x, coords.y);
+}
+
+template <typename T>
+inline auto image_view<T>::at(int x, int y) const -> value_type {
+        return (*this)(x, y);
+}
+
+template <typename T>
+inline auto image_view<T>::at(Coords const &coords) const -> value_type {
+        return (*this)(coords);
+}
+
+template <typename T>
+inline auto image_view<T>::data() const noexcept -> const_pointer {
+        return data_;
+}
+
+template <typename T>
+inline auto image_view<T>::row(int y) const noexcept -> const_pointer {
+        return data_ + static_cast<size_type>(y) * stride_;
+}
+
+template <typename T>
+inline auto image_view<T>::empty() const noexcept -> bool {
+        return width_ == 0 || height_ == 0;
+}
+
+template <typename T>
+inline auto image_view<T>::width() const noexcept -> int {
+        return width_;
+}
+
+template <typename T>
+inline auto image_view<T>::height() const noexcept -> int {
+        return height_;
+}
+
+template <typename T>
+inline auto image_view<T>::stride() const noexcept -> size_type {
+        return stride_;
+}
+
+template <typename T>
+inline auto image_view<T>::subview(Rect const &rect) const -> image_view {
+        impl::positive(rect.left());
+        impl::positive(rect.top());
+        impl::less_or_equal(rect.right(), width_);
+        impl::less_or_equal(rect.bottom(), height_);
+        return image_view{row(rect.top()) + rect.left(),
+                          rect.width(), rect.height(), stride_};
+}
+
+template <typename T>
+inline int width(image_view<T> const &view) {
+        return view.width();
+}
+
+template <typename T>
+inline int height(image_view<T> const &view) {
+        return view.height();
+}
+
+template <typename T>
+inline image_view<T> view(base_image<T> const &canvas) {
+        return image_view<T>{canvas};
+}
+
+template <typename T>
+inline image_view<T> view(base_image<T> const &canvas, Rect const &rect) {
+        return image_view<T>{canvas}.subview(rect);
+}
+
+// -- mutable_image_view -------------------------------------------------------
+template <typename T>
+inline mutable_image_view<T>::mutable_image_view(
+        T *data,
+        int width, int height,
+        size_type stride
+) :
+        data_{data},
+        width_{impl::positive(width)},
+        height_{impl::positive(height)},
+        stride_{impl::greater_or_equal(stride, size_type(width))}
+{
+}
+
+template <typename T>
+inline mutable_image_view<T>::mutable_image_view(base_image<T> &canvas)
+        noexcept :
+        data_{canvas.data()},
+        width_{canvas.width()},
+        height_{canvas.height()},
+        stride_{canvas.stride()}
+{
+}
+
+template <typename T>
+inline mutable_image_view<T>::operator image_view<T> () const noexcept {
+        return image_view<T>{data_, width_, height_, stride_};
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::operator() (int x, int y) const
+        -> value_type&
+{
+        impl::positive(x);
+        impl::less_than(x, width_);
+        impl::positive(y);
+        impl::less_than(y, height_);
+        return row(y)[x];
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::operator() (Coords const &coords) const
+        -> value_type&
+{
+        return (*this)(coords.x, coords.y);
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::at(int x, int y) const -> value_type& {
+        return (*this)(x, y);
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::at(Coords const &coords) const
+        -> value_type&
+{
+        return (*this)(coords);
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::data() const noexcept -> pointer {
+        return data_;
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::row(int y) const noexcept -> pointer {
+        return data_ + static_cast<size_type>(y) * stride_;
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::empty() const noexcept -> bool {
+        return width_ == 0 || height_ == 0;
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::width() const noexcept -> int {
+        return width_;
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::height() const noexcept -> int {
+        return height_;
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::stride() const noexcept -> size_type {
+        return stride_;
+}
+
+template <typename T>
+inline auto mutable_image_view<T>::subview(Rect const &rect) const
+        -> mutable_image_view
+{
+        impl::positive(rect.left());
+        impl::positive(rect.top());
+        impl::less_or_equal(rect.right(), width_);
+        impl::less_or_equal(rect.bottom(), height_);
+        return mutable_image_view{row(rect.top()) + rect.left(),
+                                  rect.width(), rect.height(), stride_};
+}
+
+template <typename T>
+inline int width(mutable_image_view<T> const &view) {
+        return view.width();
+}
+
+template <typename T>
+inline int height(mutable_image_view<T> const &view) {
+        return view.height();
+}
+
+template <typename T>
+inline mutable_image_view<T> mutable_view(base_image<T> &canvas) {
+        return mutable_image_view<T>{canvas};
+}
+
+template <typename T>
+inline mutable_image_view<T> mutable_view(base_image<T> &canvas,
+                                          Rect const &rect) {
+        return mutable_image_view<T>{canvas}.subview(rect);
+}
+
+}
+
+#endif //IMAGE_VIEW_HH_INCLUDED_20261018
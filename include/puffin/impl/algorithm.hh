@@ -13,7 +13,8 @@ constexpr int clamp(int i, int m) noexcept {
 
 constexpr int wrap (int i, int m) noexcept {
         const int m_ = m + 1; // make 0..m inclusive
-        return ((i % m_) + m_) % m_;
+        const int r = i % m_; // one division; r has the sign of i
+        return r < 0 ? r + m_ : r;
 #if 0
         // This is a variant I developed by trial and error.
         if (i < 0) {
@@ -63,11 +64,12 @@ constexpr int wrap (int i, int lo, int hi) noexcept {
 }
 
 constexpr int mirror(int i, int m) noexcept {
-        // assert: m > 0
-        const bool odd = (i / m) % 2;
-        const bool mirr = (i>=0) ? odd : !odd;
-        const auto wrapped = wrap(i, m-1);
-        return mirr ? m-wrapped : wrapped;
+        // Reflects at 0 and m without repeating them: the pattern
+        // 0, 1, .., m-1, m, m-1, .., 1 has period 2m.
+        if (m <= 0)
+                return 0;
+        const int r = wrap(i, 2*m - 1);
+        return r <= m ? r : 2*m - r;
 }
 
 constexpr int mirror(int i, int lo, int hi) noexcept {
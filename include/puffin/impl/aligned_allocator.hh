@@ -0,0 +1,69 @@
+#ifndef ALIGNED_ALLOCATOR_HH_INCLUDED_20261018
+#define ALIGNED_ALLOCATOR_HH_INCLUDED_20261018
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace puffin { namespace impl {
+
+// Standard allocator whose allocations start at a multiple of Alignment
+// bytes. Alignment must be a power of two.
+//
+// The raw block is over-allocated by Alignment bytes; the pointer returned
+// by ::operator new is stored right before the aligned address.
+template <typename T, std::size_t Alignment>
+class aligned_allocator {
+        static_assert((Alignment & (Alignment - 1)) == 0,
+                      "Alignment must be a power of two");
+        static_assert(Alignment >= sizeof(void*),
+                      "Alignment must be able to hold a pointer");
+public:
+        using value_type = T;
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+
+        template <typename U>
+        struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+        static constexpr std::size_t alignment = Alignment;
+
+        aligned_allocator() noexcept = default;
+
+        template <typename U>
+        aligned_allocator(aligned_allocator<U, Alignment> const &) noexcept {}
+
+        T* allocate(std::size_t n) {
+                if (n > (~std::size_t(0) - Alignment) / sizeof(T))
+                        throw std::bad_alloc();
+                void *raw = ::operator new(n * sizeof(T) + Alignment);
+                const auto addr = reinterpret_cast<std::uintptr_t>(raw);
+                // At least sizeof(void*) bytes remain in front of the
+                // aligned address, because raw is itself pointer-aligned.
+                const auto aligned = (addr + Alignment) & ~(Alignment - 1);
+                void **p = reinterpret_cast<void**>(aligned);
+                p[-1] = raw;
+                return reinterpret_cast<T*>(p);
+        }
+
+        void deallocate(T *p, std::size_t) noexcept {
+                if (p)
+                        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+        }
+};
+
+template <typename T, typename U, std::size_t A>
+inline bool operator== (aligned_allocator<T, A> const &,
+                        aligned_allocator<U, A> const &) noexcept {
+        return true;
+}
+
+template <typename T, typename U, std::size_t A>
+inline bool operator!= (aligned_allocator<T, A> const &,
+                        aligned_allocator<U, A> const &) noexcept {
+        return false;
+}
+
+} }
+
+#endif //ALIGNED_ALLOCATOR_HH_INCLUDED_20261018
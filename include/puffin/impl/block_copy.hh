@@ -0,0 +1,111 @@
+#ifndef BLOCK_COPY_HH_INCLUDED_20261018
+#define BLOCK_COPY_HH_INCLUDED_20261018
+
+#include "type_traits.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace puffin { namespace impl {
+
+// Copies and fills of pixel ranges. For bitwise copyable T they become
+// memcpy/memmove/memset, which the C library implements with the widest
+// loads and stores available and which, unlike loops over T, do not
+// depend on the optimizer recognizing the idiom.
+
+// -- copy_n, move_n -----------------------------------------------------------
+// copy_n: [src, src+n) and [dst, dst+n) must not overlap.
+template <typename T>
+inline void copy_n(T const *src, std::size_t n, T *dst, true_type) {
+        if (n != 0)
+                std::memcpy(dst, src, n * sizeof(T));
+}
+
+template <typename T>
+inline void copy_n(T const *src, std::size_t n, T *dst, false_type) {
+        std::copy(src, src + n, dst);
+}
+
+template <typename T>
+inline void copy_n(T const *src, std::size_t n, T *dst) {
+        copy_n(src, n, dst, bool_constant<is_bitwise_copyable<T>::value>());
+}
+
+// move_n: the ranges may overlap.
+template <typename T>
+inline void move_n(T const *src, std::size_t n, T *dst, true_type) {
+        if (n != 0)
+                std::memmove(dst, src, n * sizeof(T));
+}
+
+template <typename T>
+inline void move_n(T const *src, std::size_t n, T *dst, false_type) {
+        if (dst < src)
+                std::copy(src, src + n, dst);
+        else
+                std::copy_backward(src, src + n, dst + n);
+}
+
+template <typename T>
+inline void move_n(T const *src, std::size_t n, T *dst) {
+        move_n(src, n, dst, bool_constant<is_bitwise_copyable<T>::value>());
+}
+
+// -- fill_n -------------------------------------------------------------------
+// Values whose bytes are all equal (black, transparent, opaque white, ...)
+// are memset. Other values are written once and replicated with memcpy,
+// doubling up to a block, which then stays in L1 while it is copied on.
+constexpr std::size_t fill_block_bytes = 4096;
+
+template <typename T>
+inline void fill_n(T *dst, std::size_t n, T const &val, true_type) {
+        if (n == 0)
+                return;
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &val, sizeof(T));
+        if (std::count(bytes, bytes + sizeof(T), bytes[0]) == sizeof(T)) {
+                std::memset(static_cast<void*>(dst), bytes[0], n * sizeof(T));
+                return;
+        }
+        const std::size_t block = std::max<std::size_t>(
+                1, fill_block_bytes / sizeof(T));
+        dst[0] = val;
+        std::size_t done = 1;
+        for (; done < n && done < block; done *= 2)
+                std::memcpy(dst + done, dst,
+                            std::min(done, n - done) * sizeof(T));
+        for (; done < n; done += block)
+                std::memcpy(dst + done, dst,
+                            std::min(block, n - done) * sizeof(T));
+}
+
+template <typename T>
+inline void fill_n(T *dst, std::size_t n, T const &val, false_type) {
+        std::fill(dst, dst + n, val);
+}
+
+template <typename T>
+inline void fill_n(T *dst, std::size_t n, T const &val) {
+        fill_n(dst, n, val, bool_constant<is_bitwise_copyable<T>::value>());
+}
+
+// -- copy_rows ----------------------------------------------------------------
+// Copies h rows of w elements. Strides are in elements; when both equal w,
+// the rows form one block and are copied at once.
+template <typename T>
+inline void copy_rows(
+        T const *src, std::size_t srcStride,
+        T *dst, std::size_t dstStride,
+        std::size_t w, std::size_t h
+) {
+        if (srcStride == w && dstStride == w) {
+                copy_n(src, w * h, dst);
+                return;
+        }
+        for (std::size_t y=0; y!=h; ++y)
+                copy_n(src + y*srcStride, w, dst + y*dstStride);
+}
+
+} }
+
+#endif //BLOCK_COPY_HH_INCLUDED_20261018
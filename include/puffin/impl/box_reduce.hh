@@ -0,0 +1,184 @@
+#ifndef BOX_REDUCE_HH_INCLUDED_20261018
+#define BOX_REDUCE_HH_INCLUDED_20261018
+
+#include "../color.hh"
+#include "compiler.hh"
+#include "srgb.hh"
+#include <cstdint>
+#include <type_traits>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin { namespace impl {
+
+// box_reduce_row(r0, r1, dst, n) halves two rows into one:
+//
+//   dst[x] = average of r0[2x], r0[2x+1], r1[2x], r1[2x+1]  for x < n.
+//
+// Integer channels are rounded to nearest, ties up, i.e. (sum + 2) / 4.
+// Color32 and Color64, in either channel order, are reduced 4 (8 bit) or
+// 2 (16 bit) output pixels at a time with SSE2: the channels are widened,
+// the rows added, adjacent pixels added by unpacking the 64 bit halves
+// against each other, and the sums narrowed again. The results equal the
+// scalar ones.
+//
+// box_reduce_row_srgb() averages the colour channels of unsigned integer
+// basic_rgba pixels as sRGB encoded values, i.e. in linear light, through
+// srgb_table. Alpha is averaged as is. Other types are averaged as by
+// box_reduce_row().
+
+// -- scalar -------------------------------------------------------------------
+template <typename S>
+inline auto box4(S a, S b, S c, S d)
+        -> typename std::enable_if<std::is_integral<S>::value, S>::type
+{
+        using wide = typename std::conditional<
+                std::is_signed<S>::value, int64_t, uint64_t>::type;
+        return S((wide(a) + b + c + d + 2) >> 2);
+}
+
+template <typename S>
+inline auto box4(S a, S b, S c, S d)
+        -> typename std::enable_if<std::is_floating_point<S>::value, S>::type
+{
+        return S((a + b + c + d) * S(0.25));
+}
+
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> box4(basic_rgba<R, G, B, A, O> const &a,
+                                      basic_rgba<R, G, B, A, O> const &b,
+                                      basic_rgba<R, G, B, A, O> const &c,
+                                      basic_rgba<R, G, B, A, O> const &d) {
+        return basic_rgba<R, G, B, A, O>(box4(a.r(), b.r(), c.r(), d.r()),
+                                         box4(a.g(), b.g(), c.g(), d.g()),
+                                         box4(a.b(), b.b(), c.b(), d.b()),
+                                         box4(a.a(), b.a(), c.a(), d.a()));
+}
+
+template <typename T>
+inline void box_reduce_row_scalar(T const *r0, T const *r1, T *dst, int n) {
+        for (int x=0; x!=n; ++x)
+                dst[x] = box4(r0[2*x], r0[2*x+1], r1[2*x], r1[2*x+1]);
+}
+
+template <typename T>
+inline void box_reduce_row(T const *r0, T const *r1, T *dst, int n) {
+        box_reduce_row_scalar(r0, r1, dst, n);
+}
+
+// -- SSE2 ---------------------------------------------------------------------
+#if PUFFIN_HAS_SSE2
+template <typename O>
+inline void box_reduce_row(
+        basic_rgba<uint8_t, uint8_t, uint8_t, uint8_t, O> const *r0,
+        basic_rgba<uint8_t, uint8_t, uint8_t, uint8_t, O> const *r1,
+        basic_rgba<uint8_t, uint8_t, uint8_t, uint8_t, O> *dst,
+        int n
+) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        // Channel sums of the two 2x2 blocks in 4 pixels of a and b, as
+        // 8 uint16.
+        const auto sum2 = [&] (__m128i a, __m128i b) {
+                const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                                 _mm_unpacklo_epi8(b, zero));
+                const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                                 _mm_unpackhi_epi8(b, zero));
+                return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi),
+                                     _mm_unpackhi_epi64(lo, hi));
+        };
+        int x = 0;
+        for (; x+4 <= n; x+=4) {
+                __m128i const *p0 = reinterpret_cast<__m128i const*>(r0 + 2*x);
+                __m128i const *p1 = reinterpret_cast<__m128i const*>(r1 + 2*x);
+                const __m128i s0 = sum2(_mm_loadu_si128(p0),
+                                        _mm_loadu_si128(p1));
+                const __m128i s1 = sum2(_mm_loadu_si128(p0 + 1),
+                                        _mm_loadu_si128(p1 + 1));
+                _mm_storeu_si128(
+                        reinterpret_cast<__m128i*>(dst + x),
+                        _mm_packus_epi16(
+                                _mm_srli_epi16(_mm_add_epi16(s0, two), 2),
+                                _mm_srli_epi16(_mm_add_epi16(s1, two), 2)));
+        }
+        box_reduce_row_scalar(r0 + 2*x, r1 + 2*x, dst + x, n - x);
+}
+
+template <typename O>
+inline void box_reduce_row(
+        basic_rgba<uint16_t, uint16_t, uint16_t, uint16_t, O> const *r0,
+        basic_rgba<uint16_t, uint16_t, uint16_t, uint16_t, O> const *r1,
+        basic_rgba<uint16_t, uint16_t, uint16_t, uint16_t, O> *dst,
+        int n
+) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi32(2);
+        // Rounded average of the 2x2 block in 2 pixels of a and b, as
+        // 4 int32.
+        const auto avg4 = [&] (__m128i a, __m128i b) {
+                const __m128i lo = _mm_add_epi32(_mm_unpacklo_epi16(a, zero),
+                                                 _mm_unpacklo_epi16(b, zero));
+                const __m128i hi = _mm_add_epi32(_mm_unpackhi_epi16(a, zero),
+                                                 _mm_unpackhi_epi16(b, zero));
+                return _mm_srli_epi32(
+                        _mm_add_epi32(_mm_add_epi32(lo, hi), two), 2);
+        };
+        // Packs int32 in [0, 65535] to uint16 (SSE2 lacks packus_epi32).
+        const __m128i bias32 = _mm_set1_epi32(32768);
+        const __m128i bias16 = _mm_set1_epi16(-32768);
+        int x = 0;
+        for (; x+2 <= n; x+=2) {
+                __m128i const *p0 = reinterpret_cast<__m128i const*>(r0 + 2*x);
+                __m128i const *p1 = reinterpret_cast<__m128i const*>(r1 + 2*x);
+                const __m128i q0 = avg4(_mm_loadu_si128(p0),
+                                        _mm_loadu_si128(p1));
+                const __m128i q1 = avg4(_mm_loadu_si128(p0 + 1),
+                                        _mm_loadu_si128(p1 + 1));
+                _mm_storeu_si128(
+                        reinterpret_cast<__m128i*>(dst + x),
+                        _mm_add_epi16(
+                                _mm_packs_epi32(_mm_sub_epi32(q0, bias32),
+                                                _mm_sub_epi32(q1, bias32)),
+                                bias16));
+        }
+        box_reduce_row_scalar(r0 + 2*x, r1 + 2*x, dst + x, n - x);
+}
+#endif
+
+// -- sRGB ---------------------------------------------------------------------
+template <typename T>
+inline void box_reduce_row_srgb(T const *r0, T const *r1, T *dst, int n) {
+        box_reduce_row(r0, r1, dst, n);
+}
+
+template <typename S, typename A, typename O>
+inline auto box_reduce_row_srgb(
+        basic_rgba<S, S, S, A, O> const *r0,
+        basic_rgba<S, S, S, A, O> const *r1,
+        basic_rgba<S, S, S, A, O> *dst,
+        int n
+) -> typename std::enable_if<std::is_integral<S>::value &&
+                             std::is_unsigned<S>::value &&
+                             sizeof(S) <= 2>::type
+{
+        srgb_table<S> const &t = srgb_table<S>::get();
+        const auto channel = [&t] (S a, S b, S c, S d) {
+                return t.encode((t.decode(a) + t.decode(b) +
+                                 t.decode(c) + t.decode(d)) * 0.25f);
+        };
+        for (int x=0; x!=n; ++x) {
+                auto const &a = r0[2*x], &b = r0[2*x+1],
+                           &c = r1[2*x], &d = r1[2*x+1];
+                dst[x] = basic_rgba<S, S, S, A, O>(
+                        channel(a.r(), b.r(), c.r(), d.r()),
+                        channel(a.g(), b.g(), c.g(), d.g()),
+                        channel(a.b(), b.b(), c.b(), d.b()),
+                        box4(a.a(), b.a(), c.a(), d.a()));
+        }
+}
+
+} }
+
+#endif //BOX_REDUCE_HH_INCLUDED_20261018
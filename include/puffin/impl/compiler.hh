@@ -8,4 +8,28 @@
 #define PUFFIN_CONSTEXPR
 #define PUFFIN_NOEXCEPT
 
+// Instruction sets the translation unit is compiled for (e.g. through
+// -march=native). Kernels select on these at compile time.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PUFFIN_HAS_SSE2 true
+#else
+#define PUFFIN_HAS_SSE2 false
+#endif
+
+#if defined(__AVX2__)
+#define PUFFIN_HAS_AVX2 true
+#else
+#define PUFFIN_HAS_AVX2 false
+#endif
+
+// Byte order of the target. Code that stores packed pixel integers as
+// pixels of a given channel order (e.g. Color32Bgra) selects on this.
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || \
+    defined(_WIN32)
+#define PUFFIN_LITTLE_ENDIAN true
+#else
+#define PUFFIN_LITTLE_ENDIAN false
+#endif
+
 #endif // COMPILER_HH_INCLUDED_20181221
@@ -35,6 +35,16 @@ inline T greater_or_equal(T value, T min) {
                 "must be greater than or equal " + to_string(min));
 }
 
+template <typename T>
+inline T equal_to(T value, T expected) {
+        if (value == expected)
+                return value;
+        using std::to_string;
+        throw std::invalid_argument(
+                "value (==" + to_string(value) + ") " +
+                "must be equal to " + to_string(expected));
+}
+
 template <typename T>
 inline T less_than(T value, T max) {
         if (value < max)
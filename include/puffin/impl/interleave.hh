@@ -0,0 +1,195 @@
+#ifndef INTERLEAVE_HH_INCLUDED_20261018
+#define INTERLEAVE_HH_INCLUDED_20261018
+
+#include "compiler.hh"
+#include <cstdint>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin { namespace impl {
+
+// Conversion between n interleaved 4-channel samples (c0 c1 c2 c3 c0 ...)
+// and four separate channel rows, for 8 and 16 bit channels.
+//
+// The SSE2 paths only use unpack instructions: a few rounds of unpacking
+// sort 16 (8 bit) or 8 (16 bit) pixels into channel order, and unpacking
+// the channel rows against each other restores the pixels.
+
+// -- scalar -------------------------------------------------------------------
+template <typename S>
+inline void deinterleave4_scalar(
+        S const *src, S *d0, S *d1, S *d2, S *d3, int n
+) {
+        for (int i=0; i!=n; ++i) {
+                d0[i] = src[4*i    ];
+                d1[i] = src[4*i + 1];
+                d2[i] = src[4*i + 2];
+                d3[i] = src[4*i + 3];
+        }
+}
+
+template <typename S>
+inline void interleave4_scalar(
+        S const *s0, S const *s1, S const *s2, S const *s3, S *dst, int n
+) {
+        for (int i=0; i!=n; ++i) {
+                dst[4*i    ] = s0[i];
+                dst[4*i + 1] = s1[i];
+                dst[4*i + 2] = s2[i];
+                dst[4*i + 3] = s3[i];
+        }
+}
+
+// -- 8 bit --------------------------------------------------------------------
+inline void deinterleave4(
+        uint8_t const *src,
+        uint8_t *d0, uint8_t *d1, uint8_t *d2, uint8_t *d3,
+        int n
+) {
+        int i = 0;
+#if PUFFIN_HAS_SSE2
+        for (; i+16 <= n; i+=16) {
+                __m128i const *s = reinterpret_cast<__m128i const*>(src + 4*i);
+                const __m128i a = _mm_loadu_si128(s    ); // pixels  0.. 3
+                const __m128i b = _mm_loadu_si128(s + 1); // pixels  4.. 7
+                const __m128i c = _mm_loadu_si128(s + 2); // pixels  8..11
+                const __m128i d = _mm_loadu_si128(s + 3); // pixels 12..15
+
+                // Pixels (0,4) (1,5) | (2,6) (3,7), per channel.
+                const __m128i t0 = _mm_unpacklo_epi8(a, b);
+                const __m128i t1 = _mm_unpackhi_epi8(a, b);
+                const __m128i t2 = _mm_unpacklo_epi8(c, d);
+                const __m128i t3 = _mm_unpackhi_epi8(c, d);
+                // c0: 0 2 4 6, c1: 0 2 4 6, ... | c0: 1 3 5 7, ...
+                const __m128i u0 = _mm_unpacklo_epi8(t0, t1);
+                const __m128i u1 = _mm_unpackhi_epi8(t0, t1);
+                const __m128i u2 = _mm_unpacklo_epi8(t2, t3);
+                const __m128i u3 = _mm_unpackhi_epi8(t2, t3);
+                // v: pixels 0..7, w: pixels 8..15, as c0 c1 | c2 c3.
+                const __m128i v0 = _mm_unpacklo_epi8(u0, u1);
+                const __m128i v1 = _mm_unpackhi_epi8(u0, u1);
+                const __m128i w0 = _mm_unpacklo_epi8(u2, u3);
+                const __m128i w1 = _mm_unpackhi_epi8(u2, u3);
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d0 + i),
+                                 _mm_unpacklo_epi64(v0, w0));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d1 + i),
+                                 _mm_unpackhi_epi64(v0, w0));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d2 + i),
+                                 _mm_unpacklo_epi64(v1, w1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d3 + i),
+                                 _mm_unpackhi_epi64(v1, w1));
+        }
+#endif
+        deinterleave4_scalar(src + 4*i, d0 + i, d1 + i, d2 + i, d3 + i, n - i);
+}
+
+inline void interleave4(
+        uint8_t const *s0, uint8_t const *s1,
+        uint8_t const *s2, uint8_t const *s3,
+        uint8_t *dst,
+        int n
+) {
+        int i = 0;
+#if PUFFIN_HAS_SSE2
+        for (; i+16 <= n; i+=16) {
+                const __m128i c0 = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(s0 + i));
+                const __m128i c1 = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(s1 + i));
+                const __m128i c2 = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(s2 + i));
+                const __m128i c3 = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(s3 + i));
+
+                const __m128i x0 = _mm_unpacklo_epi8(c0, c1);
+                const __m128i x1 = _mm_unpackhi_epi8(c0, c1);
+                const __m128i y0 = _mm_unpacklo_epi8(c2, c3);
+                const __m128i y1 = _mm_unpackhi_epi8(c2, c3);
+
+                __m128i *d = reinterpret_cast<__m128i*>(dst + 4*i);
+                _mm_storeu_si128(d    , _mm_unpacklo_epi16(x0, y0));
+                _mm_storeu_si128(d + 1, _mm_unpackhi_epi16(x0, y0));
+                _mm_storeu_si128(d + 2, _mm_unpacklo_epi16(x1, y1));
+                _mm_storeu_si128(d + 3, _mm_unpackhi_epi16(x1, y1));
+        }
+#endif
+        interleave4_scalar(s0 + i, s1 + i, s2 + i, s3 + i, dst + 4*i, n - i);
+}
+
+// -- 16 bit -------------------------------------------------------------------
+inline void deinterleave4(
+        uint16_t const *src,
+        uint16_t *d0, uint16_t *d1, uint16_t *d2, uint16_t *d3,
+        int n
+) {
+        int i = 0;
+#if PUFFIN_HAS_SSE2
+        for (; i+8 <= n; i+=8) {
+                __m128i const *s = reinterpret_cast<__m128i const*>(src + 4*i);
+                const __m128i a = _mm_loadu_si128(s    ); // pixels 0, 1
+                const __m128i b = _mm_loadu_si128(s + 1); // pixels 2, 3
+                const __m128i c = _mm_loadu_si128(s + 2); // pixels 4, 5
+                const __m128i d = _mm_loadu_si128(s + 3); // pixels 6, 7
+
+                const __m128i t0 = _mm_unpacklo_epi16(a, b);
+                const __m128i t1 = _mm_unpackhi_epi16(a, b);
+                const __m128i t2 = _mm_unpacklo_epi16(c, d);
+                const __m128i t3 = _mm_unpackhi_epi16(c, d);
+                // c0: 0..3, c1: 0..3 | c2: 0..3, c3: 0..3
+                const __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+                const __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+                const __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+                const __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d0 + i),
+                                 _mm_unpacklo_epi64(u0, u2));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d1 + i),
+                                 _mm_unpackhi_epi64(u0, u2));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d2 + i),
+                                 _mm_unpacklo_epi64(u1, u3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d3 + i),
+                                 _mm_unpackhi_epi64(u1, u3));
+        }
+#endif
+        deinterleave4_scalar(src + 4*i, d0 + i, d1 + i, d2 + i, d3 + i, n - i);
+}
+
+inline void interleave4(
+        uint16_t const *s0, uint16_t const *s1,
+        uint16_t const *s2, uint16_t const *s3,
+        uint16_t *dst,
+        int n
+) {
+        int i = 0;
+#if PUFFIN_HAS_SSE2
+        for (; i+8 <= n; i+=8) {
+                const __m128i c0 = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(s0 + i));
+                const __m128i c1 = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(s1 + i));
+                const __m128i c2 = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(s2 + i));
+                const __m128i c3 = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(s3 + i));
+
+                const __m128i x0 = _mm_unpacklo_epi16(c0, c1);
+                const __m128i x1 = _mm_unpackhi_epi16(c0, c1);
+                const __m128i y0 = _mm_unpacklo_epi16(c2, c3);
+                const __m128i y1 = _mm_unpackhi_epi16(c2, c3);
+
+                __m128i *d = reinterpret_cast<__m128i*>(dst + 4*i);
+                _mm_storeu_si128(d    , _mm_unpacklo_epi32(x0, y0));
+                _mm_storeu_si128(d + 1, _mm_unpackhi_epi32(x0, y0));
+                _mm_storeu_si128(d + 2, _mm_unpacklo_epi32(x1, y1));
+                _mm_storeu_si128(d + 3, _mm_unpackhi_epi32(x1, y1));
+        }
+#endif
+        interleave4_scalar(s0 + i, s1 + i, s2 + i, s3 + i, dst + 4*i, n - i);
+}
+
+} }
+
+#endif //INTERLEAVE_HH_INCLUDED_20261018
@@ -0,0 +1,403 @@
+#ifndef RESAMPLE_HH_INCLUDED_20261018
+#define RESAMPLE_HH_INCLUDED_20261018
+
+#include "../color.hh"
+#include "../color_ops.hh"
+#include "compiler.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin { namespace impl {
+
+// Resampling of rows and columns with precomputed weights, see resize.hh.
+//
+// resample_weights holds, for each of dst output positions along an axis,
+// the first source position and the count of the source positions it
+// reads, and their weights. The weights of a position sum to 1 (in fixed
+// point, to exactly 1 << resample_bits).
+//
+// resample_row() computes a row of output pixels from one source row
+// (horizontal pass), resample_column() a row of output pixels from count
+// source rows (vertical pass). Color32 (either channel order) is computed in
+// fixed point with 14 bit signed weights, two taps per _mm_madd_epi16;
+// Color64 in single precision. Both round to nearest and clamp. Other
+// basic_rgba pixels are computed per channel in double precision.
+
+constexpr int resample_bits = 14;
+
+struct resample_weights {
+        int taps = 0;                  // weights per position, stride of real
+        std::vector<int> first, count; // source positions read
+        std::vector<float> real;       // dst * taps
+        std::vector<int16_t> fixed;    // dst * taps, scaled by 1<<resample_bits
+
+        float const *real_at(int i) const { return &real[i * taps]; }
+        int16_t const *fixed_at(int i) const { return &fixed[i * taps]; }
+};
+
+// Weights for resampling src positions to dst with kernel(x), which is zero
+// outside [-support, support]. Position i of dst is centred on source
+// coordinate (i + 0.5) * src/dst. On downscaling, the kernel is widened by
+// src/dst so that it covers every source position. Taps outside [0, src)
+// are dropped and the remaining ones renormalized.
+template <typename Kernel>
+inline resample_weights make_resample_weights(
+        int src, int dst,
+        double support,
+        Kernel kernel
+) {
+        const double scale = double(src) / dst;
+        const double filter_scale = std::max(scale, 1.0);
+        support *= filter_scale;
+
+        resample_weights w;
+        w.taps = static_cast<int>(std::ceil(support)) * 2 + 1;
+        w.first.resize(dst);
+        w.count.resize(dst);
+        w.real.assign(std::size_t(dst) * w.taps, 0.f);
+        // Padded, so that SIMD kernels can load 8 weights from any
+        // position.
+        w.fixed.assign(std::size_t(dst) * w.taps + 8, 0);
+
+        std::vector<double> k(w.taps);
+        for (int i=0; i!=dst; ++i) {
+                const double centre = (i + 0.5) * scale;
+                const int lo = std::max(
+                        static_cast<int>(centre - support + 0.5), 0);
+                const int hi = std::min(
+                        static_cast<int>(centre + support + 0.5), src);
+                const int n = std::min(std::max(hi - lo, 1), w.taps);
+                double sum = 0;
+                for (int t=0; t!=n; ++t) {
+                        k[t] = kernel((lo + t - centre + 0.5) / filter_scale);
+                        sum += k[t];
+                }
+                if (sum == 0) { // e.g. a box narrower than a pixel
+                        k[0] = sum = 1;
+                        std::fill(k.begin() + 1, k.begin() + n, 0.0);
+                }
+
+                w.first[i] = std::min(lo, src - n);
+                w.count[i] = n;
+                float *real = &w.real[std::size_t(i) * w.taps];
+                int16_t *fixed = &w.fixed[std::size_t(i) * w.taps];
+                // Round each weight, then move the error of the sum onto
+                // the largest weight.
+                int fixed_sum = 0, largest = 0;
+                for (int t=0; t!=n; ++t) {
+                        const double v = k[t] / sum;
+                        real[t] = static_cast<float>(v);
+                        fixed[t] = static_cast<int16_t>(
+                                std::lround(v * (1 << resample_bits)));
+                        fixed_sum += fixed[t];
+                        if (std::abs(fixed[t]) > std::abs(fixed[largest]))
+                                largest = t;
+                }
+                fixed[largest] = static_cast<int16_t>(
+                        fixed[largest] + (1 << resample_bits) - fixed_sum);
+        }
+        return w;
+}
+
+// -- generic ------------------------------------------------------------------
+template <typename S>
+inline auto resample_channel(double v)
+        -> typename std::enable_if<std::is_integral<S>::value, S>::type
+{
+        return channel_arith<S>::from_real(
+                static_cast<typename channel_arith<S>::real>(v));
+}
+
+template <typename S>
+inline auto resample_channel(double v)
+        -> typename std::enable_if<std::is_floating_point<S>::value, S>::type
+{
+        return static_cast<S>(v);
+}
+
+// The sum of *px[k] * weights[k] for k < n.
+template <typename R, typename G, typename B, typename A, typename O>
+inline basic_rgba<R, G, B, A, O> resample_px(
+        basic_rgba<R, G, B, A, O> const *const *px,
+        float const *weights, int n
+) {
+        double r = 0, g = 0, b = 0, a = 0;
+        for (int k=0; k!=n; ++k) {
+                const double w = weights[k];
+                r += px[k]->r() * w;
+                g += px[k]->g() * w;
+                b += px[k]->b() * w;
+                a += px[k]->a() * w;
+        }
+        return basic_rgba<R, G, B, A, O>(resample_channel<R>(r),
+                                         resample_channel<G>(g),
+                                         resample_channel<B>(b),
+                                         resample_channel<A>(a));
+}
+
+template <typename T>
+inline void resample_row(T const *src, T *dst, int n,
+                         resample_weights const &w) {
+        std::vector<T const*> px(w.taps);
+        for (int x=0; x!=n; ++x) {
+                for (int k=0; k!=w.count[x]; ++k)
+                        px[k] = src + w.first[x] + k;
+                dst[x] = resample_px(px.data(), w.real_at(x), w.count[x]);
+        }
+}
+
+template <typename T>
+inline void resample_column(T const *const *rows, int count,
+                            float const *weights, int16_t const *,
+                            T *dst, int n) {
+        std::vector<T const*> px(count);
+        for (int x=0; x!=n; ++x) {
+                for (int k=0; k!=count; ++k)
+                        px[k] = rows[k] + x;
+                dst[x] = resample_px(px.data(), weights, count);
+        }
+}
+
+// -- Color32 ------------------------------------------------------------------
+// Two 16 bit weights as the pair (lo, hi) of one int32.
+inline int32_t resample_pair(int16_t lo, int16_t hi) {
+        return int32_t(uint32_t(uint16_t(lo)) | uint32_t(uint16_t(hi)) << 16);
+}
+
+inline uint8_t resample_round8(int32_t acc) {
+        const int32_t v = (acc + (1 << (resample_bits - 1))) >> resample_bits;
+        return uint8_t(std::min(std::max(v, 0), 255));
+}
+
+#if PUFFIN_HAS_SSE2
+// Rounds 4 int32 channel sums to one rgba8 pixel.
+inline int32_t resample_pack8(__m128i acc) {
+        const __m128i v = _mm_srai_epi32(
+                _mm_add_epi32(acc, _mm_set1_epi32(1 << (resample_bits - 1))),
+                resample_bits);
+        const __m128i w = _mm_packs_epi32(v, v);
+        return _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+}
+#endif
+
+template <typename O>
+inline void resample_row(rgba8<O> const *src, rgba8<O> *dst, int n,
+                         resample_weights const &w) {
+        for (int x=0; x!=n; ++x) {
+                uint8_t const *s = reinterpret_cast<uint8_t const*>(
+                        src + w.first[x]);
+                int16_t const *k = w.fixed_at(x);
+                const int count = w.count[x];
+                int t = 0;
+#if PUFFIN_HAS_SSE2
+                const __m128i zero = _mm_setzero_si128();
+                // (channel of tap t, same channel of tap t+1) per 16 bit
+                // pair, for the two pixels in the low half of p.
+                const auto pairs = [] (__m128i p) {
+                        return _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+                };
+                // Four taps of p, with their weights in the low or high
+                // half of wv.
+                const auto madd4 = [&] (__m128i p, __m128i w01,
+                                        __m128i w23) {
+                        return _mm_add_epi32(
+                                _mm_madd_epi16(
+                                        pairs(_mm_unpacklo_epi8(p, zero)),
+                                        w01),
+                                _mm_madd_epi16(
+                                        pairs(_mm_unpackhi_epi8(p, zero)),
+                                        w23));
+                };
+                __m128i acc = zero, acc2 = zero;
+                for (; t+8 <= count; t+=8) {
+                        const __m128i wv = _mm_loadu_si128(
+                                reinterpret_cast<__m128i const*>(k + t));
+                        acc = _mm_add_epi32(acc, madd4(
+                                _mm_loadu_si128(reinterpret_cast<
+                                        __m128i const*>(s + 4*t)),
+                                _mm_shuffle_epi32(wv, 0x00),
+                                _mm_shuffle_epi32(wv, 0x55)));
+                        acc2 = _mm_add_epi32(acc2, madd4(
+                                _mm_loadu_si128(reinterpret_cast<
+                                        __m128i const*>(s + 4*t + 16)),
+                                _mm_shuffle_epi32(wv, 0xAA),
+                                _mm_shuffle_epi32(wv, 0xFF)));
+                }
+                if (t+4 <= count) {
+                        const __m128i wv = _mm_loadl_epi64(
+                                reinterpret_cast<__m128i const*>(k + t));
+                        acc2 = _mm_add_epi32(acc2, madd4(
+                                _mm_loadu_si128(reinterpret_cast<
+                                        __m128i const*>(s + 4*t)),
+                                _mm_shuffle_epi32(wv, 0x00),
+                                _mm_shuffle_epi32(wv, 0x55)));
+                        t += 4;
+                }
+                acc = _mm_add_epi32(acc, acc2);
+                for (; t+2 <= count; t+=2) {
+                        const __m128i p = _mm_loadl_epi64(
+                                reinterpret_cast<__m128i const*>(s + 4*t));
+                        acc = _mm_add_epi32(acc, _mm_madd_epi16(
+                                pairs(_mm_unpacklo_epi8(p, zero)),
+                                _mm_set1_epi32(resample_pair(k[t], k[t+1]))));
+                }
+                if (t < count) {
+                        int32_t bits;
+                        std::memcpy(&bits, s + 4*t, 4);
+                        const __m128i p = _mm_unpacklo_epi16(
+                                _mm_unpacklo_epi8(_mm_cvtsi32_si128(bits),
+                                                  zero),
+                                zero);
+                        acc = _mm_add_epi32(acc, _mm_madd_epi16(
+                                p, _mm_set1_epi32(resample_pair(k[t], 0))));
+                }
+                const int32_t bits = resample_pack8(acc);
+                std::memcpy(static_cast<void*>(dst + x), &bits, 4);
+#else
+                int32_t acc[4] = {0, 0, 0, 0};
+                for (; t!=count; ++t)
+                        for (int c=0; c!=4; ++c)
+                                acc[c] += s[4*t + c] * k[t];
+                uint8_t *d = reinterpret_cast<uint8_t*>(dst + x);
+                for (int c=0; c!=4; ++c)
+                        d[c] = resample_round8(acc[c]);
+#endif
+        }
+}
+
+template <typename O>
+inline void resample_column(rgba8<O> const *const *rows, int count,
+                            float const *, int16_t const *k,
+                            rgba8<O> *dst, int n) {
+        int x = 0;
+#if PUFFIN_HAS_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; x+4 <= n; x+=4) {
+                __m128i acc[4] = {zero, zero, zero, zero};
+                // (row t, row t+1) pairs of each channel of 4 pixels.
+                const auto add = [&] (__m128i a, __m128i b, int32_t pair) {
+                        const __m128i w = _mm_set1_epi32(pair);
+                        const __m128i alo = _mm_unpacklo_epi8(a, zero),
+                                      ahi = _mm_unpackhi_epi8(a, zero),
+                                      blo = _mm_unpacklo_epi8(b, zero),
+                                      bhi = _mm_unpackhi_epi8(b, zero);
+                        acc[0] = _mm_add_epi32(acc[0], _mm_madd_epi16(
+                                _mm_unpacklo_epi16(alo, blo), w));
+                        acc[1] = _mm_add_epi32(acc[1], _mm_madd_epi16(
+                                _mm_unpackhi_epi16(alo, blo), w));
+                        acc[2] = _mm_add_epi32(acc[2], _mm_madd_epi16(
+                                _mm_unpacklo_epi16(ahi, bhi), w));
+                        acc[3] = _mm_add_epi32(acc[3], _mm_madd_epi16(
+                                _mm_unpackhi_epi16(ahi, bhi), w));
+                };
+                int t = 0;
+                for (; t+2 <= count; t+=2)
+                        add(load_px(rows[t] + x), load_px(rows[t+1] + x),
+                            resample_pair(k[t], k[t+1]));
+                if (t < count)
+                        add(load_px(rows[t] + x), zero,
+                            resample_pair(k[t], 0));
+
+                const __m128i r = _mm_set1_epi32(1 << (resample_bits - 1));
+                for (auto &a : acc)
+                        a = _mm_srai_epi32(_mm_add_epi32(a, r), resample_bits);
+                store_px(dst + x, _mm_packus_epi16(
+                        _mm_packs_epi32(acc[0], acc[1]),
+                        _mm_packs_epi32(acc[2], acc[3])));
+        }
+#endif
+        for (; x!=n; ++x) {
+                int32_t acc[4] = {0, 0, 0, 0};
+                for (int t=0; t!=count; ++t) {
+                        uint8_t const *s =
+                                reinterpret_cast<uint8_t const*>(rows[t] + x);
+                        for (int c=0; c!=4; ++c)
+                                acc[c] += s[c] * k[t];
+                }
+                uint8_t *d = reinterpret_cast<uint8_t*>(dst + x);
+                for (int c=0; c!=4; ++c)
+                        d[c] = resample_round8(acc[c]);
+        }
+}
+
+// -- Color64 ------------------------------------------------------------------
+template <typename O>
+inline void resample_row(rgba16<O> const *src, rgba16<O> *dst, int n,
+                         resample_weights const &w) {
+        for (int x=0; x!=n; ++x) {
+                uint16_t const *s = reinterpret_cast<uint16_t const*>(
+                        src + w.first[x]);
+                float const *k = w.real_at(x);
+                const int count = w.count[x];
+#if PUFFIN_HAS_SSE2
+                const __m128i zero = _mm_setzero_si128();
+                __m128 acc = _mm_setzero_ps();
+                for (int t=0; t!=count; ++t) {
+                        const __m128 p = _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+                                _mm_loadl_epi64(reinterpret_cast<__m128i const*>(
+                                        s + 4*t)),
+                                zero));
+                        acc = _mm_add_ps(acc, _mm_mul_ps(p, _mm_set1_ps(k[t])));
+                }
+                const __m128i v = round_clamped(acc, 65535.f);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x),
+                                 packus_epi32_sse2(v, v));
+#else
+                float acc[4] = {0, 0, 0, 0};
+                for (int t=0; t!=count; ++t)
+                        for (int c=0; c!=4; ++c)
+                                acc[c] += s[4*t + c] * k[t];
+                uint16_t *d = reinterpret_cast<uint16_t*>(dst + x);
+                for (int c=0; c!=4; ++c)
+                        d[c] = channel_arith<uint16_t>::from_real(acc[c]);
+#endif
+        }
+}
+
+template <typename O>
+inline void resample_column(rgba16<O> const *const *rows, int count,
+                            float const *k, int16_t const *,
+                            rgba16<O> *dst, int n) {
+        int x = 0;
+#if PUFFIN_HAS_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; x+2 <= n; x+=2) {
+                __m128 lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+                for (int t=0; t!=count; ++t) {
+                        const __m128i p = load_px(rows[t] + x);
+                        const __m128 w = _mm_set1_ps(k[t]);
+                        lo = _mm_add_ps(lo, _mm_mul_ps(w, _mm_cvtepi32_ps(
+                                _mm_unpacklo_epi16(p, zero))));
+                        hi = _mm_add_ps(hi, _mm_mul_ps(w, _mm_cvtepi32_ps(
+                                _mm_unpackhi_epi16(p, zero))));
+                }
+                store_px(dst + x, packus_epi32_sse2(
+                        round_clamped(lo, 65535.f),
+                        round_clamped(hi, 65535.f)));
+        }
+#endif
+        for (; x!=n; ++x) {
+                float acc[4] = {0, 0, 0, 0};
+                for (int t=0; t!=count; ++t) {
+                        uint16_t const *s =
+                                reinterpret_cast<uint16_t const*>(rows[t] + x);
+                        for (int c=0; c!=4; ++c)
+                                acc[c] += s[c] * k[t];
+                }
+                uint16_t *d = reinterpret_cast<uint16_t*>(dst + x);
+                for (int c=0; c!=4; ++c)
+                        d[c] = channel_arith<uint16_t>::from_real(acc[c]);
+        }
+}
+
+} }
+
+#endif //RESAMPLE_HH_INCLUDED_20261018
@@ -0,0 +1,82 @@
+#ifndef REVERSE_HH_INCLUDED_20261018
+#define REVERSE_HH_INCLUDED_20261018
+
+#include "compiler.hh"
+#include "type_traits.hh"
+#include <utility>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+#if PUFFIN_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace puffin { namespace impl {
+
+// swap_reversed(a, b, n) exchanges a[i] with b[n-1-i] for all i < n; the
+// ranges must not overlap. With b = a + n - n/2 and n/2 elements it
+// reverses [a, a+n) in place, with two rows it mirrors them onto each
+// other (rotate180).
+//
+// 32-bit bitwise copyable elements are reversed in SIMD registers, the
+// rest element by element.
+
+template <typename T>
+inline void swap_reversed_scalar(T *a, T *b, int n) {
+        using std::swap;
+        T *pb = b + n;
+        for (int i=0; i!=n; ++i)
+                swap(a[i], *--pb);
+}
+
+template <typename T>
+inline void swap_reversed(T *a, T *b, int n, false_type) {
+        swap_reversed_scalar(a, b, n);
+}
+
+#if PUFFIN_HAS_SSE2
+template <typename T>
+inline void swap_reversed(T *a, T *b, int n, true_type) {
+        int i = 0;
+#if PUFFIN_HAS_AVX2
+        const __m256i rev = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        for (; i+8 <= n; i+=8) {
+                __m256i *pa = reinterpret_cast<__m256i*>(a + i);
+                __m256i *pb = reinterpret_cast<__m256i*>(b + n - i - 8);
+                const __m256i va = _mm256_loadu_si256(pa);
+                const __m256i vb = _mm256_loadu_si256(pb);
+                _mm256_storeu_si256(pa, _mm256_permutevar8x32_epi32(vb, rev));
+                _mm256_storeu_si256(pb, _mm256_permutevar8x32_epi32(va, rev));
+        }
+#endif
+        for (; i+4 <= n; i+=4) {
+                __m128i *pa = reinterpret_cast<__m128i*>(a + i);
+                __m128i *pb = reinterpret_cast<__m128i*>(b + n - i - 4);
+                const __m128i va = _mm_loadu_si128(pa);
+                const __m128i vb = _mm_loadu_si128(pb);
+                _mm_storeu_si128(pa, _mm_shuffle_epi32(vb, 0x1B));
+                _mm_storeu_si128(pb, _mm_shuffle_epi32(va, 0x1B));
+        }
+        swap_reversed_scalar(a + i, b, n - i);
+}
+#endif
+
+template <typename T>
+inline void swap_reversed(T *a, T *b, int n) {
+        typedef bool_constant<
+                PUFFIN_HAS_SSE2 &&
+                sizeof(T) == 4 &&
+                is_bitwise_copyable<T>::value
+        > use_kernel;
+        swap_reversed(a, b, n, use_kernel());
+}
+
+template <typename T>
+inline void reverse(T *first, int n) {
+        swap_reversed(first, first + (n - n/2), n/2);
+}
+
+} }
+
+#endif //REVERSE_HH_INCLUDED_20261018
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <stdexcept>
 #include "contract.hh"
+#include "../image.hh"
 
 namespace puffin { namespace impl {
 
@@ -89,6 +90,25 @@ public:
                 }
         }
 
+        // Uploads the overlapping region of src in one go. ARGB8888 is
+        // b, g, r, a in memory on little endian targets, i.e. Color32Bgra,
+        // so the rows are copied as they are.
+        void copy(base_image<Color32Bgra> const &src) {
+                static_assert(PUFFIN_LITTLE_ENDIAN,
+                              "ARGB8888 is only BGRA on little endian");
+                const SDL_Rect rect {0, 0,
+                                     std::min(width(), src.width()),
+                                     std::min(height(), src.height())};
+                const int pitch = static_cast<int>(src.stride() *
+                                                   sizeof(Color32Bgra));
+                SDL_Texture *tex = texture();
+                if (0 != SDL_UpdateTexture(tex, &rect, src.data(), pitch)) {
+                        throw std::runtime_error("Could not update SDL "
+                                                 "texture");
+                }
+                SDL_RenderCopy(renderer_.get(), tex, &rect, &rect);
+        }
+
         void present() {
                 SDL_RenderPresent(renderer_.get());
         }
@@ -126,6 +146,23 @@ private:
                 cont::less_or_equal(b, 255);
         }
 
+        // Streaming texture of the renderer's size, created on first use.
+        SDL_Texture* texture() {
+                if (!texture_) {
+                        SDL_Texture *tex = SDL_CreateTexture(
+                                renderer_.get(),
+                                SDL_PIXELFORMAT_ARGB8888,
+                                SDL_TEXTUREACCESS_STREAMING,
+                                width_, height_);
+                        if (!tex) {
+                                throw std::runtime_error("Could not create "
+                                                         "SDL texture");
+                        }
+                        texture_ = {tex, SDL_DestroyTexture};
+                }
+                return texture_.get();
+        }
+
         friend class Sdl;
 
         int width_, height_;
@@ -135,6 +172,10 @@ private:
 
         using WindowDeleter   = std::function<void(SDL_Window *)>;
         std::unique_ptr<SDL_Window, WindowDeleter> window_;
+
+        // Declared last, so that it is destroyed before the renderer.
+        using TextureDeleter  = std::function<void(SDL_Texture *)>;
+        std::unique_ptr<SDL_Texture, TextureDeleter> texture_;
 };
 
 
@@ -0,0 +1,112 @@
+#ifndef SRGB_HH_INCLUDED_20261018
+#define SRGB_HH_INCLUDED_20261018
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace puffin { namespace impl {
+
+// The sRGB transfer function (IEC 61966-2-1) on values in [0, 1].
+inline float srgb_to_linear(float v) {
+        return v <= 0.04045f ? v / 12.92f
+                             : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linear_to_srgb(float v) {
+        return v <= 0.0031308f ? v * 12.92f
+                               : 1.055f * std::pow(v, 1.f / 2.4f) - 0.055f;
+}
+
+// Lookup tables between sRGB encoded 8 or 16 bit channels and linear
+// floats in [0, 1]. Decoding is one load. Encoding searches the linear
+// values at which the rounded code changes, which gives the same result as
+// rounding linear_to_srgb(v) * max, and encode(decode(c)) == c for every
+// code c. A table over 4096 equal steps of v narrows the search to the
+// few codes of one step. 8 bit codes are at least 1/3300 apart in linear
+// light, so a step holds at most one change and the search is a single
+// comparison. The tables are built on first use.
+template <typename S>
+struct srgb_table {
+        static_assert(std::numeric_limits<S>::is_integer &&
+                      !std::numeric_limits<S>::is_signed &&
+                      sizeof(S) <= 2,
+                      "srgb_table needs 8 or 16 bit unsigned channels");
+
+        static constexpr std::size_t codes =
+                std::size_t(std::numeric_limits<S>::max()) + 1;
+
+        static srgb_table const &get() {
+                static const srgb_table table;
+                return table;
+        }
+
+        float decode(S c) const {
+                return to_linear_[c];
+        }
+
+        S encode(float v) const {
+                v = v > 0.f ? (v < 1.f ? v : 1.f) : 0.f; // NaN -> 0
+                const std::size_t i = static_cast<std::size_t>(v * steps);
+                if (codes == 256) {
+                        const S c = first_[i];
+                        return S(c + (c != codes-1 && v >= thresholds_[c]));
+                }
+                return search(v, first_[i], first_[i < steps ? i+1 : i]);
+        }
+
+private:
+        static constexpr std::size_t steps = 4096;
+
+        srgb_table() {
+                const float max = float(codes - 1);
+                for (std::size_t c=0; c!=codes; ++c)
+                        to_linear_[c] = srgb_to_linear(c / max);
+                for (std::size_t c=0; c!=codes-1; ++c)
+                        thresholds_[c] = srgb_to_linear((c + 0.5f) / max);
+                for (std::size_t i=0; i<=steps; ++i)
+                        first_[i] = search(float(i) / steps, 0, codes - 1);
+        }
+
+        // The code of v, known to be in [lo, hi].
+        S search(float v, std::size_t lo, std::size_t hi) const {
+                return S(std::upper_bound(thresholds_ + lo,
+                                          thresholds_ + hi, v)
+                         - thresholds_);
+        }
+
+        float to_linear_[codes];
+        float thresholds_[codes - 1];
+        S first_[steps + 1];
+};
+
+// Direct tables between 8 bit sRGB and 16 bit linear channels, for
+// working on Color32 in linear light with the Color64 kernels:
+// to_linear[c] rounds the linear value of c to 16 bits, to_srgb[l] is the
+// sRGB code of the linear value l/65535 (srgb_table<uint8_t>::encode), and
+// to_srgb[to_linear[c]] == c. 64 KiB plus 512 bytes, built on first use.
+struct srgb8_linear16_table {
+        static srgb8_linear16_table const &get() {
+                static const srgb8_linear16_table table;
+                return table;
+        }
+
+        uint16_t to_linear[256];
+        uint8_t to_srgb[65536];
+
+private:
+        srgb8_linear16_table() {
+                srgb_table<uint8_t> const &t = srgb_table<uint8_t>::get();
+                for (int c=0; c!=256; ++c)
+                        to_linear[c] = uint16_t(
+                                std::nearbyint(t.decode(uint8_t(c)) * 65535.f));
+                for (int l=0; l!=65536; ++l)
+                        to_srgb[l] = t.encode(l / 65535.f);
+        }
+};
+
+} }
+
+#endif //SRGB_HH_INCLUDED_20261018
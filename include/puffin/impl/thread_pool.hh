@@ -0,0 +1,168 @@
+#ifndef THREAD_POOL_HH_INCLUDED_20261018
+#define THREAD_POOL_HH_INCLUDED_20261018
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace puffin { namespace impl {
+
+// Fixed set of worker threads that run index ranges for parallel_for.
+//
+// The calling thread always takes part, so a pool with n workers runs at
+// most n+1 ranges at once, and a call never waits on a busy pool: if all
+// workers are occupied (e.g. by other requests), the caller processes the
+// whole range alone. Calls from inside a worker run sequentially.
+class thread_pool {
+public:
+        explicit thread_pool(unsigned workers) {
+                threads_.reserve(workers);
+                for (unsigned i=0; i!=workers; ++i)
+                        threads_.emplace_back([this] { work(); });
+        }
+
+        ~thread_pool() {
+                {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        stop_ = true;
+                }
+                wake_.notify_all();
+                for (auto &t : threads_)
+                        t.join();
+        }
+
+        thread_pool(thread_pool const &) = delete;
+        thread_pool& operator= (thread_pool const &) = delete;
+
+        // One worker per hardware thread, besides the caller.
+        static thread_pool& shared() {
+                static thread_pool pool(
+                        std::max(1u, std::thread::hardware_concurrency()) - 1);
+                return pool;
+        }
+
+        // Number of threads that can work on one call, including the caller.
+        unsigned concurrency() const noexcept {
+                return static_cast<unsigned>(threads_.size()) + 1;
+        }
+
+        // Calls f(i) for every i in [0, count), on at most max_threads
+        // threads (0: concurrency()). Returns once all calls returned; the
+        // first exception thrown by f is rethrown here, remaining indices
+        // are skipped.
+        template <typename F>
+        void parallel_for(int count, unsigned max_threads, F &&f) {
+                unsigned threads = concurrency();
+                if (max_threads != 0)
+                        threads = std::min(threads, max_threads);
+                threads = std::min(threads, static_cast<unsigned>(
+                        std::max(count, 0)));
+
+                if (threads <= 1 || inside_worker()) {
+                        for (int i=0; i<count; ++i)
+                                f(i);
+                        return;
+                }
+
+                auto st = std::make_shared<state>();
+                st->count = count;
+                st->body = [&f] (int i) { f(i); };
+                {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        for (unsigned i=1; i!=threads; ++i)
+                                tasks_.emplace_back([st] { run(*st); });
+                }
+                wake_.notify_all();
+
+                run(*st);
+
+                // Helpers that start after all indices were claimed return
+                // without touching f; only claimed indices are waited for.
+                std::unique_lock<std::mutex> lock(st->mutex);
+                st->done_cv.wait(lock, [&] {
+                        return st->done == st->count;
+                });
+                if (st->error)
+                        std::rethrow_exception(st->error);
+        }
+
+private:
+        struct state {
+                int count = 0;
+                std::function<void(int)> body;
+                std::atomic<int> next{0};
+                std::atomic<bool> failed{false};
+
+                std::mutex mutex;
+                std::condition_variable done_cv;
+                int done = 0;
+                std::exception_ptr error;
+        };
+
+        static void run(state &st) {
+                int finished = 0;
+                for (;;) {
+                        const int i = st.next.fetch_add(1);
+                        if (i >= st.count)
+                                break;
+                        if (!st.failed.load(std::memory_order_relaxed)) {
+                                try {
+                                        st.body(i);
+                                } catch (...) {
+                                        std::lock_guard<std::mutex> l(st.mutex);
+                                        if (!st.error)
+                                                st.error =
+                                                     std::current_exception();
+                                        st.failed = true;
+                                }
+                        }
+                        ++finished;
+                }
+                if (finished == 0)
+                        return;
+                std::lock_guard<std::mutex> lock(st.mutex);
+                st.done += finished;
+                if (st.done == st.count)
+                        st.done_cv.notify_all();
+        }
+
+        static bool& inside_worker() {
+                static thread_local bool inside = false;
+                return inside;
+        }
+
+        void work() {
+                inside_worker() = true;
+                for (;;) {
+                        std::function<void()> task;
+                        {
+                                std::unique_lock<std::mutex> lock(mutex_);
+                                wake_.wait(lock, [this] {
+                                        return stop_ || !tasks_.empty();
+                                });
+                                if (tasks_.empty())
+                                        return;
+                                task = std::move(tasks_.front());
+                                tasks_.pop_front();
+                        }
+                        task();
+                }
+        }
+
+        std::vector<std::thread> threads_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::deque<std::function<void()>> tasks_;
+        bool stop_ = false;
+};
+
+} }
+
+#endif //THREAD_POOL_HH_INCLUDED_20261018
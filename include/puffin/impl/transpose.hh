@@ -0,0 +1,313 @@
+#ifndef TRANSPOSE_HH_INCLUDED_20261018
+#define TRANSPOSE_HH_INCLUDED_20261018
+
+#include "compiler.hh"
+#include "type_traits.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+#if PUFFIN_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace puffin { namespace impl {
+
+// Transposes a w x h block of src into the h x w block at dst, i.e.
+// dst[x][y] = src[y][x].
+//
+// Strides are given in elements and may be negative: a source or
+// destination addressed from its last row upwards turns the transpose into
+// a 90 or 270 degree rotation without another pass.
+//
+// The image is processed in transpose_tile x transpose_tile tiles, so that
+// the rows touched on both sides stay in L1 and in the TLB. Within a tile,
+// 32-bit bitwise copyable pixels go through 8x8 (AVX2) or 4x4 (SSE2)
+// register transposes; everything else is copied element by element.
+
+constexpr int transpose_tile = 32;
+
+// -- scalar -------------------------------------------------------------------
+template <typename T>
+inline void transpose_block_scalar(
+        T const *src, std::ptrdiff_t srcStride,
+        T *dst, std::ptrdiff_t dstStride,
+        int w, int h
+) {
+        for (int y=0; y!=h; ++y) {
+                T const *s = src + y*srcStride;
+                T *d = dst + y;
+                for (int x=0; x!=w; ++x) {
+                        *d = s[x];
+                        d += dstStride;
+                }
+        }
+}
+
+// -- 32 bit kernels -----------------------------------------------------------
+// Strides of the kernels are in bytes.
+#if PUFFIN_HAS_SSE2
+inline void transpose4x4_32(
+        char const *src, std::ptrdiff_t srcStride,
+        char *dst, std::ptrdiff_t dstStride
+) {
+        const __m128i r0 = _mm_loadu_si128((__m128i const*)(src));
+        const __m128i r1 = _mm_loadu_si128((__m128i const*)(src+srcStride));
+        const __m128i r2 = _mm_loadu_si128((__m128i const*)(src+2*srcStride));
+        const __m128i r3 = _mm_loadu_si128((__m128i const*)(src+3*srcStride));
+
+        const __m128i t0 = _mm_unpacklo_epi32(r0, r1); // a0 b0 a1 b1
+        const __m128i t1 = _mm_unpacklo_epi32(r2, r3); // c0 d0 c1 d1
+        const __m128i t2 = _mm_unpackhi_epi32(r0, r1); // a2 b2 a3 b3
+        const __m128i t3 = _mm_unpackhi_epi32(r2, r3); // c2 d2 c3 d3
+
+        _mm_storeu_si128((__m128i*)(dst),
+                         _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((__m128i*)(dst+dstStride),
+                         _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i*)(dst+2*dstStride),
+                         _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128((__m128i*)(dst+3*dstStride),
+                         _mm_unpackhi_epi64(t2, t3));
+}
+#endif
+
+#if PUFFIN_HAS_AVX2
+inline void transpose8x8_32(
+        char const *src, std::ptrdiff_t srcStride,
+        char *dst, std::ptrdiff_t dstStride
+) {
+        __m256i r[8];
+        for (int i=0; i!=8; ++i)
+                r[i] = _mm256_loadu_si256((__m256i const*)(src+i*srcStride));
+
+        // Within each 128 bit lane: 2x2 blocks of 32 bit, then of 64 bit.
+        __m256i t[8];
+        for (int i=0; i!=4; ++i) {
+                t[2*i  ] = _mm256_unpacklo_epi32(r[2*i], r[2*i+1]);
+                t[2*i+1] = _mm256_unpackhi_epi32(r[2*i], r[2*i+1]);
+        }
+        const __m256i u0 = _mm256_unpacklo_epi64(t[0], t[2]);
+        const __m256i u1 = _mm256_unpackhi_epi64(t[0], t[2]);
+        const __m256i u2 = _mm256_unpacklo_epi64(t[1], t[3]);
+        const __m256i u3 = _mm256_unpackhi_epi64(t[1], t[3]);
+        const __m256i u4 = _mm256_unpacklo_epi64(t[4], t[6]);
+        const __m256i u5 = _mm256_unpackhi_epi64(t[4], t[6]);
+        const __m256i u6 = _mm256_unpacklo_epi64(t[5], t[7]);
+        const __m256i u7 = _mm256_unpackhi_epi64(t[5], t[7]);
+
+        // Across lanes.
+        const __m256i lo[4] = {u0, u1, u2, u3};
+        const __m256i hi[4] = {u4, u5, u6, u7};
+        for (int i=0; i!=4; ++i) {
+                _mm256_storeu_si256((__m256i*)(dst+i*dstStride),
+                        _mm256_permute2x128_si256(lo[i], hi[i], 0x20));
+                _mm256_storeu_si256((__m256i*)(dst+(i+4)*dstStride),
+                        _mm256_permute2x128_si256(lo[i], hi[i], 0x31));
+        }
+}
+#endif
+
+#if PUFFIN_HAS_AVX2
+constexpr int transpose_kernel_size = 8;
+inline void transpose_kernel32(
+        char const *src, std::ptrdiff_t srcStride,
+        char *dst, std::ptrdiff_t dstStride
+) {
+        transpose8x8_32(src, srcStride, dst, dstStride);
+}
+#elif PUFFIN_HAS_SSE2
+constexpr int transpose_kernel_size = 4;
+inline void transpose_kernel32(
+        char const *src, std::ptrdiff_t srcStride,
+        char *dst, std::ptrdiff_t dstStride
+) {
+        transpose4x4_32(src, srcStride, dst, dstStride);
+}
+#endif
+
+template <typename T>
+struct use_transpose_kernel32 :
+        integral_constant<bool,
+                PUFFIN_HAS_SSE2 &&
+                sizeof(T) == 4 &&
+                is_bitwise_copyable<T>::value>
+{};
+
+// -- tile ---------------------------------------------------------------------
+template <typename T>
+inline void transpose_tile_block(
+        T const *src, std::ptrdiff_t srcStride,
+        T *dst, std::ptrdiff_t dstStride,
+        int w, int h,
+        false_type
+) {
+        transpose_block_scalar(src, srcStride, dst, dstStride, w, h);
+}
+
+#if PUFFIN_HAS_SSE2
+template <typename T>
+inline void transpose_tile_block(
+        T const *src, std::ptrdiff_t srcStride,
+        T *dst, std::ptrdiff_t dstStride,
+        int w, int h,
+        true_type
+) {
+        constexpr int K = transpose_kernel_size;
+        const std::ptrdiff_t sb = srcStride * std::ptrdiff_t(sizeof(T));
+        const std::ptrdiff_t db = dstStride * std::ptrdiff_t(sizeof(T));
+        const int kw = w - w % K;
+        const int kh = h - h % K;
+        for (int y=0; y!=kh; y+=K) {
+                for (int x=0; x!=kw; x+=K) {
+                        char const *s = reinterpret_cast<char const*>(
+                                src + y*srcStride + x);
+                        char *d = reinterpret_cast<char*>(
+                                dst + x*dstStride + y);
+                        transpose_kernel32(s, sb, d, db);
+                }
+        }
+        // Right and bottom remainders.
+        if (kw != w) {
+                transpose_block_scalar(src + kw, srcStride,
+                                       dst + kw*dstStride, dstStride,
+                                       w - kw, kh);
+        }
+        if (kh != h) {
+                transpose_block_scalar(src + kh*srcStride, srcStride,
+                                       dst + kh, dstStride,
+                                       w, h - kh);
+        }
+}
+#endif
+
+// -- entry point --------------------------------------------------------------
+template <typename T>
+inline void transpose(
+        T const *src, std::ptrdiff_t srcStride,
+        T *dst, std::ptrdiff_t dstStride,
+        int w, int h
+) {
+        typedef bool_constant<use_transpose_kernel32<T>::value> use_kernel;
+        for (int by=0; by<h; by+=transpose_tile) {
+                const int bh = std::min(transpose_tile, h - by);
+                for (int bx=0; bx<w; bx+=transpose_tile) {
+                        const int bw = std::min(transpose_tile, w - bx);
+                        transpose_tile_block(
+                                src + by*srcStride + bx, srcStride,
+                                dst + bx*dstStride + by, dstStride,
+                                bw, bh,
+                                use_kernel());
+                }
+        }
+}
+
+// -- in place, square --------------------------------------------------------
+// Transposes the n x n matrix at p in place. Every element outside the
+// diagonal lies on a cycle of length two, (x,y) <-> (y,x), so the tiles
+// above the diagonal are exchanged with their mirror tiles below it, and
+// the diagonal tiles are transposed within themselves.
+
+template <typename T>
+inline void swap_transposed_scalar(
+        T *a, T *b, std::ptrdiff_t stride,
+        int w, int h
+) {
+        using std::swap;
+        for (int y=0; y!=h; ++y) {
+                T *pa = a + y*stride;
+                T *pb = b + y;
+                for (int x=0; x!=w; ++x) {
+                        swap(pa[x], *pb);
+                        pb += stride;
+                }
+        }
+}
+
+// Exchanges the w x h block at a with the transposed h x w block at b.
+// The blocks must not overlap.
+template <typename T>
+inline void swap_transposed_tile(
+        T *a, T *b, std::ptrdiff_t stride,
+        int w, int h,
+        false_type
+) {
+        swap_transposed_scalar(a, b, stride, w, h);
+}
+
+#if PUFFIN_HAS_SSE2
+template <typename T>
+inline void swap_transposed_tile(
+        T *a, T *b, std::ptrdiff_t stride,
+        int w, int h,
+        true_type
+) {
+        constexpr int K = transpose_kernel_size;
+        const std::ptrdiff_t sb = stride * std::ptrdiff_t(sizeof(T));
+        const int kw = w - w % K;
+        const int kh = h - h % K;
+        alignas(32) char tmp[K * K * 4];
+        for (int y=0; y!=kh; y+=K) {
+                for (int x=0; x!=kw; x+=K) {
+                        char *pa = reinterpret_cast<char*>(a + y*stride + x);
+                        char *pb = reinterpret_cast<char*>(b + x*stride + y);
+                        transpose_kernel32(pa, sb, tmp, K*4);
+                        transpose_kernel32(pb, sb, pa, sb);
+                        for (int i=0; i!=K; ++i)
+                                std::memcpy(pb + i*sb, tmp + i*K*4, K*4);
+                }
+        }
+        if (kw != w) {
+                swap_transposed_scalar(a + kw, b + kw*stride, stride,
+                                       w - kw, kh);
+        }
+        if (kh != h) {
+                swap_transposed_scalar(a + kh*stride, b + kh, stride,
+                                       w, h - kh);
+        }
+}
+#endif
+
+template <typename T>
+inline void transpose_diagonal_tile(T *p, std::ptrdiff_t stride, int n) {
+        using std::swap;
+        for (int y=0; y!=n; ++y) {
+                for (int x=y+1; x!=n; ++x)
+                        swap(p[y*stride + x], p[x*stride + y]);
+        }
+}
+
+// Handles the diagonal tile at (by, by) and all tiles right of it, with
+// their mirror tiles below the diagonal. Distinct tile rows touch
+// distinct elements.
+template <typename T>
+inline void transpose_square_inplace_tile_row(
+        T *p, std::ptrdiff_t stride, int n, int by
+) {
+        typedef bool_constant<use_transpose_kernel32<T>::value> use_kernel;
+        const int bh = std::min(transpose_tile, n - by);
+        transpose_diagonal_tile(p + by*stride + by, stride, bh);
+        for (int bx=by+transpose_tile; bx<n; bx+=transpose_tile) {
+                const int bw = std::min(transpose_tile, n - bx);
+                swap_transposed_tile(
+                        p + by*stride + bx,
+                        p + bx*stride + by,
+                        stride,
+                        bw, bh,
+                        use_kernel());
+        }
+}
+
+template <typename T>
+inline void transpose_square_inplace(T *p, std::ptrdiff_t stride, int n) {
+        for (int by=0; by<n; by+=transpose_tile)
+                transpose_square_inplace_tile_row(p, stride, n, by);
+}
+
+} }
+
+#endif //TRANSPOSE_HH_INCLUDED_20261018
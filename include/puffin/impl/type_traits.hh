@@ -2,6 +2,7 @@
 #define TYPE_TRAITS_HH_INCLUDED_20181221
 
 #include "compiler.hh"
+#include <type_traits>
 
 #if PUFFIN_HAS_CONSTEXPR
 #define PUFFIN_DECLARE_COMPILE_TIME_INT(type, name, value) \
@@ -182,6 +183,15 @@ struct is_unsigned_integer :
         >
 {};
 
+// __ is_bitwise_copyable ______________________________________________________
+// True if objects of T may be moved around with memcpy or SIMD loads and
+// stores. Types whose copy operations are user-provided but memberwise may
+// specialize this.
+template <typename T>
+struct is_bitwise_copyable :
+        integral_constant<bool, std::is_trivially_copyable<T>::value>
+{};
+
 
 } }
 
@@ -0,0 +1,424 @@
+#ifndef INTEGRAL_IMAGE_HH_INCLUDED_20261018
+#define INTEGRAL_IMAGE_HH_INCLUDED_20261018
+
+#include "color.hh"
+#include "color_ops.hh"
+#include "coords.hh"
+#include "execution.hh"
+#include "image.hh"
+#include "image_view.hh"
+#include "impl/compiler.hh"
+#include "impl/contract.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin {
+
+// -- IntegralTables -----------------------------------------------------------
+// What integral_image builds.
+//
+// - Sums: the table of pixel sums, for sum() and mean().
+// - SumsAndSquares: also the table of squared pixel sums, for
+//   sum_squares() and variance(), e.g. the local deviation of adaptive
+//   thresholding. Twice the memory and about twice the build time.
+enum class IntegralTables {
+        Sums,
+        SumsAndSquares
+};
+
+// -- integral_image -----------------------------------------------------------
+// The summed-area table of an image of unsigned integer channels (Color32,
+// Color64, either channel order): entry (x, y) of sums() holds the channel
+// sums of the pixels left of x and above y, so the table is one larger than
+// the image in both directions, with a zero first row and column. The sum
+// over any rectangle is then four lookups, whatever its size.
+//
+// Acc is the channel type of the table. With the default uint64_t, sums are
+// exact for any image. uint32_t halves the memory (16 instead of 32 bytes
+// per pixel); entries then wrap around, but since the lookups are combined
+// modulo 2^32, sum() stays exact for every rectangle whose sums fit in 32
+// bits, e.g. up to 16 million Color32 pixels. The same holds for the
+// squares, which only fit 66049 Color32 pixels at 32 bits.
+//
+// Rows are built in one pass, each pixel widened to Acc with SSE2 and added
+// to a running row sum and the entry above. With an execution policy, bands
+// of rows are built independently from zero, then each band adds the
+// last row of the band above it, once that is final.
+template <typename T, typename Acc = uint64_t>
+class integral_image final {
+public:
+        static_assert(std::is_integral<typename T::alpha_type>::value,
+                      "integral_image needs unsigned integer channels");
+        static_assert(std::is_same<Acc, uint32_t>::value ||
+                      std::is_same<Acc, uint64_t>::value,
+                      "integral_image sums in uint32_t or uint64_t");
+
+        // -- types ------------------------------------------------------------
+        using value_type = T;
+        using accumulator_type = Acc;
+        using sum_type = basic_rgba<Acc, Acc, Acc, Acc,
+                                    typename T::order_type>;
+        using mean_type = basic_rgba<double, double, double, double>;
+        using table_type = base_image<sum_type>;
+
+        // -- constructors -----------------------------------------------------
+        explicit integral_image(image_view<T> const &src,
+                                IntegralTables tables = IntegralTables::Sums);
+
+        template <typename ExecutionPolicy, typename =
+                  execution::enable_if_execution_policy<ExecutionPolicy>>
+        integral_image(ExecutionPolicy const &, image_view<T> const &src,
+                       IntegralTables tables = IntegralTables::Sums);
+
+        integral_image(integral_image const &) = default;
+        integral_image& operator= (integral_image const &) = default;
+
+        integral_image(integral_image &&) noexcept = default;
+        integral_image& operator= (integral_image &&) noexcept = default;
+
+        ~integral_image() = default;
+
+        // -- queries ----------------------------------------------------------
+        // rect must lie inside the image. sum() and sum_squares() of an
+        // empty rect are zero; mean() and variance() need a non-empty one.
+        // sum_squares() and variance() need IntegralTables::SumsAndSquares.
+        sum_type sum(Rect const &rect) const;
+        sum_type sum_squares(Rect const &rect) const;
+
+        mean_type mean(Rect const &rect) const;
+        mean_type variance(Rect const &rect) const; // population variance
+
+        // -- tables -----------------------------------------------------------
+        // (width()+1) x (height()+1) entries; squares() is 0 x 0 without
+        // IntegralTables::SumsAndSquares.
+        table_type const& sums() const noexcept;
+        table_type const& squares() const noexcept;
+        bool has_squares() const noexcept;
+
+        // -- dimensions -------------------------------------------------------
+        // Of the source image.
+        int width() const noexcept;
+        int height() const noexcept;
+
+private:
+        table_type sums_, squares_;
+
+        void ensureRectContract(Rect const &rect) const {
+                impl::positive(rect.left());
+                impl::positive(rect.top());
+                impl::less_or_equal(rect.right(), width());
+                impl::less_or_equal(rect.bottom(), height());
+        }
+};
+
+typedef integral_image<Color64> IntegralImage64;
+typedef integral_image<Color32> IntegralImage32;
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+// -- integral rows ------------------------------------------------------------
+// out[x+1] = above[x+1] + in[0] + ... + in[x], channel by channel, squared
+// if Square. out[0] stays zero. The SSE2 versions, taking an int where the
+// generic one takes "...", compute exactly the same.
+template <bool Square, typename A>
+inline A integral_term(A v) {
+        return Square ? A(v * v) : v;
+}
+
+template <bool Square, typename T, typename A, typename O>
+inline void integral_row(T const *in, basic_rgba<A, A, A, A, O> const *above,
+                         basic_rgba<A, A, A, A, O> *out, int w, ...) {
+        A r = 0, g = 0, b = 0, a = 0;
+        for (int x=0; x!=w; ++x) {
+                r += integral_term<Square>(A(in[x].r()));
+                g += integral_term<Square>(A(in[x].g()));
+                b += integral_term<Square>(A(in[x].b()));
+                a += integral_term<Square>(A(in[x].a()));
+                out[x+1] = basic_rgba<A, A, A, A, O>{
+                        A(above[x+1].r() + r), A(above[x+1].g() + g),
+                        A(above[x+1].b() + b), A(above[x+1].a() + a)};
+        }
+}
+
+#if PUFFIN_HAS_SSE2
+// The four channels of one pixel, or their squares, in the 32 bit lanes of
+// a register (memory order); squares of 16 bit channels modulo 2^32.
+template <bool Square, typename O>
+inline __m128i integral_lanes32(rgba8<O> const *p) {
+        const __m128i zero = _mm_setzero_si128();
+        int bits;
+        std::memcpy(&bits, p, sizeof bits);
+        __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero);
+        if (Square)
+                v = _mm_mullo_epi16(v, v); // at most 255^2, still 16 bit
+        return _mm_unpacklo_epi16(v, zero);
+}
+
+template <bool Square, typename O>
+inline __m128i integral_lanes32(rgba16<O> const *p) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i v = _mm_unpacklo_epi16(
+                _mm_loadl_epi64(reinterpret_cast<__m128i const*>(p)), zero);
+        if (!Square)
+                return v;
+        // Squares of lanes 0 and 2, then 1 and 3, as 64 bit products.
+        const __m128i sq02 = _mm_mul_epu32(v, v);
+        const __m128i v13 = _mm_srli_epi64(v, 32);
+        const __m128i sq13 = _mm_mul_epu32(v13, v13);
+        return _mm_unpacklo_epi32(
+                _mm_shuffle_epi32(sq02, _MM_SHUFFLE(3, 1, 2, 0)),
+                _mm_shuffle_epi32(sq13, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// As integral_lanes32(), widened to 64 bit lanes 0 and 1 in lo, 2 and 3 in
+// hi, with exact squares.
+template <bool Square, typename O>
+inline void integral_lanes64(rgba8<O> const *p, __m128i &lo, __m128i &hi) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i v = integral_lanes32<Square>(p);
+        lo = _mm_unpacklo_epi32(v, zero);
+        hi = _mm_unpackhi_epi32(v, zero);
+}
+
+template <bool Square, typename O>
+inline void integral_lanes64(rgba16<O> const *p, __m128i &lo, __m128i &hi) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i v = integral_lanes32<false>(p);
+        if (!Square) {
+                lo = _mm_unpacklo_epi32(v, zero);
+                hi = _mm_unpackhi_epi32(v, zero);
+                return;
+        }
+        const __m128i sq02 = _mm_mul_epu32(v, v);
+        const __m128i v13 = _mm_srli_epi64(v, 32);
+        const __m128i sq13 = _mm_mul_epu32(v13, v13);
+        lo = _mm_unpacklo_epi64(sq02, sq13);
+        hi = _mm_unpackhi_epi64(sq02, sq13);
+}
+
+template <bool Square, typename T, typename O>
+inline auto integral_row(T const *in,
+                         basic_rgba<uint32_t, uint32_t, uint32_t, uint32_t,
+                                    O> const *above,
+                         basic_rgba<uint32_t, uint32_t, uint32_t, uint32_t,
+                                    O> *out,
+                         int w, int)
+        -> decltype(void(integral_lanes32<Square>(in)))
+{
+        __m128i run = _mm_setzero_si128();
+        for (int x=0; x!=w; ++x) {
+                run = _mm_add_epi32(run, integral_lanes32<Square>(in + x));
+                store_px(out + x + 1,
+                         _mm_add_epi32(load_px(above + x + 1), run));
+        }
+}
+
+template <bool Square, typename T, typename O>
+inline auto integral_row(T const *in,
+                         basic_rgba<uint64_t, uint64_t, uint64_t, uint64_t,
+                                    O> const *above,
+                         basic_rgba<uint64_t, uint64_t, uint64_t, uint64_t,
+                                    O> *out,
+                         int w, int)
+        -> decltype(void(integral_lanes32<Square>(in)))
+{
+        __m128i run_lo = _mm_setzero_si128(), run_hi = run_lo;
+        for (int x=0; x!=w; ++x) {
+                __m128i lo, hi;
+                integral_lanes64<Square>(in + x, lo, hi);
+                run_lo = _mm_add_epi64(run_lo, lo);
+                run_hi = _mm_add_epi64(run_hi, hi);
+                __m128i const *a =
+                        reinterpret_cast<__m128i const*>(above + x + 1);
+                __m128i *o = reinterpret_cast<__m128i*>(out + x + 1);
+                _mm_storeu_si128(o, _mm_add_epi64(_mm_loadu_si128(a),
+                                                  run_lo));
+                _mm_storeu_si128(o + 1, _mm_add_epi64(_mm_loadu_si128(a + 1),
+                                                      run_hi));
+        }
+}
+#endif
+
+// row[i] += carry[i] for n entries, channel by channel.
+template <typename A, typename O>
+inline void add_integral_row(basic_rgba<A, A, A, A, O> const *carry,
+                             basic_rgba<A, A, A, A, O> *row, int n) {
+        A const *c = reinterpret_cast<A const*>(carry);
+        A *r = reinterpret_cast<A*>(row);
+        for (int i=0, end=4*n; i!=end; ++i)
+                r[i] += c[i];
+}
+
+// Fills table (zero on entry) with the integral image of src.
+//
+// Band b covers source rows [y0, y1), i.e. table rows y0+1 to y1. The
+// first phase builds each band as if it were the top of the image, above
+// its rows the zero row 0. Row y0 of band b+1 is then complete once band b
+// is, so the second phase makes the last rows complete in order, and then
+// adds to the other rows of each band the last row of the band above.
+template <bool Square, typename ExecutionPolicy, typename T, typename S>
+inline void build_integral(ExecutionPolicy const &policy,
+                           image_view<T> const &src, base_image<S> &table) {
+        const int w = src.width(), h = src.height();
+        const auto build = [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y)
+                        integral_row<Square>(src.row(y),
+                                             table.row(y == y0 ? 0 : y),
+                                             table.row(y + 1), w, 0);
+        };
+        if (max_threads(policy) == 1 || h == 0) {
+                build(0, h);
+                return;
+        }
+
+        const std::size_t row_bytes = table.stride() * sizeof(S);
+        const int rows = static_cast<int>(std::min<std::size_t>(
+                h, std::max<std::size_t>(1, parallel_band_bytes / row_bytes)));
+        const int bands = (h + rows - 1) / rows;
+        for_each_band(policy, bands, rows * row_bytes, 1,
+                      [&] (int b0, int b1) {
+                for (int b=b0; b!=b1; ++b)
+                        build(b * rows, std::min(h, (b + 1) * rows));
+        });
+        for (int b=1; b<bands; ++b) {
+                const int y0 = b * rows, y1 = std::min(h, y0 + rows);
+                add_integral_row(table.row(y0), table.row(y1), w + 1);
+        }
+        for_each_band(policy, bands, rows * row_bytes, 1,
+                      [&] (int b0, int b1) {
+                for (int b=std::max(b0, 1); b<b1; ++b) {
+                        const int y0 = b * rows,
+                                  y1 = std::min(h, y0 + rows);
+                        for (int y=y0+1; y<y1; ++y)
+                                add_integral_row(table.row(y0),
+                                                 table.row(y), w + 1);
+                }
+        });
+}
+
+// The sums of table over rect, modulo 2^bits of A.
+template <typename S>
+inline S integral_sum(base_image<S> const &table, Rect const &rect) {
+        using A = typename S::alpha_type;
+        S const *top = table.row(rect.top());
+        S const *bottom = table.row(rect.bottom());
+        const int l = rect.left(), r = rect.right();
+        return S{A(bottom[r].r() - bottom[l].r() - top[r].r() + top[l].r()),
+                 A(bottom[r].g() - bottom[l].g() - top[r].g() + top[l].g()),
+                 A(bottom[r].b() - bottom[l].b() - top[r].b() + top[l].b()),
+                 A(bottom[r].a() - bottom[l].a() - top[r].a() + top[l].a())};
+}
+
+} }
+
+namespace puffin {
+
+template <typename T, typename Acc>
+inline integral_image<T, Acc>::integral_image(image_view<T> const &src,
+                                              IntegralTables tables) :
+        integral_image{execution::seq, src, tables}
+{
+}
+
+template <typename T, typename Acc>
+template <typename ExecutionPolicy, typename>
+inline integral_image<T, Acc>::integral_image(
+        ExecutionPolicy const &policy,
+        image_view<T> const &src,
+        IntegralTables tables
+) :
+        sums_{src.width() + 1, src.height() + 1, sum_type{0, 0, 0, 0}},
+        squares_{0, 0}
+{
+        impl::build_integral<false>(policy, src, sums_);
+        if (tables == IntegralTables::SumsAndSquares) {
+                squares_ = table_type{src.width() + 1, src.height() + 1,
+                                      sum_type{0, 0, 0, 0}};
+                impl::build_integral<true>(policy, src, squares_);
+        }
+}
+
+template <typename T, typename Acc>
+inline auto integral_image<T, Acc>::sum(Rect const &rect) const -> sum_type {
+        ensureRectContract(rect);
+        return impl::integral_sum(sums_, rect);
+}
+
+template <typename T, typename Acc>
+inline auto integral_image<T, Acc>::sum_squares(Rect const &rect) const
+        -> sum_type
+{
+        impl::equal_to(has_squares(), true);
+        ensureRectContract(rect);
+        return impl::integral_sum(squares_, rect);
+}
+
+template <typename T, typename Acc>
+inline auto integral_image<T, Acc>::mean(Rect const &rect) const
+        -> mean_type
+{
+        impl::greater_than(rect.width(), 0);
+        impl::greater_than(rect.height(), 0);
+        const sum_type s = sum(rect);
+        const double f = 1.0 / (double(rect.width()) * rect.height());
+        return mean_type{s.r() * f, s.g() * f, s.b() * f, s.a() * f};
+}
+
+template <typename T, typename Acc>
+inline auto integral_image<T, Acc>::variance(Rect const &rect) const
+        -> mean_type
+{
+        const mean_type m = mean(rect);
+        const sum_type q = sum_squares(rect);
+        const double f = 1.0 / (double(rect.width()) * rect.height());
+        const auto var = [f] (double sq, double mean) {
+                return std::max(0.0, sq * f - mean * mean);
+        };
+        return mean_type{var(q.r(), m.r()), var(q.g(), m.g()),
+                         var(q.b(), m.b()), var(q.a(), m.a())};
+}
+
+template <typename T, typename Acc>
+inline auto integral_image<T, Acc>::sums() const noexcept
+        -> table_type const&
+{
+        return sums_;
+}
+
+template <typename T, typename Acc>
+inline auto integral_image<T, Acc>::squares() const noexcept
+        -> table_type const&
+{
+        return squares_;
+}
+
+template <typename T, typename Acc>
+inline bool integral_image<T, Acc>::has_squares() const noexcept {
+        return !squares_.empty();
+}
+
+template <typename T, typename Acc>
+inline int integral_image<T, Acc>::width() const noexcept {
+        return sums_.width() - 1;
+}
+
+template <typename T, typename Acc>
+inline int integral_image<T, Acc>::height() const noexcept {
+        return sums_.height() - 1;
+}
+
+}
+
+#endif //INTEGRAL_IMAGE_HH_INCLUDED_20261018
@@ -0,0 +1,214 @@
+#ifndef MIPMAP_HH_INCLUDED_20261018
+#define MIPMAP_HH_INCLUDED_20261018
+
+#include "image.hh"
+#include "execution.hh"
+#include "impl/box_reduce.hh"
+#include "impl/contract.hh"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace puffin {
+
+// -- MipFilter ----------------------------------------------------------------
+// How mip_chain computes a level from the one above it.
+//
+// - Box: the rounded average of each 2x2 block.
+// - SrgbBox: as Box, but the colour channels of unsigned integer pixels
+//   (Color32, Color64) are taken as sRGB encoded and averaged in linear
+//   light, so that minified textures keep their brightness. Alpha, and all
+//   channels of other pixel types, are averaged as with Box.
+enum class MipFilter {
+        Box,
+        SrgbBox
+};
+
+// -- mip_chain ----------------------------------------------------------------
+// An image and its successively halved versions, down to 1x1 ("mipmaps").
+// Level l+1 has max(1, w/2) x max(1, h/2) pixels for a level l of w x h;
+// each of its pixels averages a 2x2 block of level l. Odd sizes drop the
+// last row or column, a side of 1 is used twice. Color32 and Color64 levels
+// are reduced with SSE2 (see impl/box_reduce.hh).
+//
+// A minified texture is sampled on the level whose texels are about as
+// large as the pixel footprint, see ImageFilter::operator()(chain, u, v,
+// du, dv). Neighbouring pixels then read neighbouring texels instead of
+// texels far apart, and the smaller levels (a third of the base, all
+// together) stay in cache.
+template <typename T>
+class mip_chain final {
+public:
+        // -- types ------------------------------------------------------------
+        using value_type = T;
+        using image_type = base_image<T>;
+
+        // -- constructors -----------------------------------------------------
+        // The levels use the layout of base.
+        explicit mip_chain(image_type base, MipFilter filter = MipFilter::Box);
+
+        template <typename ExecutionPolicy, typename =
+                  execution::enable_if_execution_policy<ExecutionPolicy>>
+        mip_chain(ExecutionPolicy const &, image_type base,
+                  MipFilter filter = MipFilter::Box);
+
+        mip_chain(mip_chain const &) = default;
+        mip_chain& operator= (mip_chain const &) = default;
+
+        mip_chain(mip_chain &&) noexcept = default;
+        mip_chain& operator= (mip_chain &&) noexcept = default;
+
+        ~mip_chain() = default;
+
+        // -- levels -----------------------------------------------------------
+        // level(0) is the base image; l must be in [0, levels()).
+        int levels() const noexcept;
+        image_type const& level(int l) const noexcept;
+
+        int width() const noexcept;
+        int height() const noexcept;
+
+        // The level of detail for a pixel footprint of du x dv texture
+        // coordinates: log2 of the number of base texels it spans along its
+        // longer side, clamped to [0, levels()-1].
+        double lod(double du, double dv) const noexcept;
+
+private:
+        std::vector<image_type> levels_;
+};
+
+typedef mip_chain<Color64> MipChain64;
+typedef mip_chain<Color32> MipChain32;
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+// Level l+1 of a mip_chain from level l.
+template <typename ExecutionPolicy, typename T>
+inline base_image<T> mip_reduce(
+        ExecutionPolicy const &policy,
+        base_image<T> const &src,
+        MipFilter filter
+) {
+        const int sw = src.width(), sh = src.height();
+        base_image<T> dst{std::max(1, sw/2), std::max(1, sh/2), src.layout()};
+        const int w = dst.width();
+        for_each_band(policy, dst.height(), 2 * src.stride() * sizeof(T), 1,
+                      [&] (int begin, int end) {
+                for (int y=begin; y!=end; ++y) {
+                        T const *r0 = src.row(std::min(2*y, sh-1));
+                        T const *r1 = src.row(std::min(2*y+1, sh-1));
+                        const T col0[2] = {r0[0], r0[0]};
+                        const T col1[2] = {r1[0], r1[0]};
+                        if (sw == 1) {
+                                r0 = col0;
+                                r1 = col1;
+                        }
+                        if (filter == MipFilter::SrgbBox)
+                                box_reduce_row_srgb(r0, r1, dst.row(y), w);
+                        else
+                                box_reduce_row(r0, r1, dst.row(y), w);
+                }
+        });
+        return dst;
+}
+
+} }
+
+namespace puffin {
+
+template <typename T>
+inline mip_chain<T>::mip_chain(image_type base, MipFilter filter) :
+        mip_chain{execution::seq, std::move(base), filter}
+{
+}
+
+template <typename T>
+template <typename ExecutionPolicy, typename>
+inline mip_chain<T>::mip_chain(
+        ExecutionPolicy const &policy,
+        image_type base,
+        MipFilter filter
+) {
+        impl::greater_than(base.width(), 0);
+        impl::greater_than(base.height(), 0);
+        levels_.push_back(std::move(base));
+        while (levels_.back().width() > 1 || levels_.back().height() > 1)
+                levels_.push_back(
+                        impl::mip_reduce(policy, levels_.back(), filter));
+}
+
+template <typename T>
+inline int mip_chain<T>::levels() const noexcept {
+        return static_cast<int>(levels_.size());
+}
+
+template <typename T>
+inline auto mip_chain<T>::level(int l) const noexcept -> image_type const& {
+        return levels_[l];
+}
+
+template <typename T>
+inline int mip_chain<T>::width() const noexcept {
+        return levels_.front().width();
+}
+
+template <typename T>
+inline int mip_chain<T>::height() const noexcept {
+        return levels_.front().height();
+}
+
+template <typename T>
+inline double mip_chain<T>::lod(double du, double dv) const noexcept {
+        const double texels = std::max(std::abs(du) * width(),
+                                       std::abs(dv) * height());
+        if (!(texels > 1)) // magnified, or NaN
+                return 0;
+        return std::min(std::log2(texels), double(levels() - 1));
+}
+
+// -- ImageFilter --------------------------------------------------------------
+template <typename T>
+inline T ImageFilter::operator()(
+        mip_chain<T> const &chain,
+        double u, double v,
+        double du, double dv
+) const noexcept {
+        // nearest() and bilinear() place texel i of an image of width w at
+        // u = i/w. The texel of level l that covers base texels [2^l i,
+        // 2^l (i+1)) is centred half a texel of level l minus half a base
+        // texel further right; the same holds for v.
+        const auto sample = [&] (int l, bool linear) {
+                auto const &img = chain.level(l);
+                const double
+                        ul = u + 0.5/chain.width()  - 0.5/img.width(),
+                        vl = v + 0.5/chain.height() - 0.5/img.height();
+                return linear ? bilinear(img, ul, vl) : nearest(img, ul, vl);
+        };
+
+        const double lod = chain.lod(du, dv);
+        switch (filtering_) {
+        case Filtering::Trilinear: {
+                const int l = static_cast<int>(lod);
+                const double t = lod - l;
+                const T a = sample(l, true);
+                if (t == 0) // also covers l == levels()-1
+                        return a;
+                return lerp(a, sample(l + 1, true), t);
+        }
+        case Filtering::Bilinear:
+                return sample(static_cast<int>(lod + 0.5), true);
+        case Filtering::Nearest:
+        default:
+                return sample(static_cast<int>(lod + 0.5), false);
+        }
+}
+
+}
+
+#endif //MIPMAP_HH_INCLUDED_20261018
@@ -0,0 +1,573 @@
+#ifndef PLANAR_IMAGE_HH_INCLUDED_20261018
+#define PLANAR_IMAGE_HH_INCLUDED_20261018
+
+#include "image.hh"
+#include "execution.hh"
+#include "impl/contract.hh"
+#include "impl/interleave.hh"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace puffin {
+
+// -- planar_image -------------------------------------------------------------
+// An image stored as one base_image per channel ("structure of arrays"),
+// where base_image<Color32> interleaves the channels of each pixel. Every
+// plane has its own aligned rows, so channel-wise loops run over
+// contiguous scalars and vectorise without shuffling channels.
+//
+// The algorithms of image.hh apply plane by plane; for_each and the
+// arithmetic operators see single samples rather than pixels. The scalar
+// operators compute each sample as impl::channel_arith does for the same
+// channel of a basic_rgba (rounded and saturated for integer samples, the
+// double of min() and max() a fraction of full scale), so that a planar
+// image gives the samples of the interleaved one.
+// deinterleave() and interleave() convert from and to
+// base_image<basic_rgba<S,S,S,S>>.
+template <typename T, int Channels>
+class planar_image final {
+        static_assert(Channels > 0, "planar_image needs at least a channel");
+public:
+        // -- types ------------------------------------------------------------
+        using value_type = T;
+        using plane_type = base_image<T>;
+        using size_type = typename plane_type::size_type;
+        using pixel_type = std::array<T, Channels>;
+
+        static constexpr int channels = Channels;
+
+        // -- constructors -----------------------------------------------------
+        planar_image(int width, int height);
+        planar_image(int width, int height, image_layout const &layout);
+        planar_image(int width, int height, image_layout const &layout,
+                     pixel_type const &init);
+
+        // All planes must have the same size.
+        explicit planar_image(std::vector<plane_type> planes);
+
+        planar_image(planar_image const &) = default;
+        planar_image& operator= (planar_image const &) = default;
+
+        planar_image(planar_image &&) noexcept = default;
+        planar_image& operator= (planar_image &&) noexcept = default;
+
+        ~planar_image() = default;
+
+        // -- planes -----------------------------------------------------------
+        plane_type& plane(int c);
+        plane_type const& plane(int c) const;
+
+        // -- element access ---------------------------------------------------
+        value_type& operator() (int x, int y, int c);
+        value_type operator() (int x, int y, int c) const;
+
+        pixel_type pixel(int x, int y) const;
+        void pixel(int x, int y, pixel_type const &v);
+
+        // -- dimensions -------------------------------------------------------
+        int width() const;
+        int height() const;
+        size_type stride() const;
+        image_layout const& layout() const;
+
+        // -- algorithms -------------------------------------------------------
+        // f is called with each sample (value_type&) of each plane.
+        template <typename SampleFunction>
+        void for_each (SampleFunction f);
+
+        template <typename ExecutionPolicy, typename SampleFunction>
+        auto for_each (ExecutionPolicy const &, SampleFunction f)
+                -> execution::enable_if_execution_policy<ExecutionPolicy>;
+
+        // f is called as f(channel, plane_type&).
+        template <typename PlaneFunction>
+        void for_each_plane (PlaneFunction f);
+
+        void fill(pixel_type const &val);
+
+        template <typename ExecutionPolicy>
+        auto fill(ExecutionPolicy const &, pixel_type const &val)
+                -> execution::enable_if_execution_policy<ExecutionPolicy>;
+
+private:
+        std::vector<plane_type> planes_;
+};
+
+typedef planar_image<uint8_t, 4>  Planar32;
+typedef planar_image<uint16_t, 4> Planar64;
+
+template <typename T, int C> inline int width(planar_image<T, C> const &canvas);
+template <typename T, int C> inline int height(planar_image<T, C> const &canvas);
+
+template <typename T, int C> inline planar_image<T, C> operator* (planar_image<T, C> canvas, double f);
+template <typename T, int C> inline planar_image<T, C> operator* (double f, planar_image<T, C> canvas);
+template <typename T, int C> inline planar_image<T, C> operator/ (planar_image<T, C> canvas, double f);
+template <typename T, int C> inline planar_image<T, C>& operator*= (planar_image<T, C> &canvas, double f);
+template <typename T, int C> inline planar_image<T, C>& operator/= (planar_image<T, C> &canvas, double f);
+template <typename T, int C> inline planar_image<T, C> min(planar_image<T, C> canvas, double f);
+template <typename T, int C> inline planar_image<T, C> max(planar_image<T, C> canvas, double f);
+
+// -- conversion ---------------------------------------------------------------
+template <typename S>
+inline planar_image<S, 4> deinterleave(
+        base_image<basic_rgba<S, S, S, S>> const &canvas);
+
+template <typename ExecutionPolicy, typename S>
+inline auto deinterleave(
+        ExecutionPolicy const &,
+        base_image<basic_rgba<S, S, S, S>> const &canvas
+) -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                           planar_image<S, 4>>;
+
+template <typename S>
+inline base_image<basic_rgba<S, S, S, S>> interleave(
+        planar_image<S, 4> const &canvas);
+
+template <typename ExecutionPolicy, typename S>
+inline auto interleave(
+        ExecutionPolicy const &,
+        planar_image<S, 4> const &canvas
+) -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                           base_image<basic_rgba<S, S, S, S>>>;
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin {
+
+template <typename T, int Channels>
+inline planar_image<T, Channels>::planar_image (int width, int height) :
+        planar_image{width, height, image_layout::aligned()}
+{
+}
+
+template <typename T, int Channels>
+inline planar_image<T, Channels>::planar_image (
+        int width,
+        int height,
+        image_layout const &layout
+) :
+        planar_image{width, height, layout, pixel_type()}
+{
+}
+
+template <typename T, int Channels>
+inline planar_image<T, Channels>::planar_image (
+        int width,
+        int height,
+        image_layout const &layout,
+        pixel_type const &init
+) {
+        planes_.reserve(Channels);
+        for (int c=0; c!=Channels; ++c)
+                planes_.emplace_back(width, height, layout, init[c]);
+}
+
+template <typename T, int Channels>
+inline planar_image<T, Channels>::planar_image (
+        std::vector<plane_type> planes
+) :
+        planes_(std::move(planes))
+{
+        impl::equal_to(static_cast<int>(planes_.size()), Channels);
+        for (auto const &p : planes_) {
+                impl::equal_to(p.width(), planes_[0].width());
+                impl::equal_to(p.height(), planes_[0].height());
+        }
+}
+
+// -- planes -------------------------------------------------------------------
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::plane(int c) -> plane_type& {
+        return planes_[impl::less_than(impl::positive(c), Channels)];
+}
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::plane(int c) const
+        -> plane_type const&
+{
+        return planes_[impl::less_than(impl::positive(c), Channels)];
+}
+
+// -- element access -----------------------------------------------------------
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::operator() (int x, int y, int c)
+        -> value_type&
+{
+        return plane(c)(x, y);
+}
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::operator() (int x, int y, int c) const
+        -> value_type
+{
+        return plane(c)(x, y);
+}
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::pixel(int x, int y) const
+        -> pixel_type
+{
+        pixel_type ret;
+        for (int c=0; c!=Channels; ++c)
+                ret[c] = planes_[c](x, y);
+        return ret;
+}
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::pixel(
+        int x, int y,
+        pixel_type const &v
+) -> void {
+        for (int c=0; c!=Channels; ++c)
+                planes_[c](x, y) = v[c];
+}
+
+// -- dimensions ---------------------------------------------------------------
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::width() const -> int {
+        return planes_[0].width();
+}
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::height() const -> int {
+        return planes_[0].height();
+}
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::stride() const -> size_type {
+        return planes_[0].stride();
+}
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::layout() const -> image_layout const& {
+        return planes_[0].layout();
+}
+
+// -- algorithms ---------------------------------------------------------------
+
+template <typename T, int Channels>
+template <typename SampleFunction>
+inline auto planar_image<T, Channels>::for_each (SampleFunction f) -> void {
+        for_each(execution::seq, f);
+}
+
+template <typename T, int Channels>
+template <typename ExecutionPolicy, typename SampleFunction>
+inline auto planar_image<T, Channels>::for_each (
+        ExecutionPolicy const &policy,
+        SampleFunction f
+) -> execution::enable_if_execution_policy<ExecutionPolicy> {
+        for (auto &p : planes_)
+                p.for_each(policy, f);
+}
+
+template <typename T, int Channels>
+template <typename PlaneFunction>
+inline auto planar_image<T, Channels>::for_each_plane (PlaneFunction f)
+        -> void
+{
+        for (int c=0; c!=Channels; ++c)
+                f(c, planes_[c]);
+}
+
+template <typename T, int Channels>
+inline auto planar_image<T, Channels>::fill(pixel_type const &val) -> void {
+        fill(execution::seq, val);
+}
+
+template <typename T, int Channels>
+template <typename ExecutionPolicy>
+inline auto planar_image<T, Channels>::fill(
+        ExecutionPolicy const &policy,
+        pixel_type const &val
+) -> execution::enable_if_execution_policy<ExecutionPolicy> {
+        for (int c=0; c!=Channels; ++c)
+                planes_[c].fill(policy, val[c]);
+}
+
+// -- free functions -----------------------------------------------------------
+
+template <typename T, int C>
+inline auto width (planar_image<T, C> const &canvas) -> int {
+        return canvas.width();
+}
+
+template <typename T, int C>
+inline auto height (planar_image<T, C> const &canvas) -> int {
+        return canvas.height();
+}
+
+template <typename T, int C>
+inline auto operator* (planar_image<T, C> canvas, double f)
+        -> planar_image<T, C>
+{
+        canvas *= f;
+        return canvas;
+}
+
+template <typename T, int C>
+inline auto operator* (double f, planar_image<T, C> canvas)
+        -> planar_image<T, C>
+{
+        canvas *= f;
+        return canvas;
+}
+
+template <typename T, int C>
+inline auto operator/ (planar_image<T, C> canvas, double f)
+        -> planar_image<T, C>
+{
+        canvas /= f;
+        return canvas;
+}
+
+template <typename T, int C>
+inline auto operator*= (planar_image<T, C> &canvas, double f)
+        -> planar_image<T, C>&
+{
+        canvas.for_each([f] (T &s) {
+                s = impl::channel_arith<T>::scale(s, f);
+        });
+        return canvas;
+}
+
+template <typename T, int C>
+inline auto operator/= (planar_image<T, C> &canvas, double f)
+        -> planar_image<T, C>&
+{
+        const double inv = 1.0 / f; // as basic_rgba's operator/
+        canvas.for_each([inv] (T &s) {
+                s = impl::channel_arith<T>::scale(s, inv);
+        });
+        return canvas;
+}
+
+template <typename T, int C>
+inline auto min (planar_image<T, C> canvas, double f) -> planar_image<T, C> {
+        const T v = impl::channel_arith<T>::from_unit(f);
+        canvas.for_each([v] (T &s) {
+                s = std::min(s, v);
+        });
+        return canvas;
+}
+
+template <typename T, int C>
+inline auto max (planar_image<T, C> canvas, double f) -> planar_image<T, C> {
+        const T v = impl::channel_arith<T>::from_unit(f);
+        canvas.for_each([v] (T &s) {
+                s = std::max(s, v);
+        });
+        return canvas;
+}
+
+// -- transforms ---------------------------------------------------------------
+// Each base_image transform of image.hh, applied to every plane.
+#define PUFFIN_PLANAR_TRANSFORM(name)                                          \
+template <typename ExecutionPolicy, typename T, int C>                         \
+inline auto name(ExecutionPolicy const &policy,                                \
+                 planar_image<T, C> const &canvas)                             \
+        -> execution::enable_if_execution_policy<ExecutionPolicy,              \
+                                                 planar_image<T, C>>           \
+{                                                                              \
+        std::vector<base_image<T>> planes;                                     \
+        planes.reserve(C);                                                     \
+        for (int c=0; c!=C; ++c)                                               \
+                planes.push_back(name(policy, canvas.plane(c)));               \
+        return planar_image<T, C>{std::move(planes)};                          \
+}                                                                              \
+                                                                               \
+template <typename T, int C>                                                   \
+inline auto name(planar_image<T, C> const &canvas) -> planar_image<T, C> {     \
+        return name(execution::seq, canvas);                                   \
+}
+PUFFIN_PLANAR_TRANSFORM(mirror_x)
+PUFFIN_PLANAR_TRANSFORM(mirror_y)
+PUFFIN_PLANAR_TRANSFORM(transpose)
+PUFFIN_PLANAR_TRANSFORM(rotate90cw)
+PUFFIN_PLANAR_TRANSFORM(rotate180cw)
+PUFFIN_PLANAR_TRANSFORM(rotate270cw)
+PUFFIN_PLANAR_TRANSFORM(rotate90ccw)
+PUFFIN_PLANAR_TRANSFORM(rotate180ccw)
+PUFFIN_PLANAR_TRANSFORM(rotate270ccw)
+#undef PUFFIN_PLANAR_TRANSFORM
+
+#define PUFFIN_PLANAR_INPLACE(name)                                            \
+template <typename ExecutionPolicy, typename T, int C>                         \
+inline auto name(ExecutionPolicy const &policy, planar_image<T, C> &canvas)    \
+        -> execution::enable_if_execution_policy<ExecutionPolicy>              \
+{                                                                              \
+        canvas.for_each_plane([&] (int, base_image<T> &plane) {                \
+                name(policy, plane);                                           \
+        });                                                                    \
+}                                                                              \
+                                                                               \
+template <typename T, int C>                                                   \
+inline void name(planar_image<T, C> &canvas) {                                 \
+        name(execution::seq, canvas);                                          \
+}
+PUFFIN_PLANAR_INPLACE(mirror_x_inplace)
+PUFFIN_PLANAR_INPLACE(mirror_y_inplace)
+PUFFIN_PLANAR_INPLACE(transpose_inplace)
+PUFFIN_PLANAR_INPLACE(rotate180cw_inplace)
+PUFFIN_PLANAR_INPLACE(rotate180ccw_inplace)
+#undef PUFFIN_PLANAR_INPLACE
+
+template <typename ExecutionPolicy, typename T, int C>
+inline auto copy(ExecutionPolicy const &policy,
+                 planar_image<T, C> const &canvas,
+                 Rect const &rect)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 planar_image<T, C>>
+{
+        std::vector<base_image<T>> planes;
+        planes.reserve(C);
+        for (int c=0; c!=C; ++c)
+                planes.push_back(copy(policy, canvas.plane(c), rect));
+        return planar_image<T, C>{std::move(planes)};
+}
+
+template <typename T, int C>
+inline auto copy(planar_image<T, C> const &canvas, Rect const &rect)
+        -> planar_image<T, C>
+{
+        return copy(execution::seq, canvas, rect);
+}
+
+// -- conversion ---------------------------------------------------------------
+namespace impl {
+// Generic rows go through the channel accessors; 8 and 16 bit channels,
+// whose basic_rgba is laid out as four consecutive scalars, use the SSE2
+// kernels of interleave.hh.
+template <typename S>
+inline void deinterleave_row(
+        basic_rgba<S, S, S, S> const *src,
+        S *r, S *g, S *b, S *a,
+        int n
+) {
+        for (int i=0; i!=n; ++i) {
+                r[i] = src[i].r();
+                g[i] = src[i].g();
+                b[i] = src[i].b();
+                a[i] = src[i].a();
+        }
+}
+
+template <typename S>
+inline void interleave_row(
+        S const *r, S const *g, S const *b, S const *a,
+        basic_rgba<S, S, S, S> *dst,
+        int n
+) {
+        for (int i=0; i!=n; ++i)
+                dst[i] = basic_rgba<S, S, S, S>(r[i], g[i], b[i], a[i]);
+}
+
+static_assert(sizeof(Color32) == 4 && sizeof(Color64) == 8,
+              "Color32/Color64 must be four packed channels");
+
+inline void deinterleave_row(
+        Color32 const *src,
+        uint8_t *r, uint8_t *g, uint8_t *b, uint8_t *a,
+        int n
+) {
+        deinterleave4(reinterpret_cast<uint8_t const*>(src), r, g, b, a, n);
+}
+
+inline void interleave_row(
+        uint8_t const *r, uint8_t const *g, uint8_t const *b, uint8_t const *a,
+        Color32 *dst,
+        int n
+) {
+        interleave4(r, g, b, a, reinterpret_cast<uint8_t*>(dst), n);
+}
+
+inline void deinterleave_row(
+        Color64 const *src,
+        uint16_t *r, uint16_t *g, uint16_t *b, uint16_t *a,
+        int n
+) {
+        deinterleave4(reinterpret_cast<uint16_t const*>(src), r, g, b, a, n);
+}
+
+inline void interleave_row(
+        uint16_t const *r, uint16_t const *g,
+        uint16_t const *b, uint16_t const *a,
+        Color64 *dst,
+        int n
+) {
+        interleave4(r, g, b, a, reinterpret_cast<uint16_t*>(dst), n);
+}
+}
+
+template <typename S>
+inline auto deinterleave(base_image<basic_rgba<S, S, S, S>> const &canvas)
+        -> planar_image<S, 4>
+{
+        return deinterleave(execution::seq, canvas);
+}
+
+template <typename ExecutionPolicy, typename S>
+inline auto deinterleave(
+        ExecutionPolicy const &policy,
+        base_image<basic_rgba<S, S, S, S>> const &canvas
+) -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                           planar_image<S, 4>>
+{
+        planar_image<S, 4> ret {canvas.width(), canvas.height()};
+        impl::for_each_band(policy, canvas.height(),
+                            canvas.stride() * sizeof(basic_rgba<S, S, S, S>),
+                            1, [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        impl::deinterleave_row(canvas.row(y),
+                                               ret.plane(0).row(y),
+                                               ret.plane(1).row(y),
+                                               ret.plane(2).row(y),
+                                               ret.plane(3).row(y),
+                                               canvas.width());
+                }
+        });
+        return ret;
+}
+
+template <typename S>
+inline auto interleave(planar_image<S, 4> const &canvas)
+        -> base_image<basic_rgba<S, S, S, S>>
+{
+        return interleave(execution::seq, canvas);
+}
+
+template <typename ExecutionPolicy, typename S>
+inline auto interleave(
+        ExecutionPolicy const &policy,
+        planar_image<S, 4> const &canvas
+) -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                           base_image<basic_rgba<S, S, S, S>>>
+{
+        base_image<basic_rgba<S, S, S, S>> ret {canvas.width(),
+                                                canvas.height()};
+        impl::for_each_band(policy, canvas.height(),
+                            ret.stride() * sizeof(basic_rgba<S, S, S, S>),
+                            1, [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y) {
+                        impl::interleave_row(canvas.plane(0).row(y),
+                                             canvas.plane(1).row(y),
+                                             canvas.plane(2).row(y),
+                                             canvas.plane(3).row(y),
+                                             ret.row(y),
+                                             canvas.width());
+                }
+        });
+        return ret;
+}
+
+}
+
+#endif //PLANAR_IMAGE_HH_INCLUDED_20261018
@@ -0,0 +1,230 @@
+#ifndef RESIZE_HH_INCLUDED_20261018
+#define RESIZE_HH_INCLUDED_20261018
+
+#include "image.hh"
+#include "image_view.hh"
+#include "execution.hh"
+#include "impl/contract.hh"
+#include "impl/resample.hh"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace puffin {
+
+// -- ResizeKernel -------------------------------------------------------------
+// The reconstruction filter of resize().
+//
+// - Box: the average of the source pixels a target pixel covers; nearest
+//   neighbour when magnifying.
+// - Bilinear: the tent filter (support 1).
+// - Bicubic: the Catmull-Rom spline, cubic convolution with a = -0.5
+//   (support 2).
+// - Lanczos3: sinc windowed by sinc(x/3) (support 3). The sharpest, at the
+//   cost of slight ringing at hard edges.
+//
+// The support is in target pixels when minifying, so that every source
+// pixel contributes: halving the size with Lanczos3 reads 12 source pixels
+// per target pixel and axis.
+enum class ResizeKernel {
+        Box,
+        Bilinear,
+        Bicubic,
+        Lanczos3
+};
+
+// -- resize -------------------------------------------------------------------
+// Resamples src to width x height pixels with kernel, in two separable
+// passes: first each needed source row to the target width, then the
+// columns of that to the target height. Skips the pass for an axis whose
+// size does not change. Weights are computed once per target column and
+// row.
+//
+// Color32 and Color64, in either channel order, are filtered with SSE2
+// (see impl/resample.hh). The intermediate result has the pixel type of
+// src. With an execution policy, both passes run in bands of rows.
+template <typename T>
+inline base_image<T> resize(image_view<T> const &src, int width, int height,
+                            ResizeKernel kernel = ResizeKernel::Bicubic);
+
+template <typename T>
+inline base_image<T> resize(base_image<T> const &src, int width, int height,
+                            ResizeKernel kernel = ResizeKernel::Bicubic);
+
+template <typename ExecutionPolicy, typename T>
+inline auto resize(ExecutionPolicy const &,
+                   image_view<T> const &src, int width, int height,
+                   ResizeKernel kernel = ResizeKernel::Bicubic)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+
+template <typename ExecutionPolicy, typename T>
+inline auto resize(ExecutionPolicy const &,
+                   base_image<T> const &src, int width, int height,
+                   ResizeKernel kernel = ResizeKernel::Bicubic)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+inline double resize_sinc(double x) {
+        if (x == 0)
+                return 1;
+        x *= 3.14159265358979323846;
+        return std::sin(x) / x;
+}
+
+inline resample_weights make_resize_weights(int src, int dst,
+                                            ResizeKernel kernel) {
+        switch (kernel) {
+        case ResizeKernel::Box:
+                return make_resample_weights(src, dst, 0.5, [] (double x) {
+                        return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+                });
+        case ResizeKernel::Bilinear:
+                return make_resample_weights(src, dst, 1.0, [] (double x) {
+                        x = std::abs(x);
+                        return x < 1 ? 1 - x : 0.0;
+                });
+        case ResizeKernel::Bicubic:
+                return make_resample_weights(src, dst, 2.0, [] (double x) {
+                        constexpr double a = -0.5;
+                        x = std::abs(x);
+                        if (x < 1)
+                                return ((a + 2) * x - (a + 3)) * x * x + 1;
+                        if (x < 2)
+                                return ((a * x - 5 * a) * x + 8 * a) * x
+                                       - 4 * a;
+                        return 0.0;
+                });
+        case ResizeKernel::Lanczos3:
+        default:
+                return make_resample_weights(src, dst, 3.0, [] (double x) {
+                        return x > -3 && x < 3
+                                ? resize_sinc(x) * resize_sinc(x / 3)
+                                : 0.0;
+                });
+        }
+}
+
+// The rows of dst from those of src, resampled horizontally.
+template <typename ExecutionPolicy, typename T>
+inline void resize_rows(
+        ExecutionPolicy const &policy,
+        image_view<T> const &src, int first_row,
+        base_image<T> &dst,
+        resample_weights const &w
+) {
+        for_each_band(policy, dst.height(),
+                      (src.stride() + dst.stride()) * sizeof(T), 1,
+                      [&] (int y0, int y1) {
+                for (int y=y0; y!=y1; ++y)
+                        resample_row(src.row(first_row + y), dst.row(y),
+                                     dst.width(), w);
+        });
+}
+
+// The rows of dst from the columns of src, resampled vertically; row 0 of
+// src is source row first_row.
+template <typename ExecutionPolicy, typename T>
+inline void resize_columns(
+        ExecutionPolicy const &policy,
+        image_view<T> const &src, int first_row,
+        base_image<T> &dst,
+        resample_weights const &w
+) {
+        for_each_band(policy, dst.height(),
+                      w.taps * src.stride() * sizeof(T), 1,
+                      [&] (int y0, int y1) {
+                std::vector<T const*> rows(w.taps);
+                for (int y=y0; y!=y1; ++y) {
+                        for (int k=0; k!=w.count[y]; ++k)
+                                rows[k] = src.row(w.first[y] - first_row + k);
+                        resample_column(rows.data(), w.count[y],
+                                        w.real_at(y), w.fixed_at(y),
+                                        dst.row(y), dst.width());
+                }
+        });
+}
+
+} }
+
+namespace puffin {
+
+template <typename ExecutionPolicy, typename T>
+inline auto resize(ExecutionPolicy const &policy,
+                   image_view<T> const &src, int width, int height,
+                   ResizeKernel kernel)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        impl::greater_than(src.width(), 0);
+        impl::greater_than(src.height(), 0);
+        impl::greater_than(width, 0);
+        impl::greater_than(height, 0);
+
+        base_image<T> ret{width, height};
+        const bool horizontal = width != src.width();
+        const bool vertical = height != src.height();
+
+        if (!vertical) {
+                if (horizontal) {
+                        impl::resize_rows(policy, src, 0, ret,
+                                impl::make_resize_weights(
+                                        src.width(), width, kernel));
+                } else {
+                        for (int y=0; y!=height; ++y)
+                                impl::copy_n(src.row(y), width, ret.row(y));
+                }
+                return ret;
+        }
+
+        const impl::resample_weights wy =
+                impl::make_resize_weights(src.height(), height, kernel);
+        if (!horizontal) {
+                impl::resize_columns(policy, src, 0, ret, wy);
+                return ret;
+        }
+
+        // Only the source rows that the vertical pass reads.
+        const int first = wy.first.front();
+        const int last = wy.first.back() + wy.count.back();
+        base_image<T> tmp{width, last - first};
+        impl::resize_rows(policy, src, first, tmp,
+                          impl::make_resize_weights(src.width(), width,
+                                                    kernel));
+        impl::resize_columns(policy, image_view<T>{tmp}, first, ret, wy);
+        return ret;
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto resize(ExecutionPolicy const &policy,
+                   base_image<T> const &src, int width, int height,
+                   ResizeKernel kernel)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        return resize(policy, image_view<T>{src}, width, height, kernel);
+}
+
+template <typename T>
+inline base_image<T> resize(image_view<T> const &src, int width, int height,
+                            ResizeKernel kernel) {
+        return resize(execution::seq, src, width, height, kernel);
+}
+
+template <typename T>
+inline base_image<T> resize(base_image<T> const &src, int width, int height,
+                            ResizeKernel kernel) {
+        return resize(execution::seq, image_view<T>{src}, width, height,
+                      kernel);
+}
+
+}
+
+#endif //RESIZE_HH_INCLUDED_20261018
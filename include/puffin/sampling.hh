@@ -0,0 +1,517 @@
+#ifndef SAMPLING_HH_INCLUDED_20261018
+#define SAMPLING_HH_INCLUDED_20261018
+
+#include "coords.hh"
+#include "color_ops.hh"
+#include "impl/algorithm.hh"
+#include "impl/compiler.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin {
+
+// -- Filtering ----------------------------------------------------------------
+enum class Filtering {
+        Nearest,
+        Bilinear,
+        Trilinear, // between mip levels; bilinear on a single image
+        // TODO: Anisotropic
+};
+
+// -- Sampler<F, WrapX, WrapY> -------------------------------------------------
+// Samples images at texture coordinates (u, v), where [0, 1) spans the
+// image, with filtering and wrapping fixed at compile time. ImageFilter
+// selects the matching Sampler for its runtime settings; code that samples
+// in a loop can do so once with visit_sampler() (or ImageFilter::visit())
+// and call the Sampler directly.
+//
+// Texel indices are wrapped once per axis and sample. Wrap on a power of
+// two size masks the index, which needs no division; other sizes and modes
+// use impl::wrap(), impl::mirror() and impl::clamp(). Texels are then read
+// without bounds checks: through row pointers for base_image, through
+// texel(x, y) for images that are not stored in rows (tiled_image).
+//
+// Nearest rounds u*width (v*height) to the nearest texel, ties up.
+// Bilinear interpolates between the texels at floor(u*width) and the one
+// after, and likewise for v. Trilinear is Bilinear, as an image has only
+// one level (see mip_chain in mipmap.hh).
+template <Filtering F, Wrapping WrapX = Wrapping::Wrap, Wrapping WrapY = WrapX>
+struct Sampler {
+        static constexpr Filtering filtering = F;
+        static constexpr Wrapping wrapping_x = WrapX;
+        static constexpr Wrapping wrapping_y = WrapY;
+
+        template<typename ImageT>
+        auto operator()(
+                ImageT const &img,
+                double u, double v
+        ) const noexcept -> typename ImageT::value_type;
+
+        // out[i] = (*this)(img, u[i], v[i]) for i < n, with the coordinates
+        // computed in float, several samples at a time.
+        template<typename ImageT>
+        void sample(
+                ImageT const &img,
+                float const *u, float const *v, std::size_t n,
+                typename ImageT::value_type *out
+        ) const noexcept;
+
+        // As sample(), for the n points (u0 + i*du, v0 + i*dv) of a line,
+        // e.g. a scanline of a textured span.
+        template<typename ImageT>
+        void sample_span(
+                ImageT const &img,
+                float u0, float v0, float du, float dv, std::size_t n,
+                typename ImageT::value_type *out
+        ) const noexcept;
+};
+
+// -- visit_sampler ------------------------------------------------------------
+// Calls fn with the Sampler for the given runtime settings and returns its
+// result, e.g.
+//
+//   visit_sampler(f, wx, wy, [&] (auto sampler) {
+//           for (...)
+//                   ... sampler(img, u, v) ...
+//   });
+//
+// All Samplers are instantiated, so fn must compile for each of them.
+template <typename Fn>
+inline auto visit_sampler(Filtering f, Wrapping wx, Wrapping wy, Fn &&fn);
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+// -- with_filtering, with_wrapping --------------------------------------------
+// Call fn with a std::integral_constant for the given runtime value, so that
+// fn can instantiate code for it. Trilinear maps to Bilinear.
+template <typename Fn>
+inline auto with_filtering(Filtering f, Fn &&fn) {
+        switch (f) {
+        case Filtering::Bilinear:
+        case Filtering::Trilinear:
+                return fn(std::integral_constant<Filtering,
+                                                 Filtering::Bilinear>{});
+        case Filtering::Nearest:
+        default:
+                return fn(std::integral_constant<Filtering,
+                                                 Filtering::Nearest>{});
+        }
+}
+
+template <typename Fn>
+inline auto with_wrapping(Wrapping w, Fn &&fn) {
+        switch (w) {
+        case Wrapping::Mirror:
+                return fn(std::integral_constant<Wrapping, Wrapping::Mirror>{});
+        case Wrapping::Clamp:
+                return fn(std::integral_constant<Wrapping, Wrapping::Clamp>{});
+        case Wrapping::Wrap:
+        default:
+                return fn(std::integral_constant<Wrapping, Wrapping::Wrap>{});
+        }
+}
+
+// -- axis_wrap<W> -------------------------------------------------------------
+// Maps texel indices to [0, size) as CoordWrapper does along one axis.
+// mask() is size-1 if indices can be wrapped by masking, -1 otherwise.
+template <Wrapping W>
+struct axis_wrap;
+
+template <>
+struct axis_wrap<Wrapping::Wrap> {
+        explicit axis_wrap(int size) noexcept :
+                size_{size},
+                mask_{(size & (size - 1)) == 0 ? size - 1 : -1}
+        {}
+
+        int operator()(int i) const noexcept {
+                return mask_ >= 0 ? i & mask_ : wrap(i, size_ - 1);
+        }
+
+        int size() const noexcept { return size_; }
+        int mask() const noexcept { return mask_; }
+private:
+        int size_, mask_;
+};
+
+template <>
+struct axis_wrap<Wrapping::Mirror> {
+        explicit axis_wrap(int size) noexcept : size_{size} {}
+
+        int operator()(int i) const noexcept {
+                return mirror(i, size_ - 1);
+        }
+
+        int size() const noexcept { return size_; }
+        int mask() const noexcept { return -1; }
+private:
+        int size_;
+};
+
+template <>
+struct axis_wrap<Wrapping::Clamp> {
+        explicit axis_wrap(int size) noexcept : size_{size} {}
+
+        int operator()(int i) const noexcept {
+                return clamp(i, size_ - 1);
+        }
+
+        int size() const noexcept { return size_; }
+        int mask() const noexcept { return -1; }
+private:
+        int size_;
+};
+
+// -- texel_at -----------------------------------------------------------------
+// The texel at (x, y), which must be inside img.
+template <typename ImageT>
+inline auto texel_at(ImageT const &img, int x, int y) noexcept
+        -> decltype(img.row(y)[x])
+{
+        return img.row(y)[x];
+}
+
+template <typename ImageT>
+inline auto texel_at(ImageT const &img, int x, int y) noexcept
+        -> decltype(img.texel(x, y))
+{
+        return img.texel(x, y);
+}
+
+// -- axis_taps ----------------------------------------------------------------
+// For n coordinates t along an axis: the index i0 of the texel to read
+// and, if Linear, the index i1 of its right (lower) neighbour and the
+// weight frac of i1.
+//
+// The SSE2 path computes four samples at a time: t*size, floor and
+// fraction in float, then either masks the indices or, if all four (and
+// their neighbours) are inside the image, leaves them as they are. Other
+// groups are wrapped index by index.
+template <bool Linear, Wrapping W>
+inline void axis_taps_scalar(
+        float const *t, int n, axis_wrap<W> const &wrap,
+        int *i0, int *i1, float *frac
+) {
+        const float s = static_cast<float>(wrap.size());
+        for (int k=0; k!=n; ++k) {
+                const float x = t[k] * s + (Linear ? 0.f : 0.5f);
+                const float xf = std::floor(x);
+                i0[k] = wrap(static_cast<int>(xf));
+                if (Linear) {
+                        i1[k] = wrap(static_cast<int>(xf) + 1);
+                        frac[k] = x - xf;
+                }
+        }
+}
+
+template <bool Linear, Wrapping W>
+inline void axis_taps(
+        float const *t, int n, axis_wrap<W> const &wrap,
+        int *i0, int *i1, float *frac
+) {
+        int k = 0;
+#if PUFFIN_HAS_SSE2
+        const int size = wrap.size();
+        const __m128 s = _mm_set1_ps(static_cast<float>(size));
+        const __m128 bias = _mm_set1_ps(Linear ? 0.f : 0.5f);
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i mask = _mm_set1_epi32(wrap.mask());
+        const bool masked = wrap.mask() >= 0;
+        // No wrapping needed for -1 < i0 < last (with the neighbour: i0+1
+        // < size).
+        const __m128i below_first = _mm_set1_epi32(-1);
+        const __m128i last = _mm_set1_epi32(Linear ? size - 1 : size);
+        for (; k+4 <= n; k+=4) {
+                const __m128 x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(t + k), s),
+                                            bias);
+                // floor(x): truncate, then step down where that rounded up.
+                const __m128i xt = _mm_cvttps_epi32(x);
+                const __m128 up = _mm_cmplt_ps(x, _mm_cvtepi32_ps(xt));
+                const __m128i xi = _mm_add_epi32(xt, _mm_castps_si128(up));
+                if (Linear)
+                        _mm_storeu_ps(frac + k,
+                                      _mm_sub_ps(x, _mm_cvtepi32_ps(xi)));
+
+                if (masked) {
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(i0 + k),
+                                         _mm_and_si128(xi, mask));
+                        if (Linear)
+                                _mm_storeu_si128(
+                                        reinterpret_cast<__m128i*>(i1 + k),
+                                        _mm_and_si128(_mm_add_epi32(xi, one),
+                                                      mask));
+                        continue;
+                }
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(i0 + k), xi);
+                if (Linear)
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(i1 + k),
+                                         _mm_add_epi32(xi, one));
+                const __m128i inside = _mm_and_si128(
+                        _mm_cmpgt_epi32(xi, below_first),
+                        _mm_cmplt_epi32(xi, last));
+                if (_mm_movemask_epi8(inside) != 0xFFFF) {
+                        for (int j=k; j!=k+4; ++j) {
+                                i0[j] = wrap(i0[j]);
+                                if (Linear)
+                                        i1[j] = wrap(i1[j]);
+                        }
+                }
+        }
+#endif
+        axis_taps_scalar<Linear>(t + k, n - k, wrap,
+                                 i0 + k, i1 + k, frac + k);
+}
+
+// -- bilerp -------------------------------------------------------------------
+// The bilinear blend of the texels c00 (top left), c10, c01 and c11 (bottom
+// right) with weights fx, fy in [0, 1] of the right and lower texels.
+//
+// Generic pixels use lerp(). Color32 and Color64, in either channel order,
+// avoid the three rounded lerps and stay within 1 of the exactly rounded
+// result:
+//
+// - 8 bit channels: fx and fy are quantized to 8 fractional bits (8.8).
+//   The horizontal blends c0*(256-wx) + c1*wx fit into 16 bit lanes; they
+//   are halved, so that the vertical blend can multiply-add them as signed
+//   16 bit pairs, and rounded to 8 bits at the end.
+// - 16 bit channels would need weights wider than 16 bits for that, and
+//   SSE2 has no 32 bit multiply; they are blended in single precision
+//   instead, with the four weights computed once per pixel.
+//
+// The SSE2 kernels blend one pixel per call, all four channels and both
+// rows at once. They compute the same values as the scalar code.
+template <typename T>
+inline T bilerp(T const &c00, T const &c10, T const &c01, T const &c11,
+                float fx, float fy) {
+        return lerp(lerp(c00, c10, fx), lerp(c01, c11, fx), fy);
+}
+
+inline int fixed_weight(float f, int one) {
+        return static_cast<int>(f * one + 0.5f);
+}
+
+template <typename O>
+inline rgba8<O> bilerp(rgba8<O> const &c00, rgba8<O> const &c10,
+                       rgba8<O> const &c01, rgba8<O> const &c11,
+                       float fx, float fy) {
+        const int wx = fixed_weight(fx, 256), wy = fixed_weight(fy, 256);
+#if PUFFIN_HAS_SSE2
+        const auto load = [] (rgba8<O> const &c) {
+                int32_t bits;
+                std::memcpy(&bits, &c, sizeof bits);
+                return _mm_cvtsi32_si128(bits);
+        };
+        const __m128i zero = _mm_setzero_si128();
+        // [c00 | c01] and [c10 | c11] as 16 bit channels.
+        const __m128i left = _mm_unpacklo_epi8(
+                _mm_unpacklo_epi32(load(c00), load(c01)), zero);
+        const __m128i right = _mm_unpacklo_epi8(
+                _mm_unpacklo_epi32(load(c10), load(c11)), zero);
+        // [top | bottom], halved.
+        const __m128i h = _mm_srli_epi16(_mm_add_epi16(
+                _mm_mullo_epi16(left, _mm_set1_epi16(int16_t(256 - wx))),
+                _mm_mullo_epi16(right, _mm_set1_epi16(int16_t(wx)))), 1);
+        // (top, bottom) pairs per channel, times (256-wy, wy).
+        const __m128i tb = _mm_unpacklo_epi16(h, _mm_srli_si128(h, 8));
+        const __m128i v = _mm_srli_epi32(_mm_add_epi32(
+                _mm_madd_epi16(tb, _mm_set1_epi32((wy << 16) | (256 - wy))),
+                _mm_set1_epi32(1 << 14)), 15);
+        const __m128i px = _mm_packus_epi16(_mm_packs_epi32(v, v), zero);
+        const int32_t bits = _mm_cvtsi128_si32(px);
+        rgba8<O> ret;
+        std::memcpy(static_cast<void*>(&ret), &bits, sizeof ret);
+        return ret;
+#else
+        const auto channel = [&] (int a, int b, int c, int d) {
+                const int top = (a * (256 - wx) + b * wx) >> 1;
+                const int bottom = (c * (256 - wx) + d * wx) >> 1;
+                return uint8_t((top * (256 - wy) + bottom * wy
+                                + (1 << 14)) >> 15);
+        };
+        return rgba8<O>(channel(c00.r(), c10.r(), c01.r(), c11.r()),
+                        channel(c00.g(), c10.g(), c01.g(), c11.g()),
+                        channel(c00.b(), c10.b(), c01.b(), c11.b()),
+                        channel(c00.a(), c10.a(), c01.a(), c11.a()));
+#endif
+}
+
+template <typename O>
+inline rgba16<O> bilerp(rgba16<O> const &c00, rgba16<O> const &c10,
+                        rgba16<O> const &c01, rgba16<O> const &c11,
+                        float fx, float fy) {
+        const float
+                w00 = (1.f - fx) * (1.f - fy), w10 = fx * (1.f - fy),
+                w01 = (1.f - fx) * fy,         w11 = fx * fy;
+#if PUFFIN_HAS_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const auto load = [&] (rgba16<O> const &c) {
+                return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(
+                        reinterpret_cast<__m128i const*>(&c)), zero));
+        };
+        __m128 v = _mm_mul_ps(load(c00), _mm_set1_ps(w00));
+        v = _mm_add_ps(v, _mm_mul_ps(load(c10), _mm_set1_ps(w10)));
+        v = _mm_add_ps(v, _mm_mul_ps(load(c01), _mm_set1_ps(w01)));
+        v = _mm_add_ps(v, _mm_mul_ps(load(c11), _mm_set1_ps(w11)));
+        const __m128i r = round_clamped(v, 65535.f);
+        rgba16<O> ret;
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&ret),
+                         packus_epi32_sse2(r, r));
+        return ret;
+#else
+        const auto channel = [&] (float a, float b, float c, float d) {
+                return channel_arith<uint16_t>::from_real(
+                        a * w00 + b * w10 + c * w01 + d * w11);
+        };
+        return rgba16<O>(channel(c00.r(), c10.r(), c01.r(), c11.r()),
+                         channel(c00.g(), c10.g(), c01.g(), c11.g()),
+                         channel(c00.b(), c10.b(), c01.b(), c11.b()),
+                         channel(c00.a(), c10.a(), c01.a(), c11.a()));
+#endif
+}
+
+// -- sample_n, sample_span ----------------------------------------------------
+// Samples are processed in batches: first the taps of both axes are
+// computed for the whole batch, then the texels are fetched and blended.
+constexpr int sample_batch = 64;
+
+template <Filtering F, Wrapping WX, Wrapping WY, typename ImageT>
+inline void sample_n(
+        ImageT const &img,
+        float const *u, float const *v, std::size_t n,
+        typename ImageT::value_type *out
+) {
+        constexpr bool linear = F != Filtering::Nearest;
+        const axis_wrap<WX> wrap_x{img.width()};
+        const axis_wrap<WY> wrap_y{img.height()};
+        int x0[sample_batch], x1[sample_batch], y0[sample_batch],
+            y1[sample_batch];
+        float fx[sample_batch], fy[sample_batch];
+
+        for (std::size_t b=0; b<n; b+=sample_batch) {
+                const int m = static_cast<int>(
+                        std::min<std::size_t>(sample_batch, n - b));
+                axis_taps<linear>(u + b, m, wrap_x, x0, x1, fx);
+                axis_taps<linear>(v + b, m, wrap_y, y0, y1, fy);
+
+                auto *dst = out + b;
+                for (int k=0; k!=m; ++k) {
+                        if (!linear) {
+                                dst[k] = texel_at(img, x0[k], y0[k]);
+                                continue;
+                        }
+                        dst[k] = bilerp(texel_at(img, x0[k], y0[k]),
+                                        texel_at(img, x1[k], y0[k]),
+                                        texel_at(img, x0[k], y1[k]),
+                                        texel_at(img, x1[k], y1[k]),
+                                        fx[k], fy[k]);
+                }
+        }
+}
+
+template <Filtering F, Wrapping WX, Wrapping WY, typename ImageT>
+inline void sample_span(
+        ImageT const &img,
+        float u0, float v0, float du, float dv, std::size_t n,
+        typename ImageT::value_type *out
+) {
+        float u[sample_batch], v[sample_batch];
+        for (std::size_t b=0; b<n; b+=sample_batch) {
+                const int m = static_cast<int>(
+                        std::min<std::size_t>(sample_batch, n - b));
+                for (int k=0; k!=m; ++k) {
+                        const float i = static_cast<float>(b + k);
+                        u[k] = u0 + i * du;
+                        v[k] = v0 + i * dv;
+                }
+                sample_n<F, WX, WY>(img, u, v, m, out + b);
+        }
+}
+
+} }
+
+namespace puffin {
+
+template <Filtering F, Wrapping WrapX, Wrapping WrapY>
+template <typename ImageT>
+inline auto Sampler<F, WrapX, WrapY>::operator()(
+        ImageT const &img,
+        double u, double v
+) const noexcept -> typename ImageT::value_type {
+        const impl::axis_wrap<WrapX> wrap_x{img.width()};
+        const impl::axis_wrap<WrapY> wrap_y{img.height()};
+        const double fx = u * img.width();
+        const double fy = v * img.height();
+
+        if (F == Filtering::Nearest) {
+                const int x = static_cast<int>(std::floor(fx + 0.5));
+                const int y = static_cast<int>(std::floor(fy + 0.5));
+                return impl::texel_at(img, wrap_x(x), wrap_y(y));
+        }
+
+        const double ix = std::floor(fx), iy = std::floor(fy);
+        const float
+                frac_x = static_cast<float>(fx - ix),
+                frac_y = static_cast<float>(fy - iy);
+        const int
+                x0 = wrap_x(static_cast<int>(ix)),
+                x1 = wrap_x(static_cast<int>(ix) + 1),
+                y0 = wrap_y(static_cast<int>(iy)),
+                y1 = wrap_y(static_cast<int>(iy) + 1);
+
+        return impl::bilerp(impl::texel_at(img, x0, y0),
+                            impl::texel_at(img, x1, y0),
+                            impl::texel_at(img, x0, y1),
+                            impl::texel_at(img, x1, y1),
+                            frac_x, frac_y);
+}
+
+template <Filtering F, Wrapping WrapX, Wrapping WrapY>
+template <typename ImageT>
+inline void Sampler<F, WrapX, WrapY>::sample(
+        ImageT const &img,
+        float const *u, float const *v, std::size_t n,
+        typename ImageT::value_type *out
+) const noexcept {
+        impl::sample_n<F, WrapX, WrapY>(img, u, v, n, out);
+}
+
+template <Filtering F, Wrapping WrapX, Wrapping WrapY>
+template <typename ImageT>
+inline void Sampler<F, WrapX, WrapY>::sample_span(
+        ImageT const &img,
+        float u0, float v0, float du, float dv, std::size_t n,
+        typename ImageT::value_type *out
+) const noexcept {
+        impl::sample_span<F, WrapX, WrapY>(img, u0, v0, du, dv, n, out);
+}
+
+template <typename Fn>
+inline auto visit_sampler(Filtering f, Wrapping wx, Wrapping wy, Fn &&fn) {
+        return impl::with_filtering(f, [&] (auto fc) {
+                return impl::with_wrapping(wx, [&] (auto wxc) {
+                        return impl::with_wrapping(wy, [&] (auto wyc) {
+                                return fn(Sampler<decltype(fc)::value,
+                                                  decltype(wxc)::value,
+                                                  decltype(wyc)::value>{});
+                        });
+                });
+        });
+}
+
+}
+
+#endif //SAMPLING_HH_INCLUDED_20261018
@@ -0,0 +1,470 @@
+#ifndef STATISTICS_HH_INCLUDED_20261018
+#define STATISTICS_HH_INCLUDED_20261018
+
+#include "color.hh"
+#include "color_ops.hh"
+#include "execution.hh"
+#include "image.hh"
+#include "image_view.hh"
+#include "impl/compiler.hh"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if PUFFIN_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace puffin {
+
+// -- Histogram ----------------------------------------------------------------
+// Per channel pixel counts of an 8 bit image: r[v] pixels have a red
+// channel of v, and so on, whatever the channel order of the pixels.
+struct Histogram {
+        uint64_t r[256];
+        uint64_t g[256];
+        uint64_t b[256];
+        uint64_t a[256];
+
+        Histogram() : r(), g(), b(), a() {}
+};
+
+// -- histogram ----------------------------------------------------------------
+// The Histogram of src (Color32 or Color32Bgra). With an execution policy,
+// bands of rows are counted separately and their counts added up.
+//
+// Consecutive pixels count into four sub-histograms in turn, merged at the
+// end, so that runs of equal pixels (flat areas, borders, alpha) increment
+// different counters instead of each waiting on the previous increment of
+// the same one.
+template <typename O>
+inline Histogram histogram(image_view<impl::rgba8<O>> const &src);
+template <typename O>
+inline Histogram histogram(base_image<impl::rgba8<O>> const &src);
+
+template <typename ExecutionPolicy, typename O>
+inline auto histogram(ExecutionPolicy const &,
+                      image_view<impl::rgba8<O>> const &src)
+        -> execution::enable_if_execution_policy<ExecutionPolicy, Histogram>;
+template <typename ExecutionPolicy, typename O>
+inline auto histogram(ExecutionPolicy const &,
+                      base_image<impl::rgba8<O>> const &src)
+        -> execution::enable_if_execution_policy<ExecutionPolicy, Histogram>;
+
+// -- ImageStats ---------------------------------------------------------------
+// Moments of one channel of an image, in channel units (0..255 for Color32,
+// 0..65535 for Color64). All zero for an empty image.
+struct ChannelStats {
+        uint32_t min;
+        uint32_t max;
+        uint64_t sum;          // of the values
+        uint64_t sum_squares;  // of the squared values
+        double mean;
+        double variance;       // population variance, not sample variance
+
+        ChannelStats() :
+                min(0),
+                max(0),
+                sum(0),
+                sum_squares(0),
+                mean(0),
+                variance(0)
+        {}
+};
+
+struct ImageStats {
+        uint64_t pixels;
+        ChannelStats r, g, b, a;
+
+        ImageStats() : pixels(0) {}
+};
+
+// -- statistics ---------------------------------------------------------------
+// The ImageStats of src, for Color32 and Color64 (either channel order).
+// The sums are exact; sum_squares of Color64 holds images of up to 2^32
+// pixels.
+//
+// Rows are reduced with SSE2, with narrow lane accumulators widened every
+// 256 pixels. With an execution policy, bands of rows are reduced
+// separately and then combined, which gives the same result as seq.
+template <typename T>
+inline ImageStats statistics(image_view<T> const &src);
+template <typename T>
+inline ImageStats statistics(base_image<T> const &src);
+
+template <typename ExecutionPolicy, typename T>
+inline auto statistics(ExecutionPolicy const &, image_view<T> const &src)
+        -> execution::enable_if_execution_policy<ExecutionPolicy, ImageStats>;
+template <typename ExecutionPolicy, typename T>
+inline auto statistics(ExecutionPolicy const &, base_image<T> const &src)
+        -> execution::enable_if_execution_policy<ExecutionPolicy, ImageStats>;
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin { namespace impl {
+
+// -- reduce_bands -------------------------------------------------------------
+// Reduces the rows of an image of the given height: f(acc, y0, y1) adds rows
+// [y0, y1) to a zero Acc, then merge(into, from) combines the accumulators
+// of the bands in order. The bands are fixed by the row size alone, so the
+// result does not depend on the policy.
+template <typename Acc, typename ExecutionPolicy, typename F, typename M>
+inline Acc reduce_bands(ExecutionPolicy const &policy, int height,
+                        std::size_t row_bytes, F &&f, M &&merge) {
+        Acc ret;
+        if (height <= 0)
+                return ret;
+        if (max_threads(policy) == 1) {
+                f(ret, 0, height);
+                return ret;
+        }
+        const int rows = static_cast<int>(std::min<std::size_t>(
+                height, std::max<std::size_t>(
+                        1, parallel_band_bytes /
+                           std::max<std::size_t>(1, row_bytes))));
+        const int bands = (height + rows - 1) / rows;
+        std::vector<Acc> partial(bands);
+        for_each_band(policy, bands, rows * row_bytes, 1,
+                      [&] (int b0, int b1) {
+                for (int b=b0; b!=b1; ++b)
+                        f(partial[b], b * rows,
+                          std::min(height, (b + 1) * rows));
+        });
+        for (Acc const &p : partial)
+                merge(ret, p);
+        return ret;
+}
+
+// Which lane of a pixel in memory holds r, g, b and a.
+template <typename S, typename O>
+inline std::array<int, 4> channel_lanes(basic_rgba<S, S, S, S, O> const *) {
+        const basic_rgba<S, S, S, S, O> probe{0, 1, 2, 3};
+        S const *lanes = reinterpret_cast<S const*>(&probe);
+        std::array<int, 4> ret;
+        for (int lane=0; lane!=4; ++lane)
+                ret[lanes[lane]] = lane;
+        return ret;
+}
+
+// -- histogram ----------------------------------------------------------------
+// Counts per byte lane of the pixels in memory, in four sub-histograms
+// taken in turn by consecutive pixels. 16 KiB, so it stays in L1.
+struct histogram_bins {
+        uint32_t count[4][4][256]; // [sub-histogram][lane][value]
+
+        histogram_bins() : count() {}
+};
+
+template <typename O>
+inline void histogram_row(rgba8<O> const *in, std::size_t n,
+                          histogram_bins &bins) {
+        unsigned char const *p = reinterpret_cast<unsigned char const*>(in);
+        auto &c = bins.count;
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4, p += 16) {
+                for (int k=0; k!=4; ++k) {
+                        ++c[k][0][p[4*k]];
+                        ++c[k][1][p[4*k + 1]];
+                        ++c[k][2][p[4*k + 2]];
+                        ++c[k][3][p[4*k + 3]];
+                }
+        }
+        for (; i!=n; ++i, p += 4) {
+                for (int lane=0; lane!=4; ++lane)
+                        ++c[0][lane][p[lane]];
+        }
+}
+
+// Adds bins to ret and zeroes them.
+template <typename O>
+inline void flush_histogram(histogram_bins &bins, Histogram &ret) {
+        const std::array<int, 4> lanes =
+                channel_lanes(static_cast<rgba8<O> const*>(nullptr));
+        uint64_t *channels[4] = {ret.r, ret.g, ret.b, ret.a};
+        for (int c=0; c!=4; ++c) {
+                for (int v=0; v!=256; ++v) {
+                        uint64_t n = 0;
+                        for (int k=0; k!=4; ++k)
+                                n += bins.count[k][lanes[c]][v];
+                        channels[c][v] += n;
+                }
+        }
+        bins = histogram_bins{};
+}
+
+inline void merge_histogram(Histogram &into, Histogram const &from) {
+        for (int v=0; v!=256; ++v) {
+                into.r[v] += from.r[v];
+                into.g[v] += from.g[v];
+                into.b[v] += from.b[v];
+                into.a[v] += from.a[v];
+        }
+}
+
+// -- statistics ---------------------------------------------------------------
+// Running sums per lane of the pixels in memory.
+struct stats_sums {
+        uint64_t pixels;
+        uint32_t min[4], max[4];
+        uint64_t sum[4], sum_squares[4];
+
+        stats_sums() : pixels(0), sum(), sum_squares() {
+                std::fill_n(min, 4, UINT32_MAX);
+                std::fill_n(max, 4, 0);
+        }
+};
+
+template <typename S, typename O>
+inline void stats_row(basic_rgba<S, S, S, S, O> const *in, std::size_t n,
+                      stats_sums &s, ...) {
+        S const *p = reinterpret_cast<S const*>(in);
+        for (std::size_t i=0; i!=n; ++i, p += 4) {
+                for (int lane=0; lane!=4; ++lane) {
+                        const uint32_t v = p[lane];
+                        s.min[lane] = std::min(s.min[lane], v);
+                        s.max[lane] = std::max(s.max[lane], v);
+                        s.sum[lane] += v;
+                        s.sum_squares[lane] += uint64_t(v) * v;
+                }
+        }
+}
+
+#if PUFFIN_HAS_SSE2
+// Four pixels per register. Sums are kept in 16 bit lanes and squares in
+// 32 bit lanes (_mm_madd_epi16 on r and b, then g and a), which cannot
+// overflow within a block of 256 pixels.
+template <typename O>
+inline void stats_row(rgba8<O> const *in, std::size_t n, stats_sums &s,
+                      int) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i low_half = _mm_set1_epi32(0xffff);
+        __m128i mn = _mm_set1_epi8(-1), mx = zero;
+        const std::size_t simd = n & ~std::size_t(3);
+        std::size_t i = 0;
+        while (i != simd) {
+                const std::size_t end = std::min(simd, i + 256);
+                __m128i sum = zero, sq02 = zero, sq13 = zero;
+                for (; i!=end; i+=4) {
+                        const __m128i x = load_px(in + i);
+                        mn = _mm_min_epu8(mn, x);
+                        mx = _mm_max_epu8(mx, x);
+                        const __m128i lo = _mm_unpacklo_epi8(x, zero);
+                        const __m128i hi = _mm_unpackhi_epi8(x, zero);
+                        sum = _mm_add_epi16(sum, _mm_add_epi16(lo, hi));
+                        const __m128i lo02 = _mm_and_si128(lo, low_half);
+                        const __m128i hi02 = _mm_and_si128(hi, low_half);
+                        const __m128i lo13 = _mm_srli_epi32(lo, 16);
+                        const __m128i hi13 = _mm_srli_epi32(hi, 16);
+                        sq02 = _mm_add_epi32(sq02, _mm_add_epi32(
+                                _mm_madd_epi16(lo02, lo02),
+                                _mm_madd_epi16(hi02, hi02)));
+                        sq13 = _mm_add_epi32(sq13, _mm_add_epi32(
+                                _mm_madd_epi16(lo13, lo13),
+                                _mm_madd_epi16(hi13, hi13)));
+                }
+                uint16_t sums[8];
+                uint32_t squares[2][4];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(sums), sum);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(squares[0]),
+                                 sq02);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(squares[1]),
+                                 sq13);
+                for (int lane=0; lane!=4; ++lane) {
+                        uint32_t const *q = squares[lane & 1];
+                        const int k = lane >> 1;
+                        s.sum[lane] += uint32_t(sums[lane]) + sums[lane + 4];
+                        s.sum_squares[lane] += uint64_t(q[k]) + q[k + 2];
+                }
+        }
+        uint8_t mins[16], maxs[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mins), mn);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), mx);
+        for (int j=0; j!=16; ++j) {
+                s.min[j & 3] = std::min<uint32_t>(s.min[j & 3], mins[j]);
+                s.max[j & 3] = std::max<uint32_t>(s.max[j & 3], maxs[j]);
+        }
+        stats_row(in + i, n - i, s, nullptr);
+}
+
+// Two pixels per register. SSE2 has no unsigned 16 bit min and max, so
+// they run on the values biased into the signed range. Sums are kept in 32
+// bit lanes and squares (_mm_mul_epu32 on r and b, then g and a) in 64 bit
+// lanes.
+template <typename O>
+inline void stats_row(rgba16<O> const *in, std::size_t n, stats_sums &s,
+                      int) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16(-0x8000);
+        __m128i mn = _mm_set1_epi16(0x7fff), mx = bias;
+        const std::size_t simd = n & ~std::size_t(1);
+        std::size_t i = 0;
+        while (i != simd) {
+                const std::size_t end = std::min(simd, i + 256);
+                __m128i sum = zero, sq02 = zero, sq13 = zero;
+                for (; i!=end; i+=2) {
+                        const __m128i x = load_px(in + i);
+                        const __m128i biased = _mm_xor_si128(x, bias);
+                        mn = _mm_min_epi16(mn, biased);
+                        mx = _mm_max_epi16(mx, biased);
+                        const __m128i lo = _mm_unpacklo_epi16(x, zero);
+                        const __m128i hi = _mm_unpackhi_epi16(x, zero);
+                        sum = _mm_add_epi32(sum, _mm_add_epi32(lo, hi));
+                        const __m128i lo13 = _mm_srli_epi64(lo, 32);
+                        const __m128i hi13 = _mm_srli_epi64(hi, 32);
+                        sq02 = _mm_add_epi64(sq02, _mm_add_epi64(
+                                _mm_mul_epu32(lo, lo),
+                                _mm_mul_epu32(hi, hi)));
+                        sq13 = _mm_add_epi64(sq13, _mm_add_epi64(
+                                _mm_mul_epu32(lo13, lo13),
+                                _mm_mul_epu32(hi13, hi13)));
+                }
+                uint32_t sums[4];
+                uint64_t squares[2][2];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(sums), sum);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(squares[0]),
+                                 sq02);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(squares[1]),
+                                 sq13);
+                for (int lane=0; lane!=4; ++lane) {
+                        s.sum[lane] += sums[lane];
+                        s.sum_squares[lane] += squares[lane & 1][lane >> 1];
+                }
+        }
+        uint16_t mins[8], maxs[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mins), mn);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), mx);
+        for (int j=0; j!=8; ++j) {
+                s.min[j & 3] = std::min<uint32_t>(s.min[j & 3],
+                                                  mins[j] ^ 0x8000u);
+                s.max[j & 3] = std::max<uint32_t>(s.max[j & 3],
+                                                  maxs[j] ^ 0x8000u);
+        }
+        stats_row(in + i, n - i, s, nullptr);
+}
+#endif
+
+inline void merge_stats(stats_sums &into, stats_sums const &from) {
+        into.pixels += from.pixels;
+        for (int lane=0; lane!=4; ++lane) {
+                into.min[lane] = std::min(into.min[lane], from.min[lane]);
+                into.max[lane] = std::max(into.max[lane], from.max[lane]);
+                into.sum[lane] += from.sum[lane];
+                into.sum_squares[lane] += from.sum_squares[lane];
+        }
+}
+
+template <typename T>
+inline ImageStats image_stats(stats_sums const &s) {
+        ImageStats ret;
+        ret.pixels = s.pixels;
+        if (s.pixels == 0)
+                return ret;
+        const std::array<int, 4> lanes =
+                channel_lanes(static_cast<T const*>(nullptr));
+        ChannelStats *channels[4] = {&ret.r, &ret.g, &ret.b, &ret.a};
+        const double n = double(s.pixels);
+        for (int c=0; c!=4; ++c) {
+                const int lane = lanes[c];
+                ChannelStats &ch = *channels[c];
+                ch.min = s.min[lane];
+                ch.max = s.max[lane];
+                ch.sum = s.sum[lane];
+                ch.sum_squares = s.sum_squares[lane];
+                ch.mean = ch.sum / n;
+                ch.variance = std::max(
+                        0.0, ch.sum_squares / n - ch.mean * ch.mean);
+        }
+        return ret;
+}
+
+} }
+
+namespace puffin {
+
+template <typename ExecutionPolicy, typename O>
+inline auto histogram(ExecutionPolicy const &policy,
+                      image_view<impl::rgba8<O>> const &src)
+        -> execution::enable_if_execution_policy<ExecutionPolicy, Histogram>
+{
+        const std::size_t w = std::size_t(src.width());
+        return impl::reduce_bands<Histogram>(
+                policy, src.height(), w * sizeof(impl::rgba8<O>),
+                [&] (Histogram &acc, int y0, int y1) {
+                        // A sub-histogram counter only grows by one per
+                        // pixel, so flushing before 2^32 pixels is enough.
+                        impl::histogram_bins bins;
+                        uint64_t pending = 0;
+                        for (int y=y0; y!=y1; ++y) {
+                                if (pending + w > UINT32_MAX) {
+                                        impl::flush_histogram<O>(bins, acc);
+                                        pending = 0;
+                                }
+                                impl::histogram_row(src.row(y), w, bins);
+                                pending += w;
+                        }
+                        impl::flush_histogram<O>(bins, acc);
+                },
+                impl::merge_histogram);
+}
+
+template <typename ExecutionPolicy, typename O>
+inline auto histogram(ExecutionPolicy const &policy,
+                      base_image<impl::rgba8<O>> const &src)
+        -> execution::enable_if_execution_policy<ExecutionPolicy, Histogram>
+{
+        return histogram(policy, image_view<impl::rgba8<O>>{src});
+}
+
+template <typename O>
+inline Histogram histogram(image_view<impl::rgba8<O>> const &src) {
+        return histogram(execution::seq, src);
+}
+
+template <typename O>
+inline Histogram histogram(base_image<impl::rgba8<O>> const &src) {
+        return histogram(execution::seq, image_view<impl::rgba8<O>>{src});
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto statistics(ExecutionPolicy const &policy,
+                       image_view<T> const &src)
+        -> execution::enable_if_execution_policy<ExecutionPolicy, ImageStats>
+{
+        const std::size_t w = std::size_t(src.width());
+        const impl::stats_sums s = impl::reduce_bands<impl::stats_sums>(
+                policy, src.height(), w * sizeof(T),
+                [&] (impl::stats_sums &acc, int y0, int y1) {
+                        for (int y=y0; y!=y1; ++y)
+                                impl::stats_row(src.row(y), w, acc, 0);
+                        acc.pixels += uint64_t(w) * (y1 - y0);
+                },
+                impl::merge_stats);
+        return impl::image_stats<T>(s);
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto statistics(ExecutionPolicy const &policy,
+                       base_image<T> const &src)
+        -> execution::enable_if_execution_policy<ExecutionPolicy, ImageStats>
+{
+        return statistics(policy, image_view<T>{src});
+}
+
+template <typename T>
+inline ImageStats statistics(image_view<T> const &src) {
+        return statistics(execution::seq, src);
+}
+
+template <typename T>
+inline ImageStats statistics(base_image<T> const &src) {
+        return statistics(execution::seq, image_view<T>{src});
+}
+
+}
+
+#endif //STATISTICS_HH_INCLUDED_20261018
@@ -0,0 +1,592 @@
+#ifndef TILED_IMAGE_HH_INCLUDED_20261018
+#define TILED_IMAGE_HH_INCLUDED_20261018
+
+#include "coords.hh"
+#include "execution.hh"
+#include "image.hh"
+#include "impl/aligned_allocator.hh"
+#include "impl/contract.hh"
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace puffin {
+
+// -- tiled_image --------------------------------------------------------------
+// An image stored in square tiles of tile_size x tile_size pixels instead of
+// rows. The pixels of a tile are contiguous, row by row, and tiles follow
+// each other row by row. A Color32 tile is one 64 byte cache line (a Color64
+// tile two adjacent ones), and tiles start on cache line boundaries.
+//
+// Access patterns that are local in 2D rather than along rows then touch
+// fewer cache lines: a bilinear sample reads one tile in 9 of 16 positions
+// and at most four, where base_image reads two rows that are a whole stride
+// apart; walking down a column or along a diagonal reads each tile for
+// tile_size steps. Row-wise passes are faster on base_image; convert with
+// to_tiled() and to_linear().
+//
+// Edge tiles are padded to full size. If a row of tiles would span a
+// multiple of 1 KiB (power-of-two widths), one more tile is added to it, for
+// the reason given at image_layout::avoid_set_aliasing.
+//
+// ImageFilter, Sampler, copy(), transpose(), mirror_x/y() and the rotations
+// accept tiled_images as well.
+template <typename T>
+class tiled_image final {
+public:
+        // -- types ------------------------------------------------------------
+        using value_type = T;
+        using allocator_type = impl::aligned_allocator<
+                value_type, image_layout::storage_alignment>;
+        using container_type = std::vector<value_type, allocator_type>;
+
+        using size_type = typename container_type::size_type;
+
+        using reference = typename container_type::reference;
+        using const_reference = typename container_type::const_reference;
+
+        using pointer = typename container_type::pointer;
+        using const_pointer = typename container_type::const_pointer;
+
+        static constexpr int tile_size = 4;
+        static constexpr int tile_pixels = tile_size * tile_size;
+
+        // -- constructors -----------------------------------------------------
+        tiled_image(int width, int height);
+        tiled_image(int width, int height, value_type const &init);
+
+        tiled_image(tiled_image const &) = default;
+        tiled_image& operator= (tiled_image const &) = default;
+
+        tiled_image(tiled_image &&) noexcept = default;
+        tiled_image& operator= (tiled_image &&) noexcept = default;
+
+        ~tiled_image() = default;
+
+        // -- element access ---------------------------------------------------
+        value_type& operator() (int x, int y);
+        value_type operator() (int x, int y) const;
+
+        value_type& operator() (Coords const &);
+        value_type operator() (Coords const &) const;
+
+        value_type& at(int x, int y);
+        value_type at(int x, int y) const;
+
+        value_type& at(Coords const &);
+        value_type at(Coords const &) const;
+
+        // As operator(), without bounds checks.
+        reference texel(int x, int y) noexcept;
+        const_reference texel(int x, int y) const noexcept;
+
+        // -- raw access -------------------------------------------------------
+        // The tile_pixels pixels of tile (tx, ty), row by row.
+        pointer tile(int tx, int ty) noexcept;
+        const_pointer tile(int tx, int ty) const noexcept;
+
+        // -- capacity ---------------------------------------------------------
+        bool empty() const;
+        size_type size() const;         // width() * height()
+        size_type storage_size() const; // including padding
+
+        // -- dimensions -------------------------------------------------------
+        int width() const;
+        int height() const;
+        int tiles_x() const; // tiles per row of tiles, without padding
+        int tiles_y() const;
+
+        // -- algorithms -------------------------------------------------------
+        void fill(const_reference val);
+
+private:
+        int width_ = 0, height_ = 0;
+        int tiles_x_ = 0, tiles_y_ = 0;
+        size_type tile_stride_ = 0; // tiles between two tile rows
+        container_type pixels_;
+
+        // x and y are not negative; unsigned division is a shift.
+        size_type index(int x, int y) const noexcept {
+                const size_type ux = unsigned(x), uy = unsigned(y);
+                return ((uy / tile_size) * tile_stride_ + ux / tile_size)
+                       * tile_pixels
+                       + (uy % tile_size) * tile_size + ux % tile_size;
+        }
+
+        void ensureBoundsContract(int x, int y) const {
+                impl::positive(x);
+                impl::less_than(x, width_);
+                impl::positive(y);
+                impl::less_than(y, height_);
+        }
+};
+
+template <typename T> inline int width(tiled_image<T> const &canvas);
+template <typename T> inline int height(tiled_image<T> const &canvas);
+
+// -- conversion ---------------------------------------------------------------
+template <typename T>
+inline tiled_image<T> to_tiled(base_image<T> const &canvas);
+template <typename T>
+inline base_image<T> to_linear(
+        tiled_image<T> const &canvas,
+        image_layout const &layout = image_layout::packed());
+
+template <typename ExecutionPolicy, typename T>
+inline auto to_tiled(ExecutionPolicy const &, base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>;
+template <typename ExecutionPolicy, typename T>
+inline auto to_linear(
+        ExecutionPolicy const &,
+        tiled_image<T> const &canvas,
+        image_layout const &layout = image_layout::packed())
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>;
+
+// -- transforms ---------------------------------------------------------------
+// As for base_image, see image.hh.
+#define PUFFIN_TILED_TRANSFORM(name)                                           \
+template <typename T>                                                          \
+inline tiled_image<T> name(tiled_image<T> const &canvas);                      \
+template <typename ExecutionPolicy, typename T>                                \
+inline auto name(ExecutionPolicy const &, tiled_image<T> const &canvas)        \
+        -> execution::enable_if_execution_policy<ExecutionPolicy,              \
+                                                 tiled_image<T>>;
+PUFFIN_TILED_TRANSFORM(mirror_x)
+PUFFIN_TILED_TRANSFORM(mirror_y)
+PUFFIN_TILED_TRANSFORM(transpose)
+PUFFIN_TILED_TRANSFORM(rotate90cw)
+PUFFIN_TILED_TRANSFORM(rotate180cw)
+PUFFIN_TILED_TRANSFORM(rotate270cw)
+PUFFIN_TILED_TRANSFORM(rotate90ccw)
+PUFFIN_TILED_TRANSFORM(rotate180ccw)
+PUFFIN_TILED_TRANSFORM(rotate270ccw)
+#undef PUFFIN_TILED_TRANSFORM
+
+template <typename T>
+inline tiled_image<T> copy(tiled_image<T> const &, Rect const &);
+template <typename ExecutionPolicy, typename T>
+inline auto copy(ExecutionPolicy const &, tiled_image<T> const &, Rect const &)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>;
+
+typedef tiled_image<Color64> TiledImage64;
+typedef tiled_image<Color32> TiledImage32;
+
+}
+
+//==============================================================================
+// Implementation.
+//==============================================================================
+namespace puffin {
+
+template <typename T>
+inline tiled_image<T>::tiled_image(int width, int height) :
+        tiled_image{width, height, value_type{}}
+{
+}
+
+template <typename T>
+inline tiled_image<T>::tiled_image(
+        int width, int height,
+        value_type const &init
+) :
+        width_{impl::positive(width)},
+        height_{impl::positive(height)},
+        tiles_x_{(width + tile_size - 1) / tile_size},
+        tiles_y_{(height + tile_size - 1) / tile_size},
+        tile_stride_{size_type(tiles_x_) +
+                     (tiles_x_ * tile_pixels * sizeof(T) % 1024 == 0 &&
+                      tiles_y_ > 1)},
+        pixels_(tile_stride_ * tiles_y_ * tile_pixels, init)
+{
+}
+
+// -- element access -----------------------------------------------------------
+template <typename T>
+inline auto tiled_image<T>::operator() (int x, int y) -> value_type& {
+        ensureBoundsContract(x, y);
+        return pixels_[index(x, y)];
+}
+
+template <typename T>
+inline auto tiled_image<T>::operator() (int x, int y) const -> value_type {
+        ensureBoundsContract(x, y);
+        return pixels_[index(x, y)];
+}
+
+template <typename T>
+inline auto tiled_image<T>::operator() (Coords const &coords) -> value_type& {
+        return (*this)(coords.x, coords.y);
+}
+
+template <typename T>
+inline auto tiled_image<T>::operator() (Coords const &coords) const
+        -> value_type
+{
+        return (*this)(coords.x, coords.y);
+}
+
+template <typename T>
+inline auto tiled_image<T>::at(int x, int y) -> value_type& {
+        return (*this)(x, y);
+}
+
+template <typename T>
+inline auto tiled_image<T>::at(int x, int y) const -> value_type {
+        return (*this)(x, y);
+}
+
+template <typename T>
+inline auto tiled_image<T>::at(Coords const &coords) -> value_type& {
+        return (*this)(coords);
+}
+
+template <typename T>
+inline auto tiled_image<T>::at(Coords const &coords) const -> value_type {
+        return (*this)(coords);
+}
+
+template <typename T>
+inline auto tiled_image<T>::texel(int x, int y) noexcept -> reference {
+        return pixels_[index(x, y)];
+}
+
+template <typename T>
+inline auto tiled_image<T>::texel(int x, int y) const noexcept
+        -> const_reference
+{
+        return pixels_[index(x, y)];
+}
+
+// -- raw access ---------------------------------------------------------------
+template <typename T>
+inline auto tiled_image<T>::tile(int tx, int ty) noexcept -> pointer {
+        return pixels_.data() + (ty * tile_stride_ + tx) * tile_pixels;
+}
+
+template <typename T>
+inline auto tiled_image<T>::tile(int tx, int ty) const noexcept
+        -> const_pointer
+{
+        return pixels_.data() + (ty * tile_stride_ + tx) * tile_pixels;
+}
+
+// -- capacity -----------------------------------------------------------------
+template <typename T>
+inline auto tiled_image<T>::empty() const -> bool {
+        return width_ == 0 || height_ == 0;
+}
+
+template <typename T>
+inline auto tiled_image<T>::size() const -> size_type {
+        return size_type(width_) * size_type(height_);
+}
+
+template <typename T>
+inline auto tiled_image<T>::storage_size() const -> size_type {
+        return pixels_.size();
+}
+
+// -- dimensions ---------------------------------------------------------------
+template <typename T>
+inline auto tiled_image<T>::width() const -> int {
+        return width_;
+}
+
+template <typename T>
+inline auto tiled_image<T>::height() const -> int {
+        return height_;
+}
+
+template <typename T>
+inline auto tiled_image<T>::tiles_x() const -> int {
+        return tiles_x_;
+}
+
+template <typename T>
+inline auto tiled_image<T>::tiles_y() const -> int {
+        return tiles_y_;
+}
+
+template <typename T>
+inline auto tiled_image<T>::fill(const_reference val) -> void {
+        std::fill(pixels_.begin(), pixels_.end(), val);
+}
+
+template <typename T>
+inline int width(tiled_image<T> const &canvas) {
+        return canvas.width();
+}
+
+template <typename T>
+inline int height(tiled_image<T> const &canvas) {
+        return canvas.height();
+}
+
+}
+
+namespace puffin { namespace impl {
+
+// Calls f(src, dst, n) for each row segment of n <= tile_size pixels that
+// a tile shares with a row of the linear image, with src and dst the
+// pointers into base_image and tile. Bands are whole tile rows.
+template <typename ExecutionPolicy, typename Image, typename Tiled, typename F>
+inline void for_each_tile_segment(
+        ExecutionPolicy const &policy,
+        Image &linear,
+        Tiled &tiled,
+        F f
+) {
+        using T = typename std::decay<Image>::type::value_type;
+        constexpr int size = std::decay<Tiled>::type::tile_size;
+        const int w = tiled.width(), h = tiled.height();
+        for_each_band(policy, tiled.tiles_y(),
+                      size * linear.stride() * sizeof(T), 1,
+                      [&] (int ty0, int ty1) {
+                for (int ty=ty0; ty!=ty1; ++ty) {
+                        const int rows = std::min(size, h - ty*size);
+                        for (int r=0; r!=rows; ++r) {
+                                auto *row = linear.row(ty*size + r);
+                                for (int tx=0; tx!=tiled.tiles_x(); ++tx) {
+                                        f(row + tx*size,
+                                          tiled.tile(tx, ty) + r*size,
+                                          std::min(size, w - tx*size));
+                                }
+                        }
+                }
+        });
+}
+
+// dst(x, y) = src(map(x, y)) for all pixels of dst, tile by tile. The
+// source pixels of a destination tile lie in one to four source tiles for
+// all transforms below.
+template <typename ExecutionPolicy, typename T, typename Map>
+inline tiled_image<T> tiled_remap(
+        ExecutionPolicy const &policy,
+        tiled_image<T> const &src,
+        int width, int height,
+        Map map
+) {
+        constexpr int size = tiled_image<T>::tile_size;
+        tiled_image<T> dst{width, height};
+        for_each_band(policy, dst.tiles_y(),
+                      dst.tiles_x() * tiled_image<T>::tile_pixels * sizeof(T),
+                      1, [&] (int ty0, int ty1) {
+                for (int ty=ty0; ty!=ty1; ++ty)
+                for (int tx=0; tx!=dst.tiles_x(); ++tx) {
+                        T *tile = dst.tile(tx, ty);
+                        const int
+                                x0 = tx*size, xn = std::min(size, width - x0),
+                                y0 = ty*size, yn = std::min(size, height - y0);
+                        for (int r=0; r!=yn; ++r)
+                        for (int c=0; c!=xn; ++c) {
+                                const Coords p = map(x0 + c, y0 + r);
+                                tile[r*size + c] = src.texel(p.x, p.y);
+                        }
+                }
+        });
+        return dst;
+}
+
+} }
+
+namespace puffin {
+
+// -- conversion ---------------------------------------------------------------
+template <typename ExecutionPolicy, typename T>
+inline auto to_tiled(ExecutionPolicy const &policy,
+                     base_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        constexpr int size = tiled_image<T>::tile_size;
+        tiled_image<T> ret{canvas.width(), canvas.height()};
+        impl::for_each_tile_segment(policy, canvas, ret,
+                                    [] (T const *src, T *dst, int n) {
+                if (n == size)
+                        std::copy_n(src, size, dst);
+                else
+                        std::copy_n(src, n, dst);
+        });
+        return ret;
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto to_linear(
+        ExecutionPolicy const &policy,
+        tiled_image<T> const &canvas,
+        image_layout const &layout
+)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 base_image<T>>
+{
+        constexpr int size = tiled_image<T>::tile_size;
+        base_image<T> ret{canvas.width(), canvas.height(), layout};
+        impl::for_each_tile_segment(policy, ret, canvas,
+                                    [] (T *dst, T const *src, int n) {
+                if (n == size)
+                        std::copy_n(src, size, dst);
+                else
+                        std::copy_n(src, n, dst);
+        });
+        return ret;
+}
+
+template <typename T>
+inline tiled_image<T> to_tiled(base_image<T> const &canvas) {
+        return to_tiled(execution::seq, canvas);
+}
+
+template <typename T>
+inline base_image<T> to_linear(tiled_image<T> const &canvas,
+                               image_layout const &layout) {
+        return to_linear(execution::seq, canvas, layout);
+}
+
+// -- transforms ---------------------------------------------------------------
+template <typename ExecutionPolicy, typename T>
+inline auto mirror_x(ExecutionPolicy const &policy,
+                     tiled_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        const int w = canvas.width(), h = canvas.height();
+        return impl::tiled_remap(policy, canvas, w, h, [=] (int x, int y) {
+                return Coords{w-1 - x, y};
+        });
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto mirror_y(ExecutionPolicy const &policy,
+                     tiled_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        const int w = canvas.width(), h = canvas.height();
+        return impl::tiled_remap(policy, canvas, w, h, [=] (int x, int y) {
+                return Coords{x, h-1 - y};
+        });
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto transpose(ExecutionPolicy const &policy,
+                      tiled_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        const int w = canvas.width(), h = canvas.height();
+        return impl::tiled_remap(policy, canvas, h, w, [] (int x, int y) {
+                return Coords{y, x};
+        });
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate90cw(ExecutionPolicy const &policy,
+                       tiled_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        const int w = canvas.width(), h = canvas.height();
+        return impl::tiled_remap(policy, canvas, h, w, [=] (int x, int y) {
+                return Coords{y, h-1 - x};
+        });
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate180cw(ExecutionPolicy const &policy,
+                        tiled_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        const int w = canvas.width(), h = canvas.height();
+        return impl::tiled_remap(policy, canvas, w, h, [=] (int x, int y) {
+                return Coords{w-1 - x, h-1 - y};
+        });
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate270cw(ExecutionPolicy const &policy,
+                        tiled_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        const int w = canvas.width(), h = canvas.height();
+        return impl::tiled_remap(policy, canvas, h, w, [=] (int x, int y) {
+                return Coords{w-1 - y, x};
+        });
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate90ccw(ExecutionPolicy const &policy,
+                        tiled_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        return rotate270cw(policy, canvas);
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate180ccw(ExecutionPolicy const &policy,
+                         tiled_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        return rotate180cw(policy, canvas);
+}
+
+template <typename ExecutionPolicy, typename T>
+inline auto rotate270ccw(ExecutionPolicy const &policy,
+                         tiled_image<T> const &canvas)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        return rotate90cw(policy, canvas);
+}
+
+#define PUFFIN_SEQ_TRANSFORM(name)                                             \
+template <typename T>                                                          \
+inline tiled_image<T> name(tiled_image<T> const &canvas) {                     \
+        return name(execution::seq, canvas);                                   \
+}
+PUFFIN_SEQ_TRANSFORM(mirror_x)
+PUFFIN_SEQ_TRANSFORM(mirror_y)
+PUFFIN_SEQ_TRANSFORM(transpose)
+PUFFIN_SEQ_TRANSFORM(rotate90cw)
+PUFFIN_SEQ_TRANSFORM(rotate180cw)
+PUFFIN_SEQ_TRANSFORM(rotate270cw)
+PUFFIN_SEQ_TRANSFORM(rotate90ccw)
+PUFFIN_SEQ_TRANSFORM(rotate180ccw)
+PUFFIN_SEQ_TRANSFORM(rotate270ccw)
+#undef PUFFIN_SEQ_TRANSFORM
+
+// -- copy ---------------------------------------------------------------------
+template <typename ExecutionPolicy, typename T>
+inline auto copy(ExecutionPolicy const &policy,
+                 tiled_image<T> const &canvas,
+                 Rect const &rect)
+        -> execution::enable_if_execution_policy<ExecutionPolicy,
+                                                 tiled_image<T>>
+{
+        impl::positive(rect.left());
+        impl::positive(rect.top());
+        impl::less_or_equal(rect.right(), canvas.width());
+        impl::less_or_equal(rect.bottom(), canvas.height());
+
+        const int left = rect.left(), top = rect.top();
+        return impl::tiled_remap(policy, canvas, rect.width(), rect.height(),
+                                 [=] (int x, int y) {
+                return Coords{left + x, top + y};
+        });
+}
+
+template <typename T>
+inline tiled_image<T> copy(tiled_image<T> const &canvas, Rect const &rect) {
+        return copy(execution::seq, canvas, rect);
+}
+
+}
+
+#endif //TILED_IMAGE_HH_INCLUDED_20261018
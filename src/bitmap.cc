@@ -23,10 +23,42 @@
 #include "bitmap/BitmapColorTable.hh"
 #include "bitmap/BitmapRowData.hh"
 #include "bitmap/BitmapImageData.hh"
+#include "bitmap/DecodeStageTimer.hh"
+#include "bitmap/DecodeBudget.hh"
 #include "bitmap/Bitmap.hh"
 
 namespace puffin {
 
+// -- DecodeStats --------------------------------------------------------------
+std::ostream& operator<< (std::ostream &os, DecodeStats const &v) {
+        return os << "DecodeStats{\n"
+                  << "  version_ns:" << v.version_ns << "\n"
+                  << "  headers_ns:" << v.headers_ns << "\n"
+                  << "  color_table_ns:" << v.color_table_ns << "\n"
+                  << "  image_data_ns:" << v.image_data_ns << "\n"
+                  << "  alpha_ns:" << v.alpha_ns << "\n"
+                  << "  total_ns:" << v.total_ns << "\n"
+                  << "  bytes_read:" << v.bytes_read << "\n"
+                  << "  rows_decoded:" << v.rows_decoded << "\n"
+                  << "  allocations:" << v.allocations << "\n"
+                  << "  bad_indices:" << v.bad_indices << "\n"
+                  << "  kernel:" << v.kernel << "\n"
+                  << "}\n";
+}
+
+// -- process-wide decode budget -----------------------------------------------
+void set_process_decode_budget(uint64_t max_bytes) {
+        impl::processDecodeBudget().store(max_bytes);
+}
+
+uint64_t process_decode_budget() {
+        return impl::processDecodeBudget().load();
+}
+
+uint64_t process_decode_bytes_in_use() {
+        return impl::processDecodeBytesInUse().load();
+}
+
 // -- class Bitmap -------------------------------------------------------------
 Bitmap::Bitmap() :
         impl_(new impl::Bitmap())
@@ -38,6 +70,11 @@ Bitmap::Bitmap(std::istream &f) :
 {
 }
 
+Bitmap::Bitmap(std::istream &f, DecodeOptions const &opts) :
+        impl_(new impl::Bitmap(f, opts))
+{
+}
+
 Bitmap::~Bitmap() {
         delete impl_;
 }
@@ -48,22 +85,26 @@ Bitmap::Bitmap(Bitmap const &v) :
 }
 
 Bitmap& Bitmap::operator= (Bitmap const &v) {
+        // Swap the implementations, not the objects: std::swap on the
+        // objects would deep-copy and account the decode budget twice.
         using std::swap;
         Bitmap tmp(v);
-        swap(*this, tmp);
+        swap(impl_, tmp.impl_);
         return *this;
 }
 
 void Bitmap::reset() {
-        using std::swap;
-        Bitmap tmp;
-        swap(*this, tmp);
+        impl_->reset();
 }
 
 void Bitmap::reset(std::istream &f) {
         impl_->reset(f);
 }
 
+void Bitmap::reset(std::istream &f, DecodeOptions const &opts) {
+        impl_->reset(f, opts);
+}
+
 int Bitmap::width() const {
         return impl_->width();
 }
@@ -112,6 +153,15 @@ Color32 Bitmap::at(int x, int y) const {
         return impl_->at32(x, y);
 }
 
+void Bitmap::read_row(int y, Color32Bgra *dst) const {
+        impl_->getRowBgra32(y, dst);
+}
+
+void Bitmap::read_pixels(Color32Bgra *dst, std::size_t stride) const {
+        for (int y=0; y!=height(); ++y)
+                impl_->getRowBgra32(y, dst + y*stride);
+}
+
 std::ostream& operator<< (std::ostream &os, Bitmap const &v) {
         return os << *v.impl_;
 }
@@ -127,6 +177,11 @@ InvalidBitmap::InvalidBitmap(std::istream &f) :
 {
 }
 
+InvalidBitmap::InvalidBitmap(std::istream &f, DecodeOptions const &opts) :
+        impl_(new impl::Bitmap(f, opts))
+{
+}
+
 InvalidBitmap::~InvalidBitmap() {
         delete impl_;
 }
@@ -137,26 +192,34 @@ InvalidBitmap::InvalidBitmap(InvalidBitmap const &v) :
 }
 
 InvalidBitmap& InvalidBitmap::operator= (InvalidBitmap const &v) {
+        // Swap the implementations, not the objects: std::swap on the
+        // objects would deep-copy and account the decode budget twice.
         using std::swap;
         InvalidBitmap tmp(v);
-        swap(*this, tmp);
+        swap(impl_, tmp.impl_);
         return *this;
 }
 
 void InvalidBitmap::reset() {
-        using std::swap;
-        InvalidBitmap tmp;
-        swap(*this, tmp);
+        impl_->reset();
 }
 
 void InvalidBitmap::reset(std::istream &f) {
         impl_->reset(f);
 }
 
+void InvalidBitmap::reset(std::istream &f, DecodeOptions const &opts) {
+        impl_->reset(f, opts);
+}
+
 bool InvalidBitmap::partial_reset(std::istream &f) {
         return impl_->partial_reset(f);
 }
 
+bool InvalidBitmap::partial_reset(std::istream &f, DecodeOptions const &opts) {
+        return impl_->partial_reset(f, opts);
+}
+
 int InvalidBitmap::width() const {
         return impl_->width();
 }
@@ -209,6 +272,15 @@ Color32 InvalidBitmap::at(int x, int y) const {
         return impl_->at32(x, y);
 }
 
+void InvalidBitmap::read_row(int y, Color32Bgra *dst) const {
+        impl_->getRowBgra32(y, dst);
+}
+
+void InvalidBitmap::read_pixels(Color32Bgra *dst, std::size_t stride) const {
+        for (int y=0; y!=height(); ++y)
+                impl_->getRowBgra32(y, dst + y*stride);
+}
+
 std::ostream& operator<< (std::ostream &os, InvalidBitmap const &v) {
         return os << *v.impl_;
 }
@@ -216,18 +288,29 @@ std::ostream& operator<< (std::ostream &os, InvalidBitmap const &v) {
 
 // -- read_bmp() ---------------------------------------------------------------
 Bitmap read_bmp(std::string const &filename) {
+        return read_bmp(filename, DecodeOptions());
+}
+
+Bitmap read_bmp(std::string const &filename, DecodeOptions const &opts) {
         std::ifstream f(filename, std::ios::binary);
         if (!f.is_open())
                 throw exceptions::file_not_found(filename);
-        return Bitmap(f);
+        return Bitmap(f, opts);
 }
 
 InvalidBitmap read_invalid_bmp(std::string const &filename) {
+        return read_invalid_bmp(filename, DecodeOptions());
+}
+
+InvalidBitmap read_invalid_bmp(
+        std::string const &filename,
+        DecodeOptions const &opts
+) {
         std::ifstream f(filename, std::ios::binary);
         if (!f.is_open())
                 return InvalidBitmap();
         InvalidBitmap ret;
-        ret.partial_reset(f);
+        ret.partial_reset(f, opts);
         return ret;
 }
 
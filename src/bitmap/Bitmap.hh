@@ -11,6 +11,7 @@
 #include "puffin/rgba_bitmask.hh"
 #include "puffin/chunk_layout.hh"
 
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <vector>
@@ -39,8 +40,16 @@ public:
                 reset(f);
         }
 
+        Bitmap(std::istream &f, DecodeOptions const &opts) {
+                reset(f, opts);
+        }
+
         bool partial_reset(std::istream &f) {
-                return reset(f, false);
+                return reset(f, false, DecodeOptions());
+        }
+
+        bool partial_reset(std::istream &f, DecodeOptions const &opts) {
+                return reset(f, false, opts);
         }
 
         void reset() {
@@ -50,7 +59,11 @@ public:
         }
 
         void reset(std::istream &f) {
-                reset(f, true);
+                reset(f, true, DecodeOptions());
+        }
+
+        void reset(std::istream &f, DecodeOptions const &opts) {
+                reset(f, true, opts);
         }
 
         int width() const { return infoHeader_.width; }
@@ -98,7 +111,7 @@ public:
         }
 
         Color32 get32(int x, int y) const {
-                if (x<0 || x>=width() || y<0 || y>=height()) {
+                if (!valid_ || x<0 || x>=width() || y<0 || y>=height()) {
                         return Color32();
                 }
 
@@ -116,6 +129,10 @@ public:
 
         Color32 at32(int x, int y) const {
                 // TODO: use puffin exceptions
+                if (!valid_) {
+                        throw std::logic_error(
+                                "BitmapImageData.at32(): invalid bitmap");
+                }
                 if (x<0 || x>=width()) {
                         throw std::logic_error(
                                 "BitmapImageData.at32(): x out of range");
@@ -129,12 +146,39 @@ public:
                 if (is_rgb()) {
                         return bitmask_.rawToColor(raw);
                 } else if(is_paletted()) {
-                        return colorTable_.at(raw);
+                        // The palette is padded to 2^bpp entries, which
+                        // covers every index of bpp bits.
+                        return colorTable_[raw];
                 } else {
                         throw std::runtime_error("Neither paletted, nor RGB");
                 }
         }
 
+        // Writes row y as width() pixels to dst.
+        void getRowBgra32(int y, Color32Bgra *dst) const {
+                if (!valid_) {
+                        throw std::logic_error(
+                                "Bitmap.getRowBgra32(): invalid bitmap");
+                }
+                if (y<0 || y>=height()) {
+                        throw std::logic_error(
+                                "Bitmap.getRowBgra32(): y out of range");
+                }
+
+                if (isNativeBgra32()) {
+                        // The chunks are 0x??RRGGBB, i.e. b, g, r, ? in
+                        // memory; only alpha needs to be set.
+                        uint32_t const *src = imageData_.row(y).chunks();
+                        for (int x = 0; x < width(); ++x) {
+                                const uint32_t v = src[x] | 0xFF000000U;
+                                std::memcpy(static_cast<void*>(dst + x), &v, sizeof v);
+                        }
+                        return;
+                }
+                for (int x = 0; x < width(); ++x)
+                        dst[x] = Color32Bgra(get32(x, y));
+        }
+
         friend
         std::ostream& operator<< (std::ostream &os, Bitmap const &v) {
                 os << v.header_;
@@ -179,6 +223,8 @@ private:
         bool valid_;
         std::set<BitmapVersion> bitmapVersion_;
 
+        DecodeBudgetReservation budget_;
+
 private:
         static bool compressionSupported(BitmapCompression v) {
                 switch (v) {
@@ -197,11 +243,26 @@ private:
                 }
         }
 
-        bool reset(std::istream &f, bool exceptions) {
+        bool reset(
+                std::istream &f,
+                bool exceptions,
+                DecodeOptions const &opts
+        ) {
                 reset();
 
-                bitmapVersion_ = determineBitmapVersion(f);
-                loadHeaders(f);
+                DecodeStats *stats = opts.stats;
+                if (stats)
+                        *stats = DecodeStats();
+                DecodeStageTimer total(stats, &DecodeStats::total_ns);
+
+                {
+                        DecodeStageTimer t(stats, &DecodeStats::version_ns);
+                        bitmapVersion_ = determineBitmapVersion(f);
+                }
+                {
+                        DecodeStageTimer t(stats, &DecodeStats::headers_ns, f);
+                        loadHeaders(f);
+                }
 
                 if (!compressionSupported(infoHeader_.compression)) {
                         if (exceptions) {
@@ -213,15 +274,131 @@ private:
                         }
                 }
 
-                initBitmasks(f);
-                colorTable_.reset(header_, infoHeader_, bitmapVersion_, f);
-                imageData_.reset(header_, infoHeader_, f);
-                initAlpha();
+                if (!checkBudget(f, opts.limits, exceptions))
+                        return false;
+
+                {
+                        DecodeStageTimer t(stats, &DecodeStats::color_table_ns, f);
+                        initBitmasks(f);
+                        colorTable_.reset(header_, infoHeader_, bitmapVersion_, f);
+                }
+                {
+                        f.seekg(header_.dataOffset);
+                        DecodeStageTimer t(stats, &DecodeStats::image_data_ns, f);
+                        imageData_.reset(header_, infoHeader_, f);
+                }
+                {
+                        DecodeStageTimer t(stats, &DecodeStats::color_table_ns);
+                        if (!initPalette(opts, exceptions))
+                                return false;
+                }
+                {
+                        DecodeStageTimer t(stats, &DecodeStats::alpha_ns);
+                        initAlpha();
+                }
+
+                if (stats) {
+                        stats->rows_decoded = imageData_.rows_decoded();
+                        stats->allocations = imageData_.allocations() +
+                                             colorTable_.allocations();
+                        stats->kernel = imageData_.kernel();
+                }
 
                 valid_ = true;
                 return true;
         }
 
+        // True if the stored chunks of each row are already Color32Bgra
+        // pixels, apart from alpha: 24 and 32 bpp with 8 bit channels at
+        // their default positions, on a little endian target.
+        bool isNativeBgra32() const {
+                if (!PUFFIN_LITTLE_ENDIAN || has_alpha())
+                        return false;
+                if (bpp() != 24 && bpp() != 32)
+                        return false;
+                return bitmask_.r().shift() == 16 && bitmask_.r().width() == 8
+                    && bitmask_.g().shift() ==  8 && bitmask_.g().width() == 8
+                    && bitmask_.b().shift() ==  0 && bitmask_.b().width() == 8;
+        }
+
+        static bool supportedBpp(unsigned int bpp) {
+                switch (bpp) {
+                case 1: case 2: case 4: case 8:
+                case 16: case 24: case 32:
+                        return true;
+                default:
+                        return false;
+                }
+        }
+
+        static bool streamSize(std::istream &f, uint64_t &size) {
+                const std::istream::pos_type pos = f.tellg();
+                if (pos == std::istream::pos_type(-1))
+                        return false;
+                f.seekg(0, std::ios_base::end);
+                const std::istream::pos_type end = f.tellg();
+                f.seekg(pos);
+                if (end == std::istream::pos_type(-1))
+                        return false;
+                size = static_cast<uint64_t>(end);
+                return true;
+        }
+
+        // Pre-flight accounting: everything below is computed from the
+        // headers alone, so that corrupt or hostile files are rejected
+        // before the (possibly huge) pixel allocations happen.
+        bool checkBudget(
+                std::istream &f,
+                DecodeLimits const &limits,
+                bool exceptions
+        ) {
+                try {
+                        if (infoHeader_.height < 0 ||
+                            !supportedBpp(infoHeader_.bitsPerPixel))
+                        {
+                                throw exceptions::load_image(
+                                        "unsupported image dimensions or "
+                                        "bits per pixel");
+                        }
+
+                        const uint64_t pixels = uint64_t(infoHeader_.width) *
+                                                uint64_t(infoHeader_.height);
+                        if (limits.max_pixels != 0 &&
+                            pixels > limits.max_pixels)
+                        {
+                                throw exceptions::decode_budget_exceeded(
+                                        "pixels", pixels, limits.max_pixels);
+                        }
+
+                        uint64_t fileSize = 0;
+                        if (streamSize(f, fileSize)) {
+                                const uint64_t required =
+                                        uint64_t(header_.dataOffset) +
+                                        BitmapImageData::bytes_in_file(
+                                                infoHeader_);
+                                if (required > fileSize) {
+                                        throw exceptions::truncated_image_data(
+                                                required, fileSize);
+                                }
+                        }
+
+                        const uint64_t bytes =
+                                BitmapImageData::required_bytes(infoHeader_) +
+                                BitmapColorTable::required_bytes(
+                                        header_, infoHeader_, bitmapVersion_);
+                        if (limits.max_bytes != 0 && bytes > limits.max_bytes) {
+                                throw exceptions::decode_budget_exceeded(
+                                        "bytes", bytes, limits.max_bytes);
+                        }
+                        budget_.acquireOrThrow(bytes);
+                } catch (exceptions::load_image &) {
+                        if (exceptions)
+                                throw;
+                        return false;
+                }
+                return true;
+        }
+
         void loadHeaders(std::istream &f) {
                 header_.reset(f);
                 const auto headerPos = f.tellg();
@@ -253,6 +430,45 @@ private:
                 }
         }
 
+        // Pads the palette to 2^bpp entries, after which lookups need no
+        // bounds checks, and validates the pixel indices once. The palette
+        // is padded even if validation fails, so it is never left short of
+        // pixel data that has been read.
+        bool initPalette(DecodeOptions const &opts, bool exceptions) {
+                if (!is_paletted())
+                        return true;
+
+                const uint32_t full = 1U << bpp();
+                const uint32_t declared =
+                        static_cast<uint32_t>(colorTable_.declared_size());
+                colorTable_.pad(full, opts.palette_fill);
+
+                // Indices have bpp bits, so a full palette cannot be
+                // overrun; only count the bad ones if somebody asks.
+                if (declared < full && (opts.strict_palette || opts.stats)) {
+                        uint64_t bad = 0;
+                        uint32_t first = 0;
+                        for (int y = 0; y < height(); ++y) {
+                                for (int x = 0; x < width(); ++x) {
+                                        const uint32_t raw = imageData_.get32(x, y);
+                                        if (raw >= declared && bad++ == 0)
+                                                first = raw;
+                                }
+                        }
+                        if (opts.stats)
+                                opts.stats->bad_indices = bad;
+                        if (bad != 0 && opts.strict_palette) {
+                                if (exceptions) {
+                                        throw exceptions::palette_index_out_of_range(
+                                                static_cast<int>(first),
+                                                static_cast<int>(declared));
+                                }
+                                return false;
+                        }
+                }
+                return true;
+        }
+
         void initAlpha() {
                 // detect alpha (non-standard; in ICO files, transparency is
                 // defined if any "reserved" value is non-zero)
@@ -18,7 +18,7 @@
 namespace puffin { namespace impl {
 
 struct BitmapColorTable {
-        BitmapColorTable() {}
+        BitmapColorTable() : declaredSize_(0), allocations_(0) {}
 
         BitmapColorTable(
                 BitmapHeader const &header,
@@ -36,6 +36,25 @@ struct BitmapColorTable {
                 std::istream &f
         ) {
                 entries_ = readEntries(header, infoHeader, v, f);
+                declaredSize_ = entries_.size();
+                // readEntries() reserves its storage once.
+                allocations_ = entries_.capacity() != 0 ? 1 : 0;
+        }
+
+        // Grows the table to at least count entries, using fill for the new
+        // ones. The number of entries read from the file is retained.
+        void pad(std::vector<Color32>::size_type count, Color32 const &fill) {
+                if (entries_.size() < count) {
+                        const auto before = entries_.capacity();
+                        entries_.resize(count, fill);
+                        if (entries_.capacity() != before)
+                                ++allocations_;
+                }
+        }
+
+        // Number of entries stored in the file.
+        std::vector<Color32>::size_type declared_size() const {
+                return declaredSize_;
         }
 
         Color32 operator[](int i) const {
@@ -54,8 +73,29 @@ struct BitmapColorTable {
                 return entries_.empty();
         }
 
+        // Heap allocations made by reset() and pad().
+        uint64_t allocations() const {
+                return allocations_;
+        }
+
+        // Memory that reset() will allocate for the given headers.
+        static uint64_t required_bytes(
+                BitmapHeader const &header,
+                BitmapInfoHeader const &infoHeader,
+                std::set<BitmapVersion> const &v
+        ) {
+                // Paletted bitmaps get their palette padded to 2^bpp.
+                const uint64_t
+                        stored = computeSize(header, infoHeader, v),
+                        full = infoHeader.bitsPerPixel <= 8
+                               ? uint64_t(1) << infoHeader.bitsPerPixel : 0;
+                return (stored > full ? stored : full) * sizeof(Color32);
+        }
+
 private:
         std::vector<Color32> entries_;
+        std::vector<Color32>::size_type declaredSize_;
+        uint64_t allocations_;
 
         static std::vector<Color32> readEntries(
                 BitmapHeader const &header,
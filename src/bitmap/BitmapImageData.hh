@@ -24,7 +24,9 @@ struct BitmapImageData {
         typedef typename container_type::size_type size_type;
 
         // -- members --------------------------------------------------
-        BitmapImageData() : width_(0) {}
+        BitmapImageData() :
+                width_(0), rowsDecoded_(0), allocations_(0), kernel_("")
+        {}
 
         BitmapImageData(
                 BitmapHeader const &header,
@@ -40,12 +42,40 @@ struct BitmapImageData {
                 std::istream &f
         ) {
                 f.seekg(header.dataOffset);
+                allocations_ = 0;
+                kernel_ = kernelName(infoHeader);
                 loadUncompressed(infoHeader, f);
+                rowsDecoded_ = rows_.size();
                 loadRLE(infoHeader, f);
                 width_ = infoHeader.width;
 
         }
 
+        // Memory that reset() will allocate for the given headers. Only
+        // valid for bits per pixel supported by BitmapRowData.
+        static uint64_t required_bytes(BitmapInfoHeader const &infoHeader) {
+                const ChunkLayout layout(
+                        infoHeader.bitsPerPixel > 8 ? infoHeader.bitsPerPixel : 8,
+                        infoHeader.bitsPerPixel);
+                const uint64_t
+                        chunks = layout.width_to_chunk_count(infoHeader.width),
+                        perRow = sizeof(row_type) +
+                                 chunks * sizeof(row_type::chunk_type);
+                return uint64_t(infoHeader.height) * perRow;
+        }
+
+        // Size of the pixel data in the file, or 0 if it is compressed and
+        // can therefore not be known from the headers.
+        static uint64_t bytes_in_file(BitmapInfoHeader const &infoHeader) {
+                if (infoHeader.compression != BI_RGB &&
+                    infoHeader.compression != BI_BITFIELDS)
+                        return 0;
+                const uint64_t stride =
+                        ((uint64_t(infoHeader.width) * infoHeader.bitsPerPixel
+                          + 31) / 32) * 4;
+                return stride * uint64_t(infoHeader.height);
+        }
+
         bool empty() const {
                 return rows_.size() == 0;
         }
@@ -58,10 +88,31 @@ struct BitmapImageData {
                 return rows_.size();
         }
 
+        // Number of rows that received pixel data. For RLE data, this is
+        // the number of rows reached before the end-of-bitmap marker.
+        size_type rows_decoded() const {
+                return rowsDecoded_;
+        }
+
+        // Heap allocations made by the last reset(), counted where the row
+        // container and the chunk vectors grow their storage.
+        size_type allocations() const {
+                return allocations_;
+        }
+
+        // Name of the row decoder chosen by the last reset().
+        char const *kernel() const {
+                return kernel_;
+        }
+
         uint32_t get32(int x, int y) const {
                 return rows_[y].get32(x);
         }
 
+        row_type const &row(int y) const {
+                return rows_[y];
+        }
+
         void set32(int x, int y, uint32_t val) {
                 //std::cout << val << " => " << std::bitset<32>(get32(x, y)) << " --> ";
                 rows_[y].set32(x, val);
@@ -71,6 +122,34 @@ struct BitmapImageData {
 private:
         container_type rows_;
         size_type width_;
+        size_type rowsDecoded_;
+        size_type allocations_;
+        char const *kernel_;
+
+        // Containers here start out empty and are sized once, so one with
+        // storage has made exactly one allocation.
+        void countAllocation(size_type capacity) {
+                if (capacity != 0)
+                        ++allocations_;
+        }
+
+        static char const *kernelName(BitmapInfoHeader const &infoHeader) {
+                switch (infoHeader.compression) {
+                case BI_RLE4: return "rle4";
+                case BI_RLE8: return "rle8";
+                default: break;
+                }
+                switch (infoHeader.bitsPerPixel) {
+                case 1: return "packed-1bpp";
+                case 2: return "packed-2bpp";
+                case 4: return "packed-4bpp";
+                case 8: return "packed-8bpp";
+                case 16: return "chunked-16bpp";
+                case 24: return "chunked-24bpp";
+                case 32: return "chunked-32bpp";
+                default: return "chunked";
+                }
+        }
 
         void clear_and_shrink(int newSize = 0) {
                 rows_.clear();
@@ -78,6 +157,7 @@ private:
                 // constructor:
                 std::vector<row_type> tmp(newSize);
                 tmp.swap(rows_);
+                countAllocation(rows_.capacity());
         }
 
         void loadUncompressed(BitmapInfoHeader const &infoHeader, std::istream &f) {
@@ -88,13 +168,16 @@ private:
                         clear_and_shrink(infoHeader.height);
                         for (int y = infoHeader.height - 1; y >= 0; --y) {
                                 rows_[y].reset(infoHeader, f);
+                                countAllocation(rows_[y].capacity());
                         }
                 } else {
                         // Can construct upon reading:
                         clear_and_shrink();
                         rows_.reserve(infoHeader.height);
+                        countAllocation(rows_.capacity());
                         for (int y = 0; y != infoHeader.height; ++y) {
                                 rows_.emplace_back(infoHeader, f);
+                                countAllocation(rows_.back().capacity());
                         }
                 }
         }
@@ -114,6 +197,10 @@ private:
                 int y = 0;
 
                 while (true) {
+                        // A missing end-of-bitmap marker must not make us
+                        // spin on end-of-file forever.
+                        if (!f)
+                                goto done;
                         const std::ostream::pos_type runStartPos = f.tellg();
                         const uint8_t
                                 first = read_uint8_le(f),
@@ -213,6 +300,7 @@ private:
                          */
                 }
                 done:
+                rowsDecoded_ = y + 1 < infoHeader.height ? y + 1 : infoHeader.height;
                 const std::ostream::pos_type endPos = f.tellg();
         }
 };
@@ -88,6 +88,17 @@ struct BitmapRowData {
                 return value;
         }
 
+        // The chunks of the row. For 16, 24 and 32 bpp, each chunk is one
+        // pixel, as the little endian value of its bytes in the file.
+        chunk_type const *chunks() const {
+                return chunks_.empty() ? 0 : &chunks_[0];
+        }
+
+        // Number of chunks the row has storage for.
+        container_type::size_type capacity() const {
+                return chunks_.capacity();
+        }
+
         void set32(int x, uint32_t value) {
                 const uint32_t
                         chunk_index = layout_.x_to_chunk_index(x),
@@ -0,0 +1,109 @@
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Usage notes
+// (you can find implementer's not at the bottom of this file).
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#include "puffin/bitmap.hh"
+#include "puffin/exceptions.hh"
+
+#include <atomic>
+
+namespace puffin { namespace impl {
+
+inline std::atomic<uint64_t>& processDecodeBudget() {
+        static std::atomic<uint64_t> bytes(0);
+        return bytes;
+}
+
+inline std::atomic<uint64_t>& processDecodeBytesInUse() {
+        static std::atomic<uint64_t> bytes(0);
+        return bytes;
+}
+
+// Memory held by one decoded bitmap, accounted against the process-wide
+// budget for as long as the reservation lives. Copies account anew.
+class DecodeBudgetReservation {
+public:
+        DecodeBudgetReservation() : bytes_(0) {}
+
+        ~DecodeBudgetReservation() {
+                release();
+        }
+
+        DecodeBudgetReservation(DecodeBudgetReservation const &v) :
+                bytes_(0)
+        {
+                acquireOrThrow(v.bytes_);
+        }
+
+        DecodeBudgetReservation& operator= (DecodeBudgetReservation const &v) {
+                if (this != &v) {
+                        DecodeBudgetReservation tmp(v);
+                        swap(tmp);
+                }
+                return *this;
+        }
+
+        DecodeBudgetReservation(DecodeBudgetReservation &&v) :
+                bytes_(v.bytes_)
+        {
+                v.bytes_ = 0;
+        }
+
+        DecodeBudgetReservation& operator= (DecodeBudgetReservation &&v) {
+                swap(v);
+                return *this;
+        }
+
+        void swap(DecodeBudgetReservation &v) {
+                using std::swap;
+                swap(bytes_, v.bytes_);
+        }
+
+        // Replaces the current reservation. Returns false, holding nothing,
+        // if the process-wide budget does not allow the new one.
+        bool acquire(uint64_t bytes) {
+                release();
+                const uint64_t budget = processDecodeBudget().load();
+                const uint64_t inUse =
+                        processDecodeBytesInUse().fetch_add(bytes) + bytes;
+                if (budget != 0 && inUse > budget) {
+                        processDecodeBytesInUse().fetch_sub(bytes);
+                        return false;
+                }
+                bytes_ = bytes;
+                return true;
+        }
+
+        void acquireOrThrow(uint64_t bytes) {
+                if (!acquire(bytes)) {
+                        throw exceptions::decode_budget_exceeded(
+                                "process bytes",
+                                processDecodeBytesInUse().load() + bytes,
+                                processDecodeBudget().load());
+                }
+        }
+
+        void release() {
+                if (bytes_ != 0) {
+                        processDecodeBytesInUse().fetch_sub(bytes_);
+                        bytes_ = 0;
+                }
+        }
+
+        uint64_t bytes() const {
+                return bytes_;
+        }
+
+private:
+        uint64_t bytes_;
+};
+
+inline
+void swap(DecodeBudgetReservation &lhs, DecodeBudgetReservation &rhs) {
+        lhs.swap(rhs);
+}
+
+} }
@@ -0,0 +1,78 @@
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Usage notes
+// (you can find implementer's not at the bottom of this file).
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#include "puffin/bitmap.hh"
+
+#include <chrono>
+#include <istream>
+
+namespace puffin { namespace impl {
+
+// Measures one stage of a decode into a DecodeStats field. When no stats
+// were requested, construction and destruction only test a null pointer.
+struct DecodeStageTimer {
+        typedef std::chrono::steady_clock clock_type;
+
+        DecodeStageTimer(DecodeStats *stats, uint64_t DecodeStats::*field) :
+                stats_(stats),
+                field_(field),
+                f_(0)
+        {
+                if (stats_)
+                        start_ = clock_type::now();
+        }
+
+        DecodeStageTimer(
+                DecodeStats *stats,
+                uint64_t DecodeStats::*field,
+                std::istream &f
+        ) :
+                stats_(stats),
+                field_(field),
+                f_(&f)
+        {
+                if (stats_) {
+                        startPos_ = f.tellg();
+                        start_ = clock_type::now();
+                }
+        }
+
+        ~DecodeStageTimer() {
+                if (!stats_)
+                        return;
+                const clock_type::duration d = clock_type::now() - start_;
+                stats_->*field_ += static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(d)
+                                .count());
+
+                if (f_) {
+                        // Seeking back and forth (e.g. to the pixel data
+                        // offset) is not reading; only count forward
+                        // progress, and nothing once the stream failed.
+                        const std::istream::pos_type endPos = f_->tellg();
+                        if (startPos_ != std::istream::pos_type(-1) &&
+                            endPos != std::istream::pos_type(-1) &&
+                            endPos > startPos_)
+                        {
+                                stats_->bytes_read += static_cast<uint64_t>(
+                                        endPos - startPos_);
+                        }
+                }
+        }
+
+private:
+        DecodeStats *stats_;
+        uint64_t DecodeStats::*field_;
+        std::istream *f_;
+        std::istream::pos_type startPos_;
+        clock_type::time_point start_;
+
+        DecodeStageTimer(DecodeStageTimer const &); // delete
+        DecodeStageTimer& operator= (DecodeStageTimer const &); // delete
+};
+
+} }
@@ -30,12 +30,9 @@ int main() {
                 }
                 puffin::impl::Sdl sdl;
                 puffin::impl::SdlRenderer sdlRenderer = sdl.createRenderer(p.width(), p.height());
-                for (int y=0; y!=p.height(); ++y) {
-                        for (int x = 0; x!=p.width(); ++x) {
-                                const puffin::Color32 col = p.at(x, y);
-                                sdlRenderer.setPixel(x, y, col.r(), col.g(), col.b());
-                        }
-                }
+                puffin::Image32Bgra img(p.width(), p.height());
+                p.read_pixels(img.data(), img.stride());
+                sdlRenderer.copy(img);
                 sdlRenderer.present();
                 sdl.pollTilQuit();
                 return 0;
@@ -0,0 +1,611 @@
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Usage notes
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//
+// puffin-bmpgen writes deterministic BMP files of arbitrary size for load
+// and scaling benchmarks. The same options and seed always produce the
+// same file, byte for byte.
+//
+//   puffin-bmpgen --width 65536 --height 65536 --bpp 24 big.bmp
+//   puffin-bmpgen --width 8192 --height 8192 --bpp 8 --compression rle8
+//                 --run-length 24 --literal-ratio 0.1 rle8.bmp
+//   puffin-bmpgen --width 4096 --height 4096 --bpp 16
+//                 --compression bitfields --masks f800:7e0:1f rgb565.bmp
+//
+// Rows are generated and written one at a time, so memory use only depends
+// on the width, never on the height; tens of gigapixels are fine as long as
+// the disk is large enough. Files that exceed 4 GiB cannot express their
+// size in the header; the size fields are written as 0 then, which readers
+// (including puffin) accept for BI_RGB and BI_BITFIELDS data.
+//
+// See --help for the full list of options.
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// -- Options ------------------------------------------------------------------
+enum Compression {
+        Compression_RGB = 0,
+        Compression_RLE8 = 1,
+        Compression_RLE4 = 2,
+        Compression_Bitfields = 3
+};
+
+enum Pattern {
+        Pattern_Gradient,
+        Pattern_Noise,
+        Pattern_Stripes
+};
+
+struct Options {
+        uint32_t width;
+        uint32_t height;
+        uint32_t bpp;
+        Compression compression;
+        uint32_t masks[4];
+        bool customMasks;
+        uint32_t paletteSize;
+        bool topDown;
+        uint64_t seed;
+        Pattern pattern;
+        uint32_t noise;
+        double runLength;
+        double literalRatio;
+        std::string filename;
+
+        Options() :
+                width(1024),
+                height(1024),
+                bpp(24),
+                compression(Compression_RGB),
+                customMasks(false),
+                paletteSize(0),
+                topDown(false),
+                seed(1),
+                pattern(Pattern_Gradient),
+                noise(8),
+                runLength(16.0),
+                literalRatio(0.25)
+        {
+                masks[0] = masks[1] = masks[2] = masks[3] = 0;
+        }
+};
+
+void usage(std::ostream &os) {
+        os << "usage: puffin-bmpgen [options] <output.bmp>\n"
+              "\n"
+              "  --width N             image width in pixels (default 1024)\n"
+              "  --height N            image height in pixels (default 1024)\n"
+              "  --bpp N               1, 4, 8, 16, 24 or 32 (default 24)\n"
+              "  --compression C       rgb, bitfields, rle4 or rle8 (default rgb)\n"
+              "  --masks R:G:B[:A]     hexadecimal channel masks for bitfields\n"
+              "  --palette N           palette entries for <= 8 bpp (default 2^bpp)\n"
+              "  --top-down            store rows top-down (negative height)\n"
+              "  --seed N              seed for all pseudo random content (default 1)\n"
+              "  --pattern P           gradient, noise or stripes (default gradient)\n"
+              "  --noise N             noise amplitude added to gradients, 0..255 (default 8)\n"
+              "  --run-length F        mean RLE run length in pixels (default 16)\n"
+              "  --literal-ratio F     fraction of RLE segments written in absolute\n"
+              "                        mode, 0..1 (default 0.25)\n"
+              "  --help                print this message\n";
+}
+
+uint64_t parseUint(std::string const &opt, char const *v, uint64_t max) {
+        char *end = 0;
+        const unsigned long long ret = std::strtoull(v, &end, 0);
+        if (end == v || *end != '\0' || ret > max)
+                throw std::invalid_argument("invalid value for " + opt + ": " + v);
+        return ret;
+}
+
+double parseDouble(std::string const &opt, char const *v, double min, double max) {
+        char *end = 0;
+        const double ret = std::strtod(v, &end);
+        if (end == v || *end != '\0' || !(ret >= min && ret <= max))
+                throw std::invalid_argument("invalid value for " + opt + ": " + v);
+        return ret;
+}
+
+void parseMasks(char const *v, Options &opt) {
+        std::string s(v);
+        int n = 0;
+        std::string::size_type pos = 0;
+        while (n < 4) {
+                const std::string::size_type colon = s.find(':', pos);
+                const std::string part = s.substr(pos, colon - pos);
+                opt.masks[n++] = static_cast<uint32_t>(
+                        parseUint("--masks", ("0x" + part).c_str(), 0xFFFFFFFFu));
+                if (colon == std::string::npos)
+                        break;
+                pos = colon + 1;
+        }
+        if (n < 3)
+                throw std::invalid_argument("--masks needs at least R:G:B");
+        opt.customMasks = true;
+}
+
+Options parseOptions(int argc, char *argv[]) {
+        Options opt;
+        for (int i = 1; i < argc; ++i) {
+                const std::string arg = argv[i];
+                if (arg == "--help") {
+                        usage(std::cout);
+                        std::exit(0);
+                }
+                if (arg == "--top-down") {
+                        opt.topDown = true;
+                        continue;
+                }
+                if (arg.compare(0, 2, "--") != 0) {
+                        if (!opt.filename.empty())
+                                throw std::invalid_argument("more than one output file");
+                        opt.filename = arg;
+                        continue;
+                }
+                if (i + 1 == argc)
+                        throw std::invalid_argument("missing value for " + arg);
+                char const *v = argv[++i];
+
+                if (arg == "--width") {
+                        opt.width = static_cast<uint32_t>(parseUint(arg, v, 0x7FFFFFFF));
+                } else if (arg == "--height") {
+                        opt.height = static_cast<uint32_t>(parseUint(arg, v, 0x7FFFFFFF));
+                } else if (arg == "--bpp") {
+                        opt.bpp = static_cast<uint32_t>(parseUint(arg, v, 32));
+                } else if (arg == "--compression") {
+                        const std::string c = v;
+                        if (c == "rgb") opt.compression = Compression_RGB;
+                        else if (c == "bitfields") opt.compression = Compression_Bitfields;
+                        else if (c == "rle4") opt.compression = Compression_RLE4;
+                        else if (c == "rle8") opt.compression = Compression_RLE8;
+                        else throw std::invalid_argument("unknown compression: " + c);
+                } else if (arg == "--masks") {
+                        parseMasks(v, opt);
+                } else if (arg == "--palette") {
+                        opt.paletteSize = static_cast<uint32_t>(parseUint(arg, v, 256));
+                } else if (arg == "--seed") {
+                        opt.seed = parseUint(arg, v, ~uint64_t(0));
+                } else if (arg == "--pattern") {
+                        const std::string p = v;
+                        if (p == "gradient") opt.pattern = Pattern_Gradient;
+                        else if (p == "noise") opt.pattern = Pattern_Noise;
+                        else if (p == "stripes") opt.pattern = Pattern_Stripes;
+                        else throw std::invalid_argument("unknown pattern: " + p);
+                } else if (arg == "--noise") {
+                        opt.noise = static_cast<uint32_t>(parseUint(arg, v, 255));
+                } else if (arg == "--run-length") {
+                        opt.runLength = parseDouble(arg, v, 1.0, 255.0);
+                } else if (arg == "--literal-ratio") {
+                        opt.literalRatio = parseDouble(arg, v, 0.0, 1.0);
+                } else {
+                        throw std::invalid_argument("unknown option: " + arg);
+                }
+        }
+        return opt;
+}
+
+void validate(Options &opt) {
+        if (opt.filename.empty())
+                throw std::invalid_argument("no output file given");
+        if (opt.width == 0 || opt.height == 0)
+                throw std::invalid_argument("width and height must be non-zero");
+
+        switch (opt.bpp) {
+        case 1: case 4: case 8: case 16: case 24: case 32:
+                break;
+        default:
+                throw std::invalid_argument("--bpp must be 1, 4, 8, 16, 24 or 32");
+        }
+
+        switch (opt.compression) {
+        case Compression_RLE4:
+                if (opt.bpp != 4)
+                        throw std::invalid_argument("rle4 requires --bpp 4");
+                break;
+        case Compression_RLE8:
+                if (opt.bpp != 8)
+                        throw std::invalid_argument("rle8 requires --bpp 8");
+                break;
+        case Compression_Bitfields:
+                if (opt.bpp != 16 && opt.bpp != 32)
+                        throw std::invalid_argument("bitfields requires --bpp 16 or 32");
+                break;
+        case Compression_RGB:
+                break;
+        }
+        if ((opt.compression == Compression_RLE4 ||
+             opt.compression == Compression_RLE8) && opt.topDown) {
+                // Not allowed by the format; see bmpsuite's b/rletopdown.bmp.
+                throw std::invalid_argument("RLE bitmaps cannot be top-down");
+        }
+        if (opt.customMasks && opt.compression != Compression_Bitfields)
+                throw std::invalid_argument("--masks requires --compression bitfields");
+
+        if (opt.bpp <= 8) {
+                const uint32_t full = 1u << opt.bpp;
+                if (opt.paletteSize == 0)
+                        opt.paletteSize = full;
+                if (opt.paletteSize > full)
+                        throw std::invalid_argument("--palette exceeds 2^bpp");
+        } else if (opt.paletteSize != 0) {
+                throw std::invalid_argument("--palette requires --bpp <= 8");
+        }
+
+        if (opt.compression == Compression_Bitfields && !opt.customMasks) {
+                if (opt.bpp == 16) {
+                        opt.masks[0] = 0xF800; opt.masks[1] = 0x07E0;
+                        opt.masks[2] = 0x001F; opt.masks[3] = 0;
+                } else {
+                        opt.masks[0] = 0x00FF0000; opt.masks[1] = 0x0000FF00;
+                        opt.masks[2] = 0x000000FF; opt.masks[3] = 0;
+                }
+        }
+}
+
+
+// -- Deterministic content ----------------------------------------------------
+// All content is a pure function of (seed, x, y), so rows can be produced
+// independently and in any order.
+inline uint64_t mix64(uint64_t z) {
+        // splitmix64 finalizer
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+}
+
+struct Random {
+        uint64_t state;
+
+        explicit Random(uint64_t seed) : state(seed) {}
+
+        uint64_t next() {
+                state += 0x9E3779B97F4A7C15ULL;
+                return mix64(state);
+        }
+
+        double uniform() {
+                return double(next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        // Geometric distribution with the given mean, clamped to [lo, hi].
+        uint32_t runLength(double mean, uint32_t lo, uint32_t hi) {
+                const double p = 1.0 / mean;
+                uint32_t n = 1;
+                while (n < hi && uniform() >= p)
+                        ++n;
+                return n < lo ? lo : n;
+        }
+};
+
+struct Generator {
+        explicit Generator(Options const &opt) :
+                opt_(opt),
+                fx_(opt.width > 1 ? 255.0 / (opt.width - 1) : 0.0),
+                fy_(opt.height > 1 ? 255.0 / (opt.height - 1) : 0.0)
+        {
+                if (opt.compression == Compression_Bitfields) {
+                        std::memcpy(masks_, opt.masks, sizeof masks_);
+                } else if (opt.bpp == 16) {
+                        masks_[0] = 0x7C00; masks_[1] = 0x03E0;
+                        masks_[2] = 0x001F; masks_[3] = 0;
+                } else {
+                        masks_[0] = 0xFF0000; masks_[1] = 0xFF00;
+                        masks_[2] = 0xFF;     masks_[3] = 0;
+                }
+                for (int c = 0; c != 4; ++c) {
+                        const uint32_t m = masks_[c];
+                        int shift = 0, width = 0;
+                        while (m && !((m >> shift) & 1)) ++shift;
+                        while (shift + width < 32 && ((m >> (shift + width)) & 1))
+                                ++width;
+                        shift_[c] = shift;
+                        drop_[c] = width < 8 ? 8 - width : 0;
+                }
+        }
+
+        // Computes the 8-bit channel values (r, g, b, a) of a pixel.
+        void pixel(uint32_t x, uint32_t y, uint32_t rgba[4]) const {
+                const uint64_t h = mix64(opt_.seed ^ (uint64_t(y) << 32 | x));
+                switch (opt_.pattern) {
+                case Pattern_Noise:
+                        for (int c = 0; c != 4; ++c)
+                                rgba[c] = static_cast<uint32_t>(h >> (8 * c)) & 0xFF;
+                        return;
+                case Pattern_Stripes:
+                        for (int c = 0; c != 4; ++c)
+                                rgba[c] = ((x / 16 + y / 16 + c) & 1) ? 0xFF : 0x20;
+                        return;
+                case Pattern_Gradient:
+                default: {
+                        const double gx = x * fx_, gy = y * fy_;
+                        const double v[3] = { gx, gy, 255.0 - 0.5 * (gx + gy) };
+                        const uint32_t range = 2 * opt_.noise + 1;
+                        for (int c = 0; c != 3; ++c) {
+                                const int n = int((h >> (16 * c)) % range)
+                                              - int(opt_.noise);
+                                const int r = int(v[c]) + n;
+                                rgba[c] = r < 0 ? 0 : r > 255 ? 255 : uint32_t(r);
+                        }
+                        rgba[3] = 255;
+                        return;
+                }
+                }
+        }
+
+        // Palette index for x, y; spreads the palette over the image.
+        uint32_t index(uint32_t x, uint32_t y) const {
+                const uint32_t n = opt_.paletteSize;
+                uint32_t rgba[4];
+                pixel(x, y, rgba);
+                if (opt_.pattern == Pattern_Noise)
+                        return (rgba[0] | rgba[1] << 8) % n;
+                return (rgba[0] * n / 256 + rgba[1] * n / 512) % n;
+        }
+
+        // Packs a pixel into the raw value described by the channel masks.
+        uint32_t raw(uint32_t x, uint32_t y) const {
+                uint32_t rgba[4];
+                pixel(x, y, rgba);
+                uint32_t ret = 0;
+                for (int c = 0; c != 4; ++c)
+                        ret |= ((rgba[c] >> drop_[c]) << shift_[c]) & masks_[c];
+                return ret;
+        }
+
+private:
+        Options const &opt_;
+        double fx_, fy_;
+        uint32_t masks_[4];
+        int shift_[4], drop_[4];
+};
+
+
+// -- Writing ------------------------------------------------------------------
+struct Writer {
+        explicit Writer(std::string const &filename) :
+                f_(filename.c_str(), std::ios::binary | std::ios::trunc),
+                pos_(0)
+        {
+                if (!f_.is_open())
+                        throw std::runtime_error("cannot open " + filename);
+                buf_.reserve(bufSize);
+        }
+
+        ~Writer() {
+                try {
+                        flush();
+                } catch (...) {
+                }
+        }
+
+        void u8(uint32_t v) {
+                buf_.push_back(static_cast<char>(v & 0xFF));
+                if (buf_.size() >= bufSize)
+                        flush();
+        }
+        void u16(uint32_t v) { u8(v); u8(v >> 8); }
+        void u32(uint32_t v) { u16(v); u16(v >> 16); }
+
+        void bytes(std::vector<uint8_t> const &v) {
+                buf_.insert(buf_.end(), v.begin(), v.end());
+                if (buf_.size() >= bufSize)
+                        flush();
+        }
+
+        uint64_t tell() const {
+                return pos_ + buf_.size();
+        }
+
+        void patchU32(uint64_t at, uint32_t v) {
+                flush();
+                f_.seekp(static_cast<std::streamoff>(at));
+                for (int i = 0; i != 4; ++i)
+                        f_.put(static_cast<char>((v >> (8 * i)) & 0xFF));
+                f_.seekp(0, std::ios::end);
+        }
+
+        void flush() {
+                if (buf_.empty())
+                        return;
+                f_.write(&buf_[0], static_cast<std::streamsize>(buf_.size()));
+                if (!f_)
+                        throw std::runtime_error("write error");
+                pos_ += buf_.size();
+                buf_.clear();
+        }
+
+private:
+        enum { bufSize = 1 << 20 };
+        std::ofstream f_;
+        std::vector<char> buf_;
+        uint64_t pos_;
+};
+
+uint32_t fitsU32(uint64_t v) {
+        return v > 0xFFFFFFFFULL ? 0 : static_cast<uint32_t>(v);
+}
+
+// Packs one row of uncompressed pixels, including the 4-byte row padding.
+void packRow(Options const &opt, Generator const &gen, uint32_t y,
+             std::vector<uint8_t> &row)
+{
+        const uint64_t stride = ((uint64_t(opt.width) * opt.bpp + 31) / 32) * 4;
+        row.assign(static_cast<std::size_t>(stride), 0);
+        uint8_t *p = &row[0];
+
+        if (opt.bpp <= 8) {
+                const uint32_t perByte = 8 / opt.bpp;
+                for (uint32_t x = 0; x != opt.width; ++x) {
+                        const uint32_t shift = (perByte - 1 - x % perByte) * opt.bpp;
+                        p[x / perByte] |= static_cast<uint8_t>(gen.index(x, y) << shift);
+                }
+                return;
+        }
+
+        const uint32_t bytes = opt.bpp / 8;
+        for (uint32_t x = 0; x != opt.width; ++x) {
+                const uint32_t v = gen.raw(x, y);
+                for (uint32_t b = 0; b != bytes; ++b)
+                        *p++ = static_cast<uint8_t>(v >> (8 * b));
+        }
+}
+
+// Encodes one row as RLE4/RLE8 runs, terminated by end-of-line. Segment
+// lengths follow a geometric distribution around --run-length, and a
+// --literal-ratio share of the segments is stored in absolute mode.
+void encodeRow(Options const &opt, Generator const &gen, uint32_t y,
+               Writer &w)
+{
+        const bool rle4 = opt.compression == Compression_RLE4;
+        Random rnd(mix64(opt.seed) ^ mix64(y + 1));
+
+        uint32_t x = 0;
+        while (x < opt.width) {
+                const uint32_t left = opt.width - x;
+                const bool literal = left >= 3 && rnd.uniform() < opt.literalRatio;
+                uint32_t n = rnd.runLength(opt.runLength, literal ? 3 : 1, 255);
+                if (n > left)
+                        n = left;
+
+                if (literal && n >= 3) {
+                        w.u8(0);
+                        w.u8(n);
+                        uint32_t written = 0;
+                        if (rle4) {
+                                for (uint32_t i = 0; i < n; i += 2) {
+                                        const uint32_t hi = gen.index(x + i, y);
+                                        const uint32_t lo = i + 1 < n ? gen.index(x + i + 1, y) : 0;
+                                        w.u8((hi << 4) | lo);
+                                        ++written;
+                                }
+                        } else {
+                                for (uint32_t i = 0; i != n; ++i, ++written)
+                                        w.u8(gen.index(x + i, y));
+                        }
+                        if (written & 1)
+                                w.u8(0); // pad to 16 bit boundary
+                } else {
+                        const uint32_t a = gen.index(x, y);
+                        const uint32_t b = rle4 && x + 1 < opt.width
+                                ? gen.index(x + 1, y) : a;
+                        w.u8(n);
+                        w.u8(rle4 ? (a << 4) | b : a);
+                }
+                x += n;
+        }
+}
+
+void writePalette(Options const &opt, Writer &w) {
+        const uint32_t n = opt.paletteSize;
+        for (uint32_t i = 0; i != n; ++i) {
+                // A smooth ramp with some hue variation, so that the image
+                // remains recognizable when viewed.
+                const uint32_t v = n > 1 ? i * 255 / (n - 1) : 0;
+                w.u8((v * 3 / 4 + 64 * (i & 1)) & 0xFF); // blue
+                w.u8(v);                                 // green
+                w.u8(255 - v);                           // red
+                w.u8(0);                                 // reserved
+        }
+}
+
+void generate(Options const &opt) {
+        const bool rle = opt.compression == Compression_RLE4 ||
+                         opt.compression == Compression_RLE8;
+        // An alpha mask requires a BITMAPV4HEADER, which carries all four
+        // masks itself. Otherwise, the RGB masks follow a plain
+        // BITMAPINFOHEADER.
+        const bool bitfields = opt.compression == Compression_Bitfields;
+        const bool v4 = bitfields && opt.masks[3] != 0;
+        const uint32_t infoHeaderSize = v4 ? 108 : 40;
+        const uint32_t maskBytes = bitfields && !v4 ? 12 : 0;
+        const uint32_t paletteBytes = opt.paletteSize * 4;
+        const uint32_t dataOffset = 14 + infoHeaderSize + maskBytes + paletteBytes;
+        const uint64_t stride = ((uint64_t(opt.width) * opt.bpp + 31) / 32) * 4;
+        const uint64_t imageSize = rle ? 0 : stride * opt.height;
+
+        Writer w(opt.filename);
+
+        // BITMAPFILEHEADER
+        w.u8('B'); w.u8('M');
+        const uint64_t fileSizePos = w.tell();
+        w.u32(fitsU32(dataOffset + imageSize));
+        w.u16(0);
+        w.u16(0);
+        w.u32(dataOffset);
+
+        // BITMAPINFOHEADER
+        w.u32(infoHeaderSize);
+        w.u32(opt.width);
+        w.u32(opt.topDown ? uint32_t(-int32_t(opt.height)) : opt.height);
+        w.u16(1);
+        w.u16(opt.bpp);
+        w.u32(opt.compression);
+        const uint64_t imageSizePos = w.tell();
+        w.u32(fitsU32(imageSize));
+        w.u32(2835); // 72 DPI
+        w.u32(2835);
+        w.u32(opt.bpp <= 8 ? opt.paletteSize : 0);
+        w.u32(0);
+
+        if (v4) {
+                for (int i = 0; i != 4; ++i)
+                        w.u32(opt.masks[i]);
+                w.u32(0x73524742); // LCS_sRGB
+                for (int i = 0; i != 9 + 3; ++i)
+                        w.u32(0);  // endpoints and gamma, unused for sRGB
+        } else if (maskBytes) {
+                for (int i = 0; i != 3; ++i)
+                        w.u32(opt.masks[i]);
+        }
+        writePalette(opt, w);
+
+        Generator gen(opt);
+        std::vector<uint8_t> row;
+        for (uint32_t i = 0; i != opt.height; ++i) {
+                // Pixel data is stored bottom-up unless requested otherwise.
+                const uint32_t y = opt.topDown ? i : opt.height - 1 - i;
+                if (rle) {
+                        encodeRow(opt, gen, y, w);
+                        if (i + 1 != opt.height) {
+                                w.u8(0); w.u8(0); // end of line
+                        }
+                } else {
+                        packRow(opt, gen, y, row);
+                        w.bytes(row);
+                }
+        }
+        if (rle) {
+                w.u8(0); w.u8(1); // end of bitmap
+                const uint64_t end = w.tell();
+                w.patchU32(fileSizePos, fitsU32(end));
+                w.patchU32(imageSizePos, fitsU32(end - dataOffset));
+        }
+        w.flush();
+}
+
+}
+
+int main(int argc, char *argv[]) {
+        try {
+                Options opt = parseOptions(argc, argv);
+                validate(opt);
+                generate(opt);
+                return 0;
+        } catch (std::invalid_argument &e) {
+                std::cerr << "puffin-bmpgen: " << e.what() << "\n\n";
+                usage(std::cerr);
+                return 2;
+        } catch (std::exception &e) {
+                std::cerr << "puffin-bmpgen: " << e.what() << std::endl;
+                return 1;
+        }
+}